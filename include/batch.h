@@ -0,0 +1,20 @@
+// batch.h
+// Header file for batch syntax checking. It declares the function that
+// checks many files, or whole directories of them, on a fixed pool of
+// worker threads.
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Checks whether a path names a directory.
+bool is_directory(const char *path);
+// Returns the default number of worker threads (the number of online CPUs).
+int default_jobs(void);
+// Checks the syntax of every file and of every source file below every
+// directory in `paths`, printing diagnostics grouped per file in input order.
+int check_files(const char **paths, size_t path_count, int jobs);
+
+#endif
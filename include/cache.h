@@ -0,0 +1,88 @@
+// cache.h
+// Header file for the on-disk compiled cache. It defines the layout of the
+// versioned `.noonc` image (token stream, constant pool and line table) and
+// declares the functions for recording, storing and replaying it.
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_MAGIC "NOONC\x1a\r\n"
+// Bump whenever the lexer produces different tokens for the same source.
+#define CACHE_VERSION 3
+#define CACHE_EXTENSION ".noonc"
+
+// Fixed header at the start of every cache image. All offsets are relative to
+// the start of the image and aligned to 8 bytes so it can be used in place
+// after `mmap`.
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t build_id;
+  uint64_t source_hash;
+  uint64_t source_size;
+  uint64_t image_size;
+  uint64_t payload_hash; // Hash of everything after the header.
+  uint64_t line_count;
+  uint64_t statement_count;
+  uint64_t token_count;
+  uint64_t pool_size;
+  uint64_t lines_offset;
+  uint64_t statements_offset;
+  uint64_t tokens_offset;
+  uint64_t pool_offset;
+} CacheHeader;
+
+// A token as stored in the image; its value lives in the constant pool and
+// may hold NUL bytes, so its length is stored too.
+typedef struct {
+  uint32_t token_type;
+  uint32_t value_offset;
+  uint64_t value_length;
+  uint64_t token_line;
+  uint64_t token_index;
+} CacheToken;
+
+// A range of tokens that the lexer handed to the parser as one statement.
+typedef struct {
+  uint64_t first_token;
+  uint64_t token_count;
+} CacheStatement;
+
+// In-memory state used while recording a run and replaying an image.
+typedef struct {
+  // Source file
+  char *source;
+  size_t source_size;
+  uint64_t source_hash;
+  char *path;
+  // Recorded statements
+  CacheToken *tokens;
+  size_t tokens_count;
+  size_t tokens_capacity;
+  CacheStatement *statements;
+  size_t statements_count;
+  size_t statements_capacity;
+  char *pool;
+  size_t pool_size;
+  size_t pool_capacity;
+} CacheBuilder;
+
+// Prepares the cache for the current input file. Returns false if the input
+// cannot be cached (REPL, command string, pipe, unreadable file).
+bool cache_open(void);
+// Loads a valid image for the current input and replays it through the
+// parser. Returns false on a miss or a stale/corrupt image.
+bool cache_replay(void);
+// Records the statement currently held in `ctx->tokens`.
+void cache_record_statement(void);
+// Writes the recorded statements as a new image.
+void cache_store(void);
+// Releases a cache builder and the copy of the source.
+void cache_free(CacheBuilder *cache);
+
+#endif
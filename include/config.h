@@ -7,7 +7,25 @@
 #define CONFIG_H
 
 #define INITIAL_CAPACITY 16
+#define REGION_BLOCK_SIZE 4096
+#define INTERN_INITIAL_SLOTS 256
+#define INTERN_LIMIT (1 << 20) // interned bytes kept between independent runs
+#define RANGE_PRINT_LIMIT 8       // longer ranges print their ends only
+#define RANGE_EXPAND_LIMIT (1 << 26) // numbers a range may expand to as a list
+#define KARATSUBA_THRESHOLD 32       // limbs below which big integers multiply directly
+#define BIGINT_SHIFT_LIMIT (1 << 24) // largest left shift of a big integer, in bits
+#define BIGINT_POW_LIMIT (1 << 24)   // largest power of an integer, in bits
+#define POW_CHAIN_LIMIT 2            // largest constant exponent done by multiplying
 #define LINE_SIZE 1024
+#define READ_BLOCK_SIZE 65536
+#define STREAM_LINE_WINDOW 16
+#define SOURCE_EXTENSION ".noon"
+#define LOG_BUFFER_SIZE 65536
+#define MAX_STORED_LOGS 65536
+#define MAX_DUPLICATE_LOGS 10
+#define LOG_DEDUP_SLOTS 1024
+#define HISTORY_SIZE 1000
+#define SARIF_SCHEMA "https://json.schemastore.org/sarif-2.1.0.json"
 
 /* Colors */
 extern const char *COLOR_RED;
@@ -26,6 +44,11 @@ extern const char *COLOR_RESET;
   "%s%s: %serror: %s%scannot open '%s': another input file already "                                                                                                                                   \
   "specified\n"
 #define ERR_OPTION_REQUIRES_ARGUMENT "%s%s: %serror: %s%s%s: option requires an argument\n"
+#define ERR_INVALID_JOBS "%s%s: %serror: %s%sinvalid number of jobs '%s'\n"
+#define ERR_SERVE_SOCKET "%s%s: %serror: %s%scannot listen on '%s': %s\n"
+#define ERR_INVALID_DIAGNOSTICS_FORMAT "%s%s: %serror: %s%sinvalid diagnostics format '%s' (expected text, json or sarif)\n"
+#define ERR_INVALID_MAX_ERRORS "%s%s: %serror: %s%sinvalid maximum number of errors '%s'\n"
+#define ERR_INVALID_STATS_FORMAT "%s%s: %serror: %s%sinvalid stats format '%s' (expected text or json)\n"
 #define ERR_INVALID_OPTION                                                                                                                                                                             \
   "%s%s: %serror: %s%sinvalid option -- '%s'\nTry '%s --help' for more "                                                                                                                               \
   "information\n"
@@ -33,12 +56,23 @@ extern const char *COLOR_RESET;
   "%s%s: %serror: %s%sunrecognized option '%s'\nTry '%s --help' for more "                                                                                                                             \
   "information\n"
 
+// Notes about diagnostics that were not shown.
+#define ERR_TOO_MANY_ERRORS "too many errors emitted, stopping now [--max-errors=%zu]"
+#define NOTE_DUPLICATE_LOGS "and %s more like this: %s"
+#define NOTE_DROPPED_LOGS "%s more diagnostics not shown"
+
 #define TOTAL_ERRORS "%d error%s generated.\n"
 
 // Lexer warnings and errors.
 #define WRN_MULTICHAR_COMMENT "multi-character character constant"
+#define ERR_NO_SUCH_FILE "no such file or directory"
 #define ERR_UNCLOSED "unclosed %s `%s`"
 #define ERR_UNMATCHED "unmatched %s `%s`"
+#define ERR_UNKNOWN_ESCAPE "unknown escape sequence `%s`"
+#define ERR_INVALID_HEX_ESCAPE "invalid hexadecimal escape `%s`"
+#define ERR_INVALID_UNICODE_ESCAPE "invalid unicode escape `%s`"
+#define ERR_INVALID_CODE_POINT "escape `%s` is not a valid unicode code point"
+#define ERR_INVALID_UTF8 "invalid UTF-8 byte 0x%02x"
 
 // Parser errors.
 #define ERR_EXPECTED_VALUE_BEFORE_OP "expected value before operator `%s`"
@@ -50,6 +84,28 @@ extern const char *COLOR_RESET;
 #define ERR_EXPECTED_VALUE "expected value"
 #define ERR_TYPE_OP_NOT_SUPPORTED "operator `%s` not supported between %s and %s"
 #define ERR_INVALID_SYNTAX "invalid syntax `%s`"
+#define ERR_LIST_ITEM_TYPE "list items must be numbers, not %s"
+#define ERR_EXPECTED_LIST_END "expected ',' or ']' in list"
+#define ERR_DICT_KEY_TYPE "dict keys must be numbers, strings or booleans, not %s"
+#define ERR_EXPECTED_DICT_COLON "expected ':' after dict key"
+#define ERR_EXPECTED_DICT_END "expected ',' or '}' in dict"
+#define ERR_EXPECTED_CALL_END "expected ',' or ')' in call"
+#define ERR_UNKNOWN_FUNCTION "unknown function `%s`"
+#define ERR_ARGUMENT_COUNT "function `%s` takes %zu argument(s), not %zu"
+
+// Runtime errors.
+#define ERR_DIVISION_BY_ZERO "division by zero"
+#define ERR_INTEGER_OPERANDS "operator `%s` requires integer operands"
+#define ERR_NEGATIVE_SHIFT "negative shift count"
+#define ERR_INTEGER_TOO_LARGE "integer too large for operator `%s`"
+#define ERR_INVALID_ASSIGNMENT "cannot assign to a value with `%s`"
+#define ERR_UNARY_NOT_SUPPORTED "operator `%s` not supported for %s"
+#define ERR_LIST_LENGTHS "operator `%s` needs lists of the same length, not %s and %s"
+#define ERR_RANGE_BOUNDS "range bounds must be finite numbers"
+#define ERR_RANGE_TOO_LONG "range is too long to count exactly"
+#define ERR_INTEGER_INEXACT "integer too large for a %s, which holds integers exactly only up to 2^53"
+#define ERR_RANGE_TOO_LARGE "range of %s numbers is too large to expand into a list"
+#define ERR_ARGUMENT_TYPE "function `%s` not supported for %s"
 
 // Numeric literal errors.
 #define ERR_INVALID_DECIMAL_LITERAL "invalid decimal literal `%s`"
@@ -60,5 +116,6 @@ extern const char *COLOR_RESET;
 #define ERR_TRAILING_NUMERIC_SEPARATOR "trailing underscore in numeric literal `%s`"
 
 // Function to disable colors if not in a TTY.
+void disable_colors(void);
 void disable_colors_if_not_tty(void);
 #endif
@@ -1,15 +1,19 @@
 // context.h
-// Header file for the global context. It defines the NoonContext struct,
-// which holds the entire state of the interpreter (lexer, parser, logs, etc.),
-// making it accessible throughout the program.
+// Header file for the interpreter context. It defines the NoonContext struct,
+// which holds the entire state of one interpreter instance (lexer, parser,
+// logs, etc.), making it accessible throughout the program.
 
 #ifndef CONTEXT_H
 #define CONTEXT_H
 
+#include "cache.h"
 #include "config.h"
+#include "eval/value.h"
 #include "lexer/lexer.h"
 #include "lexer/tokens.h"
 #include "parser/ast.h"
+#include "stats.h"
+#include "utils/intern.h"
 #include "utils/log.h"
 #include <stdbool.h>
 #include <stddef.h>
@@ -23,8 +27,9 @@ typedef struct {
   size_t line_length;
   size_t line_index;
   size_t line_number;
-  char **lines;
+  char **lines; // lines[i] holds line first_line + i + 1
   size_t lines_capacity;
+  size_t first_line; // lines released so far in streaming mode
   // Lexer state
   LexerState state;
   // Quotes
@@ -44,12 +49,16 @@ typedef struct {
   size_t tokens_capacity;
   size_t tokens_count;
   size_t tokens_position;
+  Region token_values; // values of the tokens of the current statement
+  InternTable interns; // spellings of names and literals, shared by tokens and nodes
   char *string_token;
   size_t string_token_length;
   size_t string_token_capacity;
   /* Ast */
   Node *ast_root;
   bool has_syntax_error;
+  /* Evaluation */
+  Value result; // Value of the last evaluated statement.
   /* Logs */
   LogEntry *logs;
   size_t logs_count;
@@ -57,12 +66,38 @@ typedef struct {
   int total_errors;
   int total_warnings;
   int total_infos;
+  char *log_buffer; // diagnostics waiting to be written
+  size_t log_buffer_size;
+  size_t log_buffer_capacity;
+  size_t logs_emitted; // diagnostics written to the current document
+  bool logs_heap;       // `logs` is a max-heap holding the first entries
+  size_t logs_dropped;  // saved logs discarded to bound memory
+  bool error_limit_reached;
+  LogDuplicate *duplicates; // LOG_DEDUP_SLOTS slots, allocated on first use
+  size_t duplicates_count;
+  size_t *display_columns; // display column of each byte of `display_line`
+  size_t display_length;   // bytes mapped in `display_columns`
+  size_t display_capacity;
+  size_t display_line; // line mapped for diagnostics, 0 if none
+  bool display_ascii;  // `display_line` is ASCII and needs no map
+  /* Cache */
+  CacheBuilder *cache;
+  /* Statistics */
+  Stats stats; // work and phase times reported by --stats
 } NoonContext;
 
-// Global pointer to the context.
-extern NoonContext *ctx;
+// Pointer to the context used by the current thread.
+extern _Thread_local NoonContext *ctx;
 
-// Function to initialize the context.
+// Allocates a new, independent context.
+NoonContext *create_context(void);
+// Clears the per-run state of a context while keeping its buffers.
+void reset_context(NoonContext *context);
+// Forgets the messages counted for deduplication.
+void clear_duplicates(NoonContext *context);
+// Frees a context and everything it owns.
+void destroy_context(NoonContext *context);
+// Creates the context of the current thread.
 void init_context(void);
 
 #endif
@@ -0,0 +1,47 @@
+// eval/bigint.h
+// Header file for arbitrary-precision integers. Integers that overflow 64
+// bits are promoted to a BigInt, a sign and an array of 32-bit limbs, and
+// this file declares the arithmetic, conversion and comparison functions
+// the evaluator uses on them.
+
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// An integer of any size: the magnitude is `limbs[0..length)`, least
+// significant limb first, with no leading zero limbs. Zero has length 0.
+// BigInts are never modified once created.
+typedef struct BigInt {
+  size_t length;
+  bool negative;
+  uint32_t limbs[];
+} BigInt;
+
+// Function declarations for creating big integers.
+BigInt *bigint_from_int64(int64_t value);
+BigInt *bigint_from_decimal(const char *digits, size_t length);
+BigInt *bigint_from_double(double value);
+BigInt *bigint_copy(const BigInt *value);
+
+// Function declarations for arithmetic. Each returns a new BigInt.
+BigInt *bigint_add(const BigInt *left, const BigInt *right);
+BigInt *bigint_sub(const BigInt *left, const BigInt *right);
+BigInt *bigint_mul(const BigInt *left, const BigInt *right);
+BigInt *bigint_negate(const BigInt *value);
+// Floor division: the quotient rounds down and the remainder takes the
+// sign of the divisor. `right` must not be zero.
+BigInt *bigint_divmod(const BigInt *left, const BigInt *right, BigInt **remainder);
+BigInt *bigint_shift_left(const BigInt *value, uint64_t bits);
+// Shifts right rounding down, like `>>` on negative 64-bit integers.
+BigInt *bigint_shift_right(const BigInt *value, uint64_t bits);
+
+// Function declarations for comparing and converting big integers.
+int bigint_compare(const BigInt *left, const BigInt *right);
+bool bigint_to_int64(const BigInt *value, int64_t *out);
+double bigint_to_double(const BigInt *value);
+char *bigint_to_string(const BigInt *value);
+
+#endif
@@ -0,0 +1,30 @@
+// eval/builtins.h
+// Header file for the builtin functions. It declares the table of functions
+// that can be called by name, such as `len(x)` and `sum(x)`, and the
+// function that applies one to evaluated arguments.
+
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "eval/value.h"
+#include "lexer/tokens.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Largest number of arguments a builtin takes.
+#define BUILTIN_MAX_ARGS 2
+
+// Builtin functions.
+typedef enum { BUILTIN_LEN, BUILTIN_SUM, BUILTIN_CONTAINS } Builtin;
+
+// Looks up a builtin by name. Returns false if there is none.
+bool find_builtin(const char *name, Builtin *builtin);
+// Returns the name of a builtin.
+const char *builtin_name(Builtin builtin);
+// Returns the number of arguments a builtin takes.
+size_t builtin_arity(Builtin builtin);
+// Applies a builtin to its evaluated arguments, which stay owned by the
+// caller. Reports an error at `name` and returns false if they don't fit.
+bool call_builtin(Builtin builtin, Token name, const Value *args, Value *result);
+
+#endif
@@ -0,0 +1,57 @@
+// eval/dict.h
+// Header file for dictionaries. It defines the open-addressing hash table
+// behind `{ key: value }` literals, with one control byte per slot probed a
+// group of 16 at a time, and declares the functions that build, search,
+// compare and free it.
+
+#ifndef DICT_H
+#define DICT_H
+
+#include "eval/value.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Slots whose control bytes are checked together.
+#define DICT_GROUP 16
+
+// One key and its value. `key_intern` is the intern id of the literal the
+// key was written as, or 0 if it was computed.
+typedef struct {
+  Value key;
+  Value value;
+  uint64_t hash;
+  uint32_t key_intern;
+} DictEntry;
+
+// A dictionary. Entries are kept in insertion order in `entries`; the
+// table maps hashes to them. Slot `i` is empty if `control[i]` has its top
+// bit set, otherwise `control[i]` holds 7 bits of the key's hash and
+// `slots[i]` the index of the entry. The first DICT_GROUP control bytes are
+// repeated after the last one, so a group can be loaded from any slot.
+typedef struct Dict {
+  uint8_t *control;
+  uint32_t *slots;
+  size_t capacity; // a power of two, at least DICT_GROUP
+  DictEntry *entries;
+  size_t count;
+  size_t entries_capacity;
+} Dict;
+
+// Creates a dictionary with room for `count` entries without growing.
+Dict *dict_create(size_t count);
+// Adds a key, or replaces the value of an existing one. Takes ownership of
+// the key and the value. Returns false if the key was already present.
+bool dict_insert(Dict *dict, Value key, uint32_t key_intern, Value value);
+// Returns the value of a key, or NULL if it is missing.
+const Value *dict_find(const Dict *dict, Value key, uint32_t key_intern);
+// Returns a deep copy of a dictionary.
+Dict *dict_copy(const Dict *dict);
+// Checks whether two dictionaries have the same keys with equal values.
+bool dict_equal(const Dict *left, const Dict *right);
+// Frees a dictionary with its keys and values.
+void dict_free(Dict *dict);
+// Hashes a number, string or boolean key.
+uint64_t hash_value(Value key);
+
+#endif
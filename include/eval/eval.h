@@ -0,0 +1,18 @@
+// eval/eval.h
+// Header file for the evaluator. It declares the function that walks an
+// AST and computes its runtime value.
+
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "eval/value.h"
+#include "parser/ast.h"
+#include <stdbool.h>
+
+// Evaluates an AST. Returns false and reports an error if evaluation fails.
+bool evaluate(Node *node, Value *result);
+// Reports a runtime error at a token and marks the statement as failed.
+// Unused arguments are ignored by the format string.
+void runtime_error(Token op, const char *fmt, const char *arg1, const char *arg2, const char *arg3);
+
+#endif
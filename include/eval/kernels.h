@@ -0,0 +1,26 @@
+// eval/kernels.h
+// Header file for the element-wise list kernels. It declares the loops that
+// apply arithmetic and comparisons to packed number arrays, using AVX2 where
+// the processor has it and plain C everywhere else.
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Element-wise arithmetic operators.
+typedef enum { KERNEL_ADD, KERNEL_SUB, KERNEL_MUL, KERNEL_DIV, KERNEL_POW } ArithKernel;
+
+// Element-wise comparison operators.
+typedef enum { KERNEL_EQ, KERNEL_NE, KERNEL_LT, KERNEL_LE, KERNEL_GT, KERNEL_GE } CompareKernel;
+
+// Computes `out[i] = a[i * a_step] op b[i * b_step]` for `n` elements. A step
+// of 0 repeats a single scalar operand, a step of 1 walks a list.
+void kernel_arith(ArithKernel op, const double *a, size_t a_step, const double *b, size_t b_step, double *out, size_t n);
+// Computes `out[i] = a[i * a_step] op b[i * b_step]` for `n` elements.
+void kernel_compare(CompareKernel op, const double *a, size_t a_step, const double *b, size_t b_step, bool *out, size_t n);
+// Checks whether any of `n` numbers is zero.
+bool kernel_has_zero(const double *a, size_t n);
+
+#endif
@@ -0,0 +1,33 @@
+// eval/power.h
+// Header file for the exponentiation kernels behind `**`. The parser picks
+// a kernel when the exponent is a constant, and the evaluator raises exact
+// integers by repeated squaring.
+
+#ifndef POWER_H
+#define POWER_H
+
+#include "eval/value.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// How a `**` node computes its result, chosen from its right operand when
+// the node is created.
+typedef enum {
+  POWER_ANY,   // the exponent is only known at run time
+  POWER_SMALL, // a whole exponent up to POW_CHAIN_LIMIT: multiplications
+  POWER_SQRT   // an exponent of 0.5: a square root
+} PowerKind;
+
+// Raises `base` to a whole exponent up to POW_CHAIN_LIMIT with
+// multiplications only, rounded the same as pow().
+double power_chain(double base, unsigned exponent);
+// Returns `base ** 0.5`, which is the square root except at -0 and -inf.
+double power_sqrt(double base);
+// Checks whether an integer raised to `exponent` stays under
+// BIGINT_POW_LIMIT bits.
+bool power_fits(Value base, uint64_t exponent);
+// Raises an integer value to a non-negative exponent exactly, by repeated
+// squaring on 64 bits until a product overflows and on big integers after.
+Value power_integer(Value base, uint64_t exponent);
+
+#endif
@@ -0,0 +1,84 @@
+// eval/value.h
+// Header file for runtime values. It defines the Value struct produced by
+// evaluating an AST and declares functions for creating, copying, printing
+// and freeing values.
+
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Enum of all possible runtime value types.
+typedef enum { VALUE_NULL, VALUE_NUMBER, VALUE_INTEGER, VALUE_BIGINT, VALUE_STRING, VALUE_BOOLEAN, VALUE_LIST, VALUE_DICT, VALUE_RANGE } ValueType;
+
+struct BigInt;
+struct Dict;
+
+// A runtime value. Strings, list items, big integers and dictionaries are
+// owned by the value.
+typedef struct {
+  ValueType value_type;
+  union {
+    double number_value;
+    // Integers are exact. Those that fit in 64 bits are VALUE_INTEGER and
+    // the others VALUE_BIGINT, so a big integer never fits in an int64_t.
+    int64_t integer_value;
+    struct BigInt *bigint_value;
+    bool boolean_value;
+    // For string values: the bytes, which may contain NULs, their length
+    // and their hash, 0 until it is first needed.
+    struct {
+      char *string_value;
+      size_t string_length;
+      uint64_t string_hash;
+    };
+    // For list values: `list_length` items stored packed, as doubles for
+    // numbers or as bools for booleans.
+    struct {
+      void *list_items;
+      size_t list_length;
+      ValueType list_type;
+    };
+    // For dictionary values.
+    struct Dict *dict_value;
+    // For range values: `range_length` numbers starting at `range_start`,
+    // `range_step` apart. They are computed when needed, never stored.
+    struct {
+      double range_start;
+      double range_step;
+      size_t range_length;
+    };
+  };
+} Value;
+
+// Function declarations for creating values.
+Value make_null(void);
+Value make_number(double value);
+Value make_integer(int64_t value);
+Value make_bigint(struct BigInt *value);
+Value make_boolean(bool value);
+Value make_string(const char *value, size_t length);
+Value make_list(ValueType item_type, size_t length);
+Value make_dict(struct Dict *dict);
+Value make_range(double start, double step, size_t length);
+
+// Function declarations for managing values.
+Value copy_value(Value value);
+void free_value(Value *value);
+bool is_truthy(Value value);
+double range_item(Value range, size_t index);
+bool is_numeric(Value value);
+bool is_integral(Value value);
+double number_to_double(Value value);
+struct BigInt *value_to_bigint(Value value);
+bool compare_numbers(Value left, Value right, int *order);
+uint64_t string_hash(Value *string);
+bool strings_equal(Value left, Value right);
+bool values_equal(Value left, Value right);
+const char *value_type_to_string(ValueType type);
+void print_value(FILE *stream, Value value);
+
+#endif
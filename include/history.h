@@ -0,0 +1,57 @@
+// history.h
+// Header file for the REPL command history. It defines the size-capped ring
+// of previous input lines, the trigram index used by reverse search and the
+// functions that load, extend and search it.
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define HISTORY_FILE ".noon_history"
+#define HISTORY_SIZE_ENV "NOON_HISTORY_SIZE"
+
+// Entries that contain one trigram, as sequence numbers in the order they
+// were added. Entries before `head` have been evicted from the ring.
+typedef struct {
+  uint32_t trigram; // 0 marks an empty slot
+  uint64_t *ids;
+  size_t head;
+  size_t count;
+  size_t capacity;
+} HistoryGram;
+
+/* Command history used only in REPL mode to store previous input lines.
+   Entry number `id` lives in `items[id % capacity]`; only the last `count`
+   entries are kept. */
+typedef struct {
+  char **items;
+  size_t capacity;
+  size_t count;
+  uint64_t next_id;
+  // Trigram index for reverse search (open addressing)
+  HistoryGram *grams;
+  size_t grams_count;
+  size_t grams_capacity;
+  FILE *file; // history file, opened for appending on the first new entry
+  bool loaded;
+} History;
+
+// Reads the last entries of the history file into the ring, compacting the
+// file when most of it is older than the ring can hold.
+void history_load(History *history);
+// Adds an entry to the ring and appends it to the history file.
+void history_add(History *history, const char *line);
+// Returns the entry `back` places from the newest one (1 is the newest), or
+// NULL if there is none.
+const char *history_get(const History *history, size_t back);
+// Finds the newest entry containing `query`, starting `*back` places from
+// the newest one and going back in time. Updates `*back` on a match.
+bool history_search(const History *history, const char *query, size_t *back);
+// Frees the entries and the index and closes the history file.
+void history_free(History *history);
+
+#endif
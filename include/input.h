@@ -7,6 +7,10 @@
 #define INPUT_H
 
 #include "config.h"
+#include "history.h"
+#include "stats.h"
+#include "utils/reader.h"
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #ifdef _WIN32
@@ -16,11 +20,27 @@ typedef SSIZE_T ssize_t;
 #include <sys/types.h>
 #endif
 
-/* Command history used only in REPL mode to store previous input lines */
+// Output format of diagnostics.
+typedef enum { DIAGNOSTICS_TEXT, DIAGNOSTICS_JSON, DIAGNOSTICS_SARIF } DiagnosticsFormat;
+
+/* Line being edited in the REPL, kept as a gap buffer: the text before the
+   cursor is at the start of `text`, the text after it at the end, and the
+   gap between them takes insertions without moving either side. */
 typedef struct {
-  char **items;
-  size_t count;
-} History;
+  char *text;
+  size_t capacity;
+  size_t gap_start; // cursor position
+  size_t gap_end;
+  // Terminal output of one keystroke, written at once
+  char *output;
+  size_t output_size;
+  size_t output_capacity;
+  // Rest of a bracketed paste that spans several lines
+  char *paste;
+  size_t paste_size;
+  size_t paste_offset;
+  size_t paste_capacity;
+} LineEditor;
 
 // Struct to hold all input state and command-line options.
 typedef struct {
@@ -28,20 +48,35 @@ typedef struct {
   const char *program_name;
   int is_repl;
   FILE *file;
+  LineReader reader; // splits `file` into lines outside the interactive REPL
   const char *input;
   // Command-line options
   int dump_tokens;
   int dump_ast;
   int check_syntax;
   int debug;
-  // Repl history
+  int use_cache;
+  int collect_logs; // save diagnostics as entries instead of printing them
+  DiagnosticsFormat diagnostics_format;
+  size_t max_errors; // stop after this many errors (0 means no limit)
+  int stream;        // keep only the lines of the current statement
+  StatsFormat stats; // print run statistics after the run
+  // Output streams
+  FILE *out_stream; // tokens, AST and summaries
+  FILE *log_stream; // diagnostics
+  // Repl history and line editor
   History history;
+  LineEditor editor;
 } NoonInput;
 
-// Global pointer to the input state.
-extern NoonInput *ni;
+// Pointer to the input state used by the current thread.
+extern _Thread_local NoonInput *ni;
 
-// initialize the global input state
+// allocate a new, independent input state
+NoonInput *create_input(void);
+// close the input file and free an input state
+void destroy_input(NoonInput *input);
+// initialize the input state of the current thread
 void init_input(void);
 // our custom getline version that works on all systems and supports REPL
 // history
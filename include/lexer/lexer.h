@@ -46,6 +46,13 @@ typedef enum { STATE_NORMAL, STATE_QUOTE, STATE_MULTI_COMMENT } LexerState;
 
 // Main lexer function declarations.
 void init_lexer(void);
+void load_line(const char *line, size_t length);
+void store_line(void);
+void lex_line(void);
+bool statement_complete(void);
+char peek_char(size_t offset);
+void process_statement(void);
 int lexer(void);
+void lex_source(const char *source, size_t length);
 
 #endif
@@ -8,6 +8,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 // Enum of all possible token types in the language.
 typedef enum {
@@ -96,7 +97,8 @@ typedef enum {
 // Struct representing a single token.
 typedef struct {
   TokenType token_type;
-  char *token_value;
+  uint32_t token_intern; // id of the interned spelling, 0 if not interned
+  const char *token_value; // for string and char literals, the decoded value
   size_t token_line;
   size_t token_index;
 } Token;
@@ -111,6 +113,7 @@ const char *token_type_to_string(TokenType type);
 bool is_unary(TokenType type);
 bool is_operator(TokenType type);
 void append_token(TokenType token_type, const char *token_value, size_t token_line, size_t token_col);
+void append_token_value(TokenType token_type, const char *token_value, size_t length, size_t token_line, size_t token_col);
 void print_tokens(void);
 void free_tokens(void);
 
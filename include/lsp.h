@@ -0,0 +1,53 @@
+// lsp.h
+// Header file for language-server mode. It declares the entry point of
+// `noon --lsp`, which speaks the Language Server Protocol over stdio and
+// publishes the lexer and parser diagnostics of every open document.
+
+#ifndef LSP_H
+#define LSP_H
+
+#include "lexer/tokens.h"
+#include "parser/ast.h"
+#include "utils/intern.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include <stddef.h>
+
+// A run of document lines that the lexer handles as one unit: it starts
+// and ends in the normal state with no open brackets, so it can be lexed
+// again on its own. Each chunk keeps the tokens, AST and diagnostics of the
+// statement it holds.
+typedef struct {
+  size_t first_line; // 0-based document line
+  size_t line_count;
+  size_t line_offset; // Added to 1-based lexer lines to get document lines.
+  Token *tokens;
+  size_t tokens_count;
+  Region token_values;
+  Node *ast;
+  LogEntry *logs;
+  size_t logs_count;
+} LspChunk;
+
+// A line of an open document, including its '\n' terminator if any.
+typedef struct {
+  char *text;
+  size_t length;
+} LspLine;
+
+// An open document.
+typedef struct {
+  char *uri;
+  LspLine *lines;
+  size_t lines_count;
+  size_t lines_capacity;
+  LspChunk *chunks;
+  size_t chunks_count;
+  size_t chunks_capacity;
+  InternTable interns; // Spellings of the chunks' tokens and ASTs.
+} LspDocument;
+
+// Serves LSP requests on stdin/stdout until the client exits.
+int lsp(void);
+
+#endif
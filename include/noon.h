@@ -0,0 +1,84 @@
+// noon.h
+// Public header of libnoon, the embeddable noon library. It lets a host
+// program evaluate noon source in-process and read back the result and the
+// structured diagnostics, without spawning the `noon` executable.
+//
+// A NoonState is an independent interpreter instance. Different states can be
+// used concurrently from different threads; a single state must not be used
+// from two threads at the same time.
+
+#ifndef NOON_H
+#define NOON_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define NOON_API __attribute__((visibility("default")))
+#else
+#define NOON_API
+#endif
+
+// Opaque interpreter instance.
+typedef struct NoonState NoonState;
+
+// Status returned by noon_eval.
+typedef enum { NOON_OK = 0, NOON_ERROR = 1 } NoonStatus;
+
+// Type of the value produced by the last evaluated statement.
+typedef enum { NOON_NULL, NOON_NUMBER, NOON_STRING, NOON_BOOLEAN, NOON_LIST, NOON_DICT, NOON_RANGE, NOON_INTEGER, NOON_BIGINT } NoonValueType;
+
+// Severity of a diagnostic.
+typedef enum { NOON_DIAGNOSTIC_ERROR, NOON_DIAGNOSTIC_WARNING, NOON_DIAGNOSTIC_INFO } NoonDiagnosticKind;
+
+// Result of the last successful statement. Strings and list items are owned
+// by the state and stay valid until the next noon_eval or noon_close. A list
+// has `length` items in `numbers`, or in `booleans` (0 or 1) for the result
+// of an element-wise comparison. A dictionary only reports its number of
+// entries in `length`. A range has `length` numbers, starting at `number`
+// and `step` apart. An integer is in `integer`, or for one too large for 64
+// bits, its decimal digits are in `string` and `length`; both also set
+// `number` to the nearest double.
+typedef struct {
+  NoonValueType type;
+  double number;
+  int boolean;
+  const char *string;
+  size_t length;
+  const double *numbers;
+  const unsigned char *booleans;
+  double step;
+  long long integer;
+} NoonResult;
+
+// A single diagnostic with a 1-based position in the evaluated source.
+typedef struct {
+  NoonDiagnosticKind kind;
+  size_t line;
+  size_t column;
+  const char *message;
+  const char *symbol;
+} NoonDiagnostic;
+
+// Creates a new interpreter instance, or returns NULL on failure.
+NOON_API NoonState *noon_open(void);
+// Evaluates `length` bytes of source. Returns NOON_ERROR if any error
+// diagnostic was produced.
+NOON_API NoonStatus noon_eval(NoonState *state, const char *source, size_t length);
+// Returns the result of the last statement evaluated by noon_eval.
+NOON_API const NoonResult *noon_result(const NoonState *state);
+// Returns the number of diagnostics produced by the last noon_eval.
+NOON_API size_t noon_diagnostic_count(const NoonState *state);
+// Returns a diagnostic of the last noon_eval, sorted by position.
+NOON_API const NoonDiagnostic *noon_diagnostic(const NoonState *state, size_t index);
+// Frees an interpreter instance.
+NOON_API void noon_close(NoonState *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
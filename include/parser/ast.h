@@ -9,26 +9,39 @@
 
 #include "lexer/tokens.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+struct BigInt;
 
 // Enum of all possible AST node types.
 typedef enum {
   NODE_NUMBER,
+  NODE_INTEGER,    // For integer literals that fit in 64 bits
+  NODE_BIGINT,     // For integer literals that don't
   NODE_CHAR,
   NODE_STRING,
   NODE_BOOLEAN,
   NODE_NULL,
   NODE_BINARY_OP,
   NODE_UNARY_OP,  // For prefix unary operators (e.g., ++x, -x)
-  NODE_POSTFIX_OP // For postfix unary operators (e.g., x++, x--)
+  NODE_POSTFIX_OP, // For postfix unary operators (e.g., x++, x--)
+  NODE_CONCAT,     // For chains of string '+' (e.g., "a" + "b" + "c")
+  NODE_LIST,       // For list literals (e.g., [1, 2, 3])
+  NODE_DICT,       // For dictionary literals (e.g., {"a": 1})
+  NODE_RANGE,      // Type of range expressions (e.g., 0 ... 9); they are binary nodes
+  NODE_CALL        // For builtin function calls (e.g., len(x))
 } NodeType;
 
 // The main struct for an AST node.
 typedef struct Node {
   NodeType node_type;
+  NodeType expression_type; // Type of the value, used for type checking.
   Token token; // Stores the original token for location/value info.
   union {
     double number_value;
-    char *string_value;
+    int64_t integer_value;
+    struct BigInt *bigint_value;
+    const char *string_value; // interned value of the literal, escapes decoded
     bool boolean_value;
 
     // For binary operation nodes.
@@ -36,6 +49,8 @@ typedef struct Node {
       struct Node *left;
       struct Node *right;
       Token op;
+      unsigned char power;    // for `**`: a PowerKind from eval/power.h
+      unsigned char exponent; // the exponent when `power` is POWER_SMALL
     } binary;
 
     // For both prefix and postfix unary nodes.
@@ -43,11 +58,46 @@ typedef struct Node {
       struct Node *operand;
       Token op;
     } unary;
+
+    // For string concatenation: every operand of the chain, in order.
+    struct {
+      struct Node **parts;
+      size_t count;
+      size_t capacity;
+      Token op; // The first '+' of the chain.
+    } concat;
+
+    // For list literals: the item expressions, in order.
+    struct {
+      struct Node **items;
+      size_t count;
+      size_t capacity;
+    } list;
+
+    // For dictionary literals: keys and values alternate, so entry `i` is
+    // `entries[2 * i]: entries[2 * i + 1]` and `count` is twice the number
+    // of entries.
+    struct {
+      struct Node **entries;
+      size_t count;
+      size_t capacity;
+    } dict;
+
+    // For builtin function calls: the argument expressions, in order.
+    struct {
+      struct Node **args;
+      size_t count;
+      size_t capacity;
+      Token name;
+      unsigned builtin; // a Builtin from eval/builtins.h
+    } call;
   };
 } Node;
 
 // Function declarations for creating different types of AST nodes.
 Node *create_number_node(Token token, double value);
+Node *create_integer_node(Token token, int64_t value);
+Node *create_bigint_node(Token token, struct BigInt *value);
 Node *create_char_node(Token token, const char *value);
 Node *create_string_node(Token token, const char *value);
 Node *create_boolean_node(Token token, bool value);
@@ -55,6 +105,22 @@ Node *create_null_node(Token token);
 Node *create_binary_op_node(Token op, Node *left, Node *right);
 Node *create_unary_op_node(Token op, Node *operand);
 Node *create_postfix_op_node(Token op, Node *operand);
+Node *create_list_node(Token token);
+bool append_list_item(Node *list, Node *item);
+Node *create_dict_node(Token token);
+bool append_dict_entry(Node *dict, Node *key, Node *value);
+Node *create_call_node(Token name);
+void append_call_argument(Node *call, Node *arg);
+bool check_call(Node *call);
+
+// Function declarations for string and char literals, whose values are
+// interned and may hold NUL bytes.
+bool is_string_literal(const Node *node);
+size_t literal_length(const Node *node);
+
+// Returns the first token of an expression, for diagnostics that point at
+// where it starts.
+Token node_start(const Node *node);
 
 // Function declarations for managing the AST.
 void free_node(Node *node);
@@ -22,6 +22,7 @@ Node *parse_logical_or(void);
 Node *parse_logical_and(void);
 Node *parse_equality(void);
 Node *parse_relational(void);
+Node *parse_range(void);
 
 // Declarations for the highest precedence levels.
 Node *parse_factor(void);
@@ -0,0 +1,31 @@
+// server.h
+// Header file for daemon mode. It defines the framing of requests and
+// responses exchanged over the Unix domain socket and declares the entry
+// point of `noon --serve`.
+//
+// Every message starts with a 12-byte header: the magic "NOON", one byte
+// (the request mode, or the response status), three zero bytes and the
+// length of the body as a 32-bit big-endian integer. A request body is the
+// source to process; a response body is the text the command line would
+// print for the same source (tokens, AST, diagnostics, summary and, in eval
+// mode, the result). A connection may carry any number of requests.
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+
+#define SERVE_MAGIC "NOON"
+#define SERVE_HEADER_SIZE 12
+#define SERVE_MAX_REQUEST (64u << 20)
+
+// What to do with the source of a request.
+typedef enum { SERVE_TOKENS = 0, SERVE_AST = 1, SERVE_CHECK = 2, SERVE_EVAL = 3 } ServeMode;
+
+// Status byte of a response.
+typedef enum { SERVE_OK = 0, SERVE_ERROR = 1, SERVE_BAD_REQUEST = 2 } ServeStatus;
+
+// Listens on `path` and serves requests until the process is terminated.
+int serve(const char *path);
+
+#endif
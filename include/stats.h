@@ -0,0 +1,39 @@
+// stats.h
+// Header file for run statistics. It defines the counters and phase timers
+// that `--stats` reports after a run, and declares the functions that
+// update and print them.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Output format of the statistics.
+typedef enum { STATS_NONE, STATS_TEXT, STATS_JSON } StatsFormat;
+
+// Phases of a run that are timed separately.
+typedef enum { STATS_READ, STATS_LEX, STATS_PARSE, STATS_EVAL, STATS_DIAGNOSTICS, STATS_PHASES } StatsPhase;
+
+// Work done by one context.
+typedef struct {
+  uint64_t phase_time[STATS_PHASES]; // nanoseconds
+  size_t bytes;
+  size_t lines;
+  size_t tokens;
+  size_t nodes;
+} Stats;
+
+// Starts the run clock and turns on allocation counting.
+void begin_stats(void);
+// Returns the current time in nanoseconds, or 0 if statistics are off.
+uint64_t stats_clock(void);
+// Adds the time since `start` (from stats_clock) to a phase.
+void stats_add(StatsPhase phase, uint64_t start);
+// Adds the counters of one run to another (used to merge batch workers).
+void merge_stats(Stats *into, const Stats *from);
+// Prints the statistics of the current context to stderr.
+void print_stats(void);
+
+#endif
@@ -0,0 +1,53 @@
+// utils/intern.h
+// Header file for the string interning table. It defines the table that
+// stores each distinct identifier and literal spelling once, and declares
+// the functions that look spellings up and release them.
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "utils/memory.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// One distinct spelling. Its bytes are NUL-terminated and never move.
+typedef struct {
+  const char *bytes;
+  size_t length;
+  uint64_t hash;
+} InternString;
+
+// An index slot: the id of a spelling and the top bits of its hash, so most
+// mismatches are rejected without touching the spelling.
+typedef struct {
+  uint32_t id; // 0 marks an empty slot
+  uint32_t tag;
+} InternSlot;
+
+// Table of interned spellings (open addressing). Spelling `id` is
+// `strings[id - 1]`; the bytes live in `bytes`.
+typedef struct {
+  InternSlot *slots;
+  size_t slots_capacity; // a power of two
+  InternString *strings;
+  size_t count;
+  size_t capacity;
+  Region bytes;
+  size_t bytes_size;
+} InternTable;
+
+// Returns the id of a spelling, adding it to the table if it is new.
+uint32_t intern(InternTable *table, const char *bytes, size_t length);
+// Returns the bytes of an interned spelling.
+const char *intern_string(const InternTable *table, uint32_t id);
+// Returns the length of an interned spelling, which may hold NUL bytes.
+size_t intern_length(const InternTable *table, uint32_t id);
+// Returns the hash of an interned spelling.
+uint64_t intern_hash(const InternTable *table, uint32_t id);
+// Forgets every spelling once they take more than `limit` bytes. Only call
+// it when no token or node refers to the table.
+void intern_trim(InternTable *table, size_t limit);
+// Frees the table and its spellings.
+void intern_free(InternTable *table);
+
+#endif
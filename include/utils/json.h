@@ -0,0 +1,44 @@
+// utils/json.h
+// Header file for the small JSON reader and writer used by the language
+// server. It parses a complete document into a tree of values and writes
+// strings with the escaping JSON requires.
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Kinds of JSON values.
+typedef enum { JSON_NULL, JSON_BOOLEAN, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT } JsonType;
+
+// A parsed JSON value. Arrays and objects keep their members in `items`;
+// objects also keep the matching member names in `keys`.
+typedef struct JsonValue {
+  JsonType json_type;
+  bool boolean_value;
+  double number_value;
+  char *string_value;
+  size_t string_length;
+  struct JsonValue *items;
+  char **keys;
+  size_t items_count;
+} JsonValue;
+
+// Parses `length` bytes of JSON. Returns false on malformed input.
+bool json_parse(const char *text, size_t length, JsonValue *value);
+// Returns the member of an object with the given name, or NULL.
+const JsonValue *json_get(const JsonValue *object, const char *key);
+// Returns the string of a value, or NULL if it is not a string.
+const char *json_string(const JsonValue *value);
+// Returns the number of a value, or `fallback` if it is not a number.
+double json_number(const JsonValue *value, double fallback);
+// Writes a value back as JSON.
+void json_print(FILE *stream, const JsonValue *value);
+// Writes a quoted and escaped JSON string.
+void json_print_string(FILE *stream, const char *string, size_t length);
+// Frees everything owned by a value.
+void json_free(JsonValue *value);
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "input.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 /* Log message types */
@@ -27,6 +28,15 @@ typedef struct {
   LogType log_type;
 } LogEntry;
 
+/* A message counted for deduplication. */
+typedef struct {
+  uint64_t hash; // 0 marks an empty slot
+  char *message;
+  size_t count;
+  size_t first_seen; // order of the first occurrence
+  LogType log_type;
+} LogDuplicate;
+
 /* Sort logs by line and column. */
 void sort_logs(void);
 
@@ -40,6 +50,15 @@ void print_summary(void);
 void print_log(int log_type, const char *fmt, LogPosition log_position, const char *symbol_str, ...);
 /* Save a log message to be printed later. */
 void save_log(int log_type, const char *fmt, LogPosition log_position, const char *symbol_str, ...);
+/* Format a count with thousands separators (e.g. "41,233"). */
+void format_count(size_t count, char *buffer, size_t size);
+/* Write the buffered diagnostics to the log stream. */
+void flush_logs(void);
+/* Report duplicates, dropped logs and the error limit, if any. */
+void report_suppressed_logs(void);
+/* Start and end a machine-readable diagnostics document. */
+void begin_diagnostics(void);
+void end_diagnostics(void);
 /* Resets the logging system to a clean initial state. */
 void reset_logs(void);
 
@@ -14,12 +14,37 @@
 #include <stdlib.h>
 #include <string.h>
 
+// A block of region memory.
+typedef struct RegionBlock {
+  struct RegionBlock *next;
+  size_t size;
+  size_t used;
+  char data[];
+} RegionBlock;
+
+// Memory that is handed out by bumping a pointer and released all at once.
+// Resetting keeps the blocks, so a region that is filled and reset over and
+// over stops allocating once it reaches its high-water size.
+typedef struct {
+  RegionBlock *first;
+  RegionBlock *current;
+} Region;
+
 // Safe memory allocation wrappers.
 void *safe_malloc(size_t n);
 void *safe_calloc(size_t nmemb, size_t size);
 void *safe_realloc(void *ptr, size_t new_size);
 char *safe_strdup(const char *s);
 
+// Allocation counting for --stats.
+void count_allocations(void);
+void allocation_stats(size_t *count, size_t *bytes);
+
+// Region allocation.
+void *region_alloc(Region *region, size_t size);
+void region_reset(Region *region);
+void region_free(Region *region);
+
 // Safe character access function.
 char safe_char(const char *s, size_t char_pos);
 
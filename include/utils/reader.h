@@ -0,0 +1,35 @@
+// utils/reader.h
+// Header file for the block line reader. It defines the reader state used
+// to split file and pipe input into lines and declares its functions.
+
+#ifndef READER_H
+#define READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Reads input in large blocks and hands out one line at a time. A line that
+// fits in the current block is returned as a view into it; only a line
+// spanning two or more blocks is gathered in the carry buffer.
+typedef struct {
+  FILE *file;
+  int fd; // descriptor read directly, or -1 to go through `file`
+  char *block;
+  size_t start; // first unread byte of the block
+  size_t end;   // end of the valid bytes of the block
+  char *carry;
+  size_t carry_size;
+  size_t carry_capacity;
+  bool eof;
+} LineReader;
+
+// Starts reading `file` from its current position.
+void reader_open(LineReader *reader, FILE *file);
+// Returns the next line, including its newline, and stores its length.
+// The line stays valid until the next call. Returns NULL at end of input.
+const char *read_line(LineReader *reader, size_t *length);
+// Frees the buffers of a reader.
+void reader_free(LineReader *reader);
+
+#endif
@@ -5,9 +5,14 @@
 #ifndef STRING_H
 #define STRING_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 // Counts the number of digits in an integer.
 int number_count(int number);
 // Checks if a string is NULL or contains only whitespace.
 int is_nothing(const char *str);
+// Computes a 64-bit FNV-1a hash of a byte buffer.
+uint64_t hash_bytes(const void *data, size_t size);
 
 #endif
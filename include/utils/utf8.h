@@ -0,0 +1,30 @@
+// utils/utf8.h
+// Header file for UTF-8 text. It declares the functions that validate and
+// decode source text, and the Unicode properties the lexer uses for
+// identifiers and the diagnostics use for display columns.
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Returns the length of the longest prefix of `bytes` that is ASCII.
+size_t utf8_ascii_prefix(const char *bytes, size_t length);
+// Returns the length of the longest prefix of `bytes` that is valid UTF-8.
+// ASCII runs are checked a block at a time.
+size_t utf8_valid_prefix(const char *bytes, size_t length);
+// Decodes the character at `bytes`, which ends at a NUL byte at the
+// latest, and stores its length. Returns 0 with a length of 0 if the bytes
+// are not a valid UTF-8 character.
+uint32_t utf8_decode(const char *bytes, size_t *length);
+// Returns the number of terminal columns the first `length` bytes take.
+size_t utf8_width(const char *bytes, size_t length);
+
+// Function declarations for the properties of characters outside ASCII.
+bool is_xid_start(uint32_t code);
+bool is_xid_continue(uint32_t code);
+int char_width(uint32_t code);
+
+#endif
@@ -0,0 +1,305 @@
+// batch.c
+// This file implements batch syntax checking. The files to check are
+// collected up front (directories are walked recursively in sorted order),
+// then a fixed pool of worker threads claims them one at a time. Each worker
+// owns one context and input state that it reuses for every file, and
+// captures the diagnostics of each file in memory. The main thread prints
+// the captured output in input order, so the result is deterministic no
+// matter how the work was scheduled.
+
+#include "batch.h"
+#include "config.h"
+#include "context.h"
+#include "input.h"
+#include "lexer/lexer.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A single file to check and the output captured while checking it.
+typedef struct {
+  char *path;
+  char *output;
+  size_t output_size;
+  int total_errors;
+  int total_warnings;
+  int total_infos;
+  Stats stats; // work done on this file, summed into the run's --stats
+  bool done;
+} BatchJob;
+
+// The list of jobs shared by the workers.
+typedef struct {
+  BatchJob *jobs;
+  size_t jobs_count;
+  size_t jobs_capacity;
+  size_t next_job; // Index of the next job to be claimed by a worker.
+  const NoonInput *options;
+#ifndef _WIN32
+  pthread_mutex_t lock;
+  pthread_cond_t job_done;
+#endif
+} BatchQueue;
+
+// Checks whether a path names a directory.
+bool is_directory(const char *path) {
+  debug_func("path: %s", path);
+#ifdef _WIN32
+  DWORD attributes = GetFileAttributesA(path);
+  return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+  struct stat st;
+  return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+// Returns the default number of worker threads.
+int default_jobs(void) {
+#ifdef _WIN32
+  return 1;
+#else
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? (int)cpus : 1;
+#endif
+}
+
+// Appends a file to the job list.
+static void add_job(BatchQueue *queue, const char *path) {
+  if (queue->jobs_count >= queue->jobs_capacity) {
+    size_t new_cap = queue->jobs_capacity ? queue->jobs_capacity * 2 : INITIAL_CAPACITY;
+    queue->jobs = safe_realloc(queue->jobs, new_cap * sizeof(BatchJob));
+    queue->jobs_capacity = new_cap;
+  }
+  BatchJob *job = &queue->jobs[queue->jobs_count++];
+  memset(job, 0, sizeof(*job));
+  job->path = safe_strdup(path);
+}
+
+// Comparison function for qsort to sort directory entries by name.
+static int compare_names(const void *a, const void *b) { return strcmp(*(const char *const *)a, *(const char *const *)b); }
+
+// Checks whether a file name ends with the source file extension.
+static bool is_source_file(const char *name) {
+  size_t length = strlen(name);
+  size_t extension = strlen(SOURCE_EXTENSION);
+  return length > extension && strcmp(name + length - extension, SOURCE_EXTENSION) == 0;
+}
+
+// Adds every source file below a directory, visiting entries in sorted
+// order so the job list does not depend on the file system.
+static void add_directory(BatchQueue *queue, const char *dir_path) {
+  debug_func("dir_path: %s", dir_path);
+#ifdef _WIN32
+  add_job(queue, dir_path);
+#else
+  DIR *dir = opendir(dir_path);
+  if (!dir) {
+    add_job(queue, dir_path); // Reported as unreadable by the worker.
+    return;
+  }
+  char **names = NULL;
+  size_t count = 0, capacity = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+    if (count >= capacity) {
+      capacity = capacity ? capacity * 2 : INITIAL_CAPACITY;
+      names = safe_realloc(names, capacity * sizeof(char *));
+    }
+    names[count++] = safe_strdup(entry->d_name);
+  }
+  closedir(dir);
+  qsort(names, count, sizeof(char *), compare_names);
+
+  for (size_t i = 0; i < count; i++) {
+    size_t size = strlen(dir_path) + strlen(names[i]) + 2;
+    char *path = safe_malloc(size);
+    snprintf(path, size, "%s/%s", dir_path, names[i]);
+    if (is_directory(path))
+      add_directory(queue, path);
+    else if (is_source_file(names[i]))
+      add_job(queue, path);
+    free(path);
+    free(names[i]);
+  }
+  free(names);
+#endif
+}
+
+// Checks one file with the worker's context, capturing its diagnostics.
+static void run_job(BatchJob *job) {
+  debug_func("path: %s", job->path);
+  FILE *stream = NULL;
+#ifndef _WIN32
+  stream = open_memstream(&job->output, &job->output_size);
+#endif
+  ni->log_stream = stream ? stream : stderr;
+  ni->out_stream = ni->log_stream;
+  ni->input = job->path;
+
+  ni->file = fopen(job->path, "r");
+  if (!ni->file && ni->diagnostics_format != DIAGNOSTICS_TEXT) {
+    // Keep machine-readable output a valid document.
+    reset_context(ctx);
+    print_log(LOG_ERROR, ERR_NO_SUCH_FILE, (LogPosition){0, 0}, NULL);
+    flush_logs();
+    job->total_errors = 1;
+  } else if (!ni->file) {
+    fprintf(ni->log_stream, ERR_NO_FILE, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, job->path);
+    job->total_errors = 1;
+  } else {
+    reset_context(ctx);
+    lexer();
+    report_suppressed_logs();
+    flush_logs();
+    job->total_errors = ctx->total_errors;
+    job->total_warnings = ctx->total_warnings;
+    job->total_infos = ctx->total_infos;
+    job->stats = ctx->stats;
+    fclose(ni->file);
+    ni->file = NULL;
+  }
+  if (stream)
+    fclose(stream);
+}
+
+// Creates the per-thread input state with the options given on the command
+// line.
+static void init_worker(const NoonInput *options) {
+  ni = create_input();
+  ni->program_name = options->program_name;
+  ni->debug = options->debug;
+  ni->use_cache = options->use_cache;
+  ni->diagnostics_format = options->diagnostics_format;
+  ni->max_errors = options->max_errors;
+  ni->stats = options->stats;
+  ni->check_syntax = 1;
+  ctx = create_context();
+}
+
+// Frees the per-thread context and input state.
+static void destroy_worker(void) {
+  destroy_context(ctx);
+  ctx = NULL;
+  destroy_input(ni);
+  ni = NULL;
+}
+
+#ifndef _WIN32
+// Worker thread: claims jobs until none are left.
+static void *batch_worker(void *arg) {
+  BatchQueue *queue = arg;
+  init_worker(queue->options);
+  while (1) {
+    pthread_mutex_lock(&queue->lock);
+    size_t index = queue->next_job++;
+    pthread_mutex_unlock(&queue->lock);
+    if (index >= queue->jobs_count)
+      break;
+
+    run_job(&queue->jobs[index]);
+
+    pthread_mutex_lock(&queue->lock);
+    queue->jobs[index].done = true;
+    pthread_cond_broadcast(&queue->job_done);
+    pthread_mutex_unlock(&queue->lock);
+  }
+  destroy_worker();
+  return NULL;
+}
+#endif
+
+// Prints the captured output of a finished job and frees it.
+static void flush_job(BatchJob *job) {
+  size_t diagnostics = (size_t)(job->total_errors + job->total_warnings + job->total_infos);
+  if (job->output_size) {
+    // Machine-readable diagnostics of each file start without a separator.
+    if (ni->diagnostics_format != DIAGNOSTICS_TEXT && ctx->logs_emitted)
+      fputc(',', ni->log_stream);
+    ctx->logs_emitted += diagnostics;
+    fwrite(job->output, 1, job->output_size, ni->log_stream);
+  }
+  merge_stats(&ctx->stats, &job->stats);
+  free(job->output);
+  job->output = NULL;
+  free(job->path);
+  job->path = NULL;
+}
+
+// Checks every file in `paths` on a pool of `jobs` worker threads.
+int check_files(const char **paths, size_t path_count, int jobs) {
+  debug_func("path_count: %zu, jobs: %d", path_count, jobs);
+  if (!ctx)
+    init_context();
+  flush_logs(); // Anything already buffered goes before the files.
+  BatchQueue queue;
+  memset(&queue, 0, sizeof(queue));
+  queue.options = ni;
+  for (size_t i = 0; i < path_count; i++) {
+    if (is_directory(paths[i]))
+      add_directory(&queue, paths[i]);
+    else
+      add_job(&queue, paths[i]);
+  }
+
+  int total_errors = 0, total_warnings = 0, total_infos = 0;
+#ifdef _WIN32
+  (void)jobs;
+  NoonInput *main_input = ni;
+  init_worker(queue.options);
+  for (size_t i = 0; i < queue.jobs_count; i++)
+    run_job(&queue.jobs[i]);
+  destroy_worker();
+  ni = main_input;
+  for (size_t i = 0; i < queue.jobs_count; i++) {
+#else
+  if (jobs < 1)
+    jobs = 1;
+  if ((size_t)jobs > queue.jobs_count)
+    jobs = queue.jobs_count ? (int)queue.jobs_count : 1;
+  pthread_mutex_init(&queue.lock, NULL);
+  pthread_cond_init(&queue.job_done, NULL);
+  pthread_t *threads = safe_malloc((size_t)jobs * sizeof(pthread_t));
+  for (int t = 0; t < jobs; t++)
+    pthread_create(&threads[t], NULL, batch_worker, &queue);
+
+  // Print each file as soon as it and every file before it are done.
+  for (size_t i = 0; i < queue.jobs_count; i++) {
+    pthread_mutex_lock(&queue.lock);
+    while (!queue.jobs[i].done)
+      pthread_cond_wait(&queue.job_done, &queue.lock);
+    pthread_mutex_unlock(&queue.lock);
+#endif
+    flush_job(&queue.jobs[i]);
+    total_errors += queue.jobs[i].total_errors;
+    total_warnings += queue.jobs[i].total_warnings;
+    total_infos += queue.jobs[i].total_infos;
+  }
+#ifndef _WIN32
+  for (int t = 0; t < jobs; t++)
+    pthread_join(threads[t], NULL);
+  free(threads);
+  pthread_cond_destroy(&queue.job_done);
+  pthread_mutex_destroy(&queue.lock);
+#endif
+  free(queue.jobs);
+
+  // Hand the totals to this thread's context so cleanup prints the summary.
+  ctx->total_errors = total_errors;
+  ctx->total_warnings = total_warnings;
+  ctx->total_infos = total_infos;
+  return (total_errors || total_warnings || total_infos) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,375 @@
+// cache.c
+// This file implements the on-disk compiled cache. After a clean run over a
+// source file, the token stream of every statement, the constant pool holding
+// the token values and the line table are written as a versioned `.noonc`
+// image keyed by the source hash and the build ID. Later runs map the image
+// and replay it through the parser instead of lexing the file again.
+
+#include "cache.h"
+#include "config.h"
+#include "context.h"
+#include "input.h"
+#include "lexer/lexer.h"
+#include "lexer/tokens.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include "utils/strings.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Rounds a size up to the 8-byte alignment used by the image sections.
+static size_t align8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+// Identifies the lexer output an image holds: the format version, the
+// layout of the image and the symbol table the lexer matches against. It
+// depends only on the source, so builds stay reproducible; changes to the
+// lexer that these do not capture must bump CACHE_VERSION.
+static uint64_t build_id(void) {
+  char build[128];
+  int n = snprintf(build, sizeof(build), "v%d t%d s%zu h%zu", CACHE_VERSION, (int)TOKEN_UNKNOWN, sizeof(CacheToken), sizeof(CacheHeader));
+  uint64_t id = hash_bytes(build, (size_t)n);
+  for (size_t i = 0; i < NUM_SYMBOLS; i++) {
+    id = id * 31 + hash_bytes(symbols[i].symbol, strlen(symbols[i].symbol));
+    id = id * 31 + (uint64_t)symbols[i].type;
+  }
+  return id;
+}
+
+#ifndef _WIN32
+// Returns the directory that holds cache images, or NULL if none can be found.
+static bool cache_directory(char *dir, size_t size) {
+  const char *env = getenv("NOON_CACHE_DIR");
+  if (env && *env) {
+    snprintf(dir, size, "%s", env);
+    return true;
+  }
+  env = getenv("XDG_CACHE_HOME");
+  if (env && *env) {
+    snprintf(dir, size, "%s/noon", env);
+    return true;
+  }
+  env = getenv("HOME");
+  if (env && *env) {
+    snprintf(dir, size, "%s/.cache/noon", env);
+    return true;
+  }
+  return false;
+}
+
+// Creates a directory and all of its missing parents.
+static bool make_directories(char *path) {
+  for (char *p = path + 1; *p; p++) {
+    if (*p != '/')
+      continue;
+    *p = '\0';
+    int rc = mkdir(path, 0755);
+    *p = '/';
+    if (rc != 0 && errno != EEXIST)
+      return false;
+  }
+  return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+#endif
+
+// Reads the whole input file so it can be hashed, then rewinds it for the
+// lexer in case there is no usable image.
+bool cache_open(void) {
+  debug_func("");
+#ifdef _WIN32
+  return false;
+#else
+  if (!ni->use_cache || ni->is_repl || ni->stream || !ni->file || ni->file == stdin)
+    return false;
+
+  int fd = fileno(ni->file);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    return false;
+
+  char dir[1024];
+  if (!cache_directory(dir, sizeof(dir)))
+    return false;
+
+  CacheBuilder *cache = safe_calloc(1, sizeof(CacheBuilder));
+  cache->source = safe_malloc((size_t)st.st_size + 1);
+  cache->source_size = fread(cache->source, 1, (size_t)st.st_size, ni->file);
+  cache->source[cache->source_size] = '\0';
+  rewind(ni->file);
+
+  cache->source_hash = hash_bytes(cache->source, cache->source_size);
+  size_t path_size = strlen(dir) + 64;
+  cache->path = safe_malloc(path_size);
+  snprintf(cache->path, path_size, "%s/%016llx%016llx%s", dir, (unsigned long long)cache->source_hash, (unsigned long long)build_id(), CACHE_EXTENSION);
+  ctx->cache = cache;
+  return true;
+#endif
+}
+
+// Checks that a section of `count` elements of `size` bytes lies inside the
+// image.
+static bool section_fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t image_size) {
+  if (offset % 8 != 0 || offset > image_size)
+    return false;
+  if (size != 0 && count > (image_size - offset) / size)
+    return false;
+  return true;
+}
+
+// Validates a mapped image against the current source and build.
+static bool validate_image(const unsigned char *image, size_t image_size) {
+  debug_func("image_size: %zu", image_size);
+  CacheBuilder *cache = ctx->cache;
+  if (image_size < sizeof(CacheHeader))
+    return false;
+  const CacheHeader *header = (const CacheHeader *)image;
+  if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != CACHE_VERSION || header->header_size != sizeof(CacheHeader))
+    return false;
+  if (header->build_id != build_id() || header->source_hash != cache->source_hash || header->source_size != cache->source_size || header->image_size != image_size)
+    return false;
+
+  // Every section must be inside the image before anything is dereferenced.
+  if (!section_fits(header->lines_offset, header->line_count + 1, sizeof(uint64_t), image_size) ||
+      !section_fits(header->statements_offset, header->statement_count, sizeof(CacheStatement), image_size) ||
+      !section_fits(header->tokens_offset, header->token_count, sizeof(CacheToken), image_size) || !section_fits(header->pool_offset, header->pool_size, 1, image_size))
+    return false;
+  if (header->payload_hash != hash_bytes(image + sizeof(CacheHeader), image_size - sizeof(CacheHeader)))
+    return false;
+
+  // The line table must cover the source exactly, in order.
+  const uint64_t *lines = (const uint64_t *)(image + header->lines_offset);
+  if (lines[0] != 0 || lines[header->line_count] != cache->source_size)
+    return false;
+  for (uint64_t i = 0; i < header->line_count; i++) {
+    if (lines[i] > lines[i + 1])
+      return false;
+  }
+
+  // Statements must reference existing tokens and tokens existing pool entries.
+  const CacheStatement *statements = (const CacheStatement *)(image + header->statements_offset);
+  for (uint64_t i = 0; i < header->statement_count; i++) {
+    if (statements[i].first_token > header->token_count || statements[i].token_count > header->token_count - statements[i].first_token)
+      return false;
+  }
+  const CacheToken *tokens = (const CacheToken *)(image + header->tokens_offset);
+  const char *pool = (const char *)(image + header->pool_offset);
+  if (header->pool_size == 0 || pool[header->pool_size - 1] != '\0')
+    return false;
+  for (uint64_t i = 0; i < header->token_count; i++) {
+    if (tokens[i].token_type > TOKEN_UNKNOWN || tokens[i].value_offset >= header->pool_size || tokens[i].value_length >= header->pool_size - tokens[i].value_offset ||
+        pool[tokens[i].value_offset + tokens[i].value_length] != '\0')
+      return false;
+  }
+  return true;
+}
+
+// Loads a valid image and replays its statements through the parser.
+bool cache_replay(void) {
+  debug_func("");
+#ifdef _WIN32
+  return false;
+#else
+  CacheBuilder *cache = ctx->cache;
+  if (!cache)
+    return false;
+
+  int fd = open(cache->path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CacheHeader)) {
+    close(fd);
+    unlink(cache->path); // Truncated image, rebuild it.
+    return false;
+  }
+  size_t image_size = (size_t)st.st_size;
+  unsigned char *image = mmap(NULL, image_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED)
+    return false;
+
+  if (!validate_image(image, image_size)) {
+    munmap(image, image_size);
+    unlink(cache->path); // Stale or corrupt image, rebuild it.
+    return false;
+  }
+
+  const CacheHeader *header = (const CacheHeader *)image;
+  const uint64_t *lines = (const uint64_t *)(image + header->lines_offset);
+  const CacheStatement *statements = (const CacheStatement *)(image + header->statements_offset);
+  const CacheToken *tokens = (const CacheToken *)(image + header->tokens_offset);
+  const char *pool = (const char *)(image + header->pool_offset);
+
+  // Restore the source lines so diagnostics can still quote them.
+  if (header->line_count > ctx->lines_capacity) {
+    ctx->lines = safe_realloc(ctx->lines, header->line_count * sizeof(char *));
+    ctx->lines_capacity = header->line_count;
+  }
+  for (uint64_t i = 0; i < header->line_count; i++) {
+    size_t length = lines[i + 1] - lines[i];
+    char *line = safe_malloc(length + 1);
+    memcpy(line, cache->source + lines[i], length);
+    line[length] = '\0';
+    line[strcspn(line, "\n")] = '\0';
+    ctx->lines[ctx->line_number++] = line;
+  }
+
+  // Feed every statement to the parser exactly as the lexer did.
+  for (uint64_t s = 0; s < header->statement_count; s++) {
+    const CacheToken *first = tokens + statements[s].first_token;
+    for (uint64_t t = 0; t < statements[s].token_count; t++) {
+      append_token_value((TokenType)first[t].token_type, pool + first[t].value_offset, first[t].value_length, first[t].token_line, first[t].token_index);
+    }
+    process_statement();
+  }
+
+  munmap(image, image_size);
+  return true;
+#endif
+}
+
+// Appends `length` bytes of a token value and a NUL to the constant pool
+// and returns their offset.
+static size_t pool_append(CacheBuilder *cache, const char *value, size_t length) {
+  length++;
+  if (cache->pool_size + length > cache->pool_capacity) {
+    size_t new_cap = cache->pool_capacity ? cache->pool_capacity * 2 : 1024;
+    while (new_cap < cache->pool_size + length)
+      new_cap *= 2;
+    cache->pool = safe_realloc(cache->pool, new_cap);
+    cache->pool_capacity = new_cap;
+  }
+  size_t offset = cache->pool_size;
+  memcpy(cache->pool + offset, value, length);
+  cache->pool_size += length;
+  return offset;
+}
+
+// Records the statement currently held in the token list.
+void cache_record_statement(void) {
+  debug_func("");
+  CacheBuilder *cache = ctx->cache;
+  if (!cache)
+    return;
+
+  if (cache->statements_count >= cache->statements_capacity) {
+    size_t new_cap = cache->statements_capacity ? cache->statements_capacity * 2 : INITIAL_CAPACITY;
+    cache->statements = safe_realloc(cache->statements, new_cap * sizeof(CacheStatement));
+    cache->statements_capacity = new_cap;
+  }
+  cache->statements[cache->statements_count++] = (CacheStatement){cache->tokens_count, ctx->tokens_count};
+
+  for (size_t i = 0; i < ctx->tokens_count; i++) {
+    if (cache->tokens_count >= cache->tokens_capacity) {
+      size_t new_cap = cache->tokens_capacity ? cache->tokens_capacity * 2 : INITIAL_CAPACITY;
+      cache->tokens = safe_realloc(cache->tokens, new_cap * sizeof(CacheToken));
+      cache->tokens_capacity = new_cap;
+    }
+    const Token *token = &ctx->tokens[i];
+    const char *value = token->token_value ? token->token_value : "";
+    size_t length = token->token_intern ? intern_length(&ctx->interns, token->token_intern) : strlen(value);
+    size_t offset = pool_append(cache, value, length);
+    cache->tokens[cache->tokens_count++] = (CacheToken){(uint32_t)token->token_type, (uint32_t)offset, length, token->token_line, token->token_index};
+  }
+}
+
+// Serializes the recorded statements and writes them atomically next to the
+// other images.
+void cache_store(void) {
+  debug_func("");
+#ifndef _WIN32
+  CacheBuilder *cache = ctx->cache;
+  if (!cache || cache->pool_size > UINT32_MAX)
+    return;
+  if (cache->pool_size == 0)
+    pool_append(cache, "", 0);
+
+  // Build the line table the same way the lexer splits lines.
+  size_t line_count = 0;
+  for (const char *p = cache->source, *end = cache->source + cache->source_size; p < end; line_count++) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    p = nl ? nl + 1 : end;
+  }
+
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  header.version = CACHE_VERSION;
+  header.header_size = sizeof(CacheHeader);
+  header.build_id = build_id();
+  header.source_hash = cache->source_hash;
+  header.source_size = cache->source_size;
+  header.line_count = line_count;
+  header.statement_count = cache->statements_count;
+  header.token_count = cache->tokens_count;
+  header.pool_size = cache->pool_size;
+  header.lines_offset = align8(sizeof(CacheHeader));
+  header.statements_offset = align8(header.lines_offset + (line_count + 1) * sizeof(uint64_t));
+  header.tokens_offset = align8(header.statements_offset + cache->statements_count * sizeof(CacheStatement));
+  header.pool_offset = align8(header.tokens_offset + cache->tokens_count * sizeof(CacheToken));
+  header.image_size = align8(header.pool_offset + cache->pool_size);
+
+  unsigned char *image = safe_calloc(1, header.image_size);
+  uint64_t *lines = (uint64_t *)(image + header.lines_offset);
+  size_t line = 0;
+  lines[line++] = 0;
+  for (const char *p = cache->source, *end = cache->source + cache->source_size; p < end;) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    p = nl ? nl + 1 : end;
+    lines[line++] = (uint64_t)(p - cache->source);
+  }
+  if (cache->statements_count)
+    memcpy(image + header.statements_offset, cache->statements, cache->statements_count * sizeof(CacheStatement));
+  if (cache->tokens_count)
+    memcpy(image + header.tokens_offset, cache->tokens, cache->tokens_count * sizeof(CacheToken));
+  memcpy(image + header.pool_offset, cache->pool, cache->pool_size);
+  header.payload_hash = hash_bytes(image + sizeof(CacheHeader), header.image_size - sizeof(CacheHeader));
+  memcpy(image, &header, sizeof(header));
+
+  // Write to a temporary file first so readers never see a partial image.
+  char dir[1024];
+  snprintf(dir, sizeof(dir), "%s", cache->path);
+  char *slash = strrchr(dir, '/');
+  if (slash)
+    *slash = '\0';
+  size_t tmp_size = strlen(cache->path) + 32;
+  char *tmp_path = safe_malloc(tmp_size);
+  snprintf(tmp_path, tmp_size, "%s.%ld.tmp", cache->path, (long)getpid());
+
+  if (make_directories(dir)) {
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp) {
+      bool written = fwrite(image, 1, header.image_size, fp) == header.image_size;
+      if (fclose(fp) == 0 && written)
+        rename(tmp_path, cache->path);
+      else
+        unlink(tmp_path);
+    }
+  }
+  free(tmp_path);
+  free(image);
+#endif
+}
+
+// Releases a cache builder and the copy of the source.
+void cache_free(CacheBuilder *cache) {
+  debug_func("");
+  if (!cache)
+    return;
+  free(cache->source);
+  free(cache->path);
+  free(cache->tokens);
+  free(cache->statements);
+  free(cache->pool);
+  free(cache);
+}
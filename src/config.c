@@ -16,15 +16,20 @@ const char *COLOR_PURPLE = "\033[35m";
 const char *COLOR_BOLD = "\033[1m";
 const char *COLOR_RESET = "\033[0m";
 
+// Disable colors unconditionally.
+void disable_colors(void) {
+  debug_func("");
+  COLOR_RED = "";
+  COLOR_CYAN = "";
+  COLOR_PURPLE = "";
+  COLOR_GREEN = "";
+  COLOR_BOLD = "";
+  COLOR_RESET = "";
+}
+
 // Disable colors if stderr is not a TTY (terminal).
 void disable_colors_if_not_tty(void) {
   debug_func("");
-  if (!isatty(fileno(stderr))) {
-    COLOR_RED = "";
-    COLOR_CYAN = "";
-    COLOR_PURPLE = "";
-    COLOR_GREEN = "";
-    COLOR_BOLD = "";
-    COLOR_RESET = "";
-  }
+  if (!isatty(fileno(stderr)))
+    disable_colors();
 }
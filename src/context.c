@@ -1,60 +1,208 @@
 // context.c
-// This file defines and initializes the global NoonContext struct.
-// This struct acts as a central container for the entire state of the
-// interpreter, including lexer state, token lists, AST, and logs.
+// This file creates, initializes and destroys NoonContext structs.
+// A context acts as a central container for the entire state of one
+// interpreter instance, including lexer state, token lists, AST, and logs.
+// The current instance is selected per thread through `ctx`, so independent
+// instances can run concurrently on separate threads.
 
 #include "context.h"
+#include "cache.h"
 #include "lexer/lexer.h"
 #include "parser/ast.h"
 #include "utils/log.h"
 #include "utils/memory.h"
+#include <string.h>
 
-// Global pointer to the context.
-NoonContext *ctx = NULL;
+// Pointer to the context used by the current thread.
+_Thread_local NoonContext *ctx = NULL;
 
-// Allocates and initializes the global context struct with default values.
-void init_context(void) {
+// Allocates a new context with default values and its initial buffers.
+NoonContext *create_context(void) {
   debug_func("");
-  ctx = safe_malloc(sizeof(NoonContext));
+  NoonContext *context = safe_malloc(sizeof(NoonContext));
   /* Lexer */
   // Read lines
-  ctx->bytes_read = 0;
-  ctx->current_line = NULL;
-  ctx->line_length = 0;
-  ctx->line_index = 0;
-  ctx->line_number = 0;
-  ctx->lines = NULL;
-  ctx->lines_capacity = 0;
+  context->bytes_read = 0;
+  context->current_line = NULL;
+  context->line_length = 0;
+  context->line_index = 0;
+  context->line_number = 0;
+  context->lines = safe_calloc(INITIAL_CAPACITY, sizeof(char *));
+  context->lines_capacity = INITIAL_CAPACITY;
+  context->first_line = 0;
   // Lexer state
-  ctx->state = STATE_NORMAL;
+  context->state = STATE_NORMAL;
   // Quotes
-  ctx->quote_char = 0;
-  ctx->quote_line = 0;
-  ctx->quote_index = 0;
+  context->quote_char = 0;
+  context->quote_line = 0;
+  context->quote_index = 0;
   // Comments
-  ctx->multi_comment_line = 0;
-  ctx->multi_comment_index = 0;
+  context->multi_comment_line = 0;
+  context->multi_comment_index = 0;
   // Brackets
-  ctx->bracket_stack = NULL;
-  ctx->bracket_stack_size = 0;
-  ctx->bracket_stack_capacity = 0;
+  context->bracket_stack = safe_calloc(INITIAL_CAPACITY, sizeof(BracketStackItem));
+  context->bracket_stack_size = 0;
+  context->bracket_stack_capacity = INITIAL_CAPACITY;
 
   /* Tokens */
-  ctx->tokens = NULL;
-  ctx->tokens_capacity = 0;
-  ctx->tokens_count = 0;
-  ctx->tokens_position = 0;
-  ctx->string_token = NULL;
-  ctx->string_token_length = 0;
-  ctx->string_token_capacity = 0;
+  context->tokens = safe_calloc(INITIAL_CAPACITY, sizeof(Token));
+  context->tokens_capacity = INITIAL_CAPACITY;
+  context->tokens_count = 0;
+  context->tokens_position = 0;
+  context->token_values = (Region){NULL, NULL};
+  context->interns = (InternTable){0};
+  context->string_token = NULL;
+  context->string_token_length = 0;
+  context->string_token_capacity = 0;
   /* Ast */
-  ctx->ast_root = NULL;
-  ctx->has_syntax_error = false;
+  context->ast_root = NULL;
+  context->has_syntax_error = false;
+  /* Evaluation */
+  context->result = make_null();
   /* Logs */
-  ctx->logs = NULL;
-  ctx->logs_count = 0;
-  ctx->logs_capacity = 0;
-  ctx->total_errors = 0;
-  ctx->total_warnings = 0;
-  ctx->total_infos = 0;
+  context->logs = safe_calloc(INITIAL_CAPACITY, sizeof(LogEntry));
+  context->logs_count = 0;
+  context->logs_capacity = INITIAL_CAPACITY;
+  context->total_errors = 0;
+  context->total_warnings = 0;
+  context->total_infos = 0;
+  context->log_buffer = NULL;
+  context->log_buffer_size = 0;
+  context->log_buffer_capacity = 0;
+  context->logs_emitted = 0;
+  context->logs_heap = false;
+  context->logs_dropped = 0;
+  context->error_limit_reached = false;
+  context->duplicates = NULL;
+  context->duplicates_count = 0;
+  context->display_columns = NULL;
+  context->display_length = 0;
+  context->display_capacity = 0;
+  context->display_line = 0;
+  context->display_ascii = false;
+  /* Cache */
+  context->cache = NULL;
+  /* Statistics */
+  context->stats = (Stats){0};
+  return context;
+}
+
+// Forgets the messages counted for deduplication.
+void clear_duplicates(NoonContext *context) {
+  if (!context->duplicates)
+    return;
+  for (size_t i = 0; i < LOG_DEDUP_SLOTS; i++)
+    free(context->duplicates[i].message);
+  memset(context->duplicates, 0, LOG_DEDUP_SLOTS * sizeof(LogDuplicate));
+  context->duplicates_count = 0;
+}
+
+// Clears the per-run state of a context while keeping its buffers, so the
+// same instance can process another input without reallocating them.
+void reset_context(NoonContext *context) {
+  debug_func("");
+  for (size_t i = 0; i < context->lines_capacity; i++) {
+    free(context->lines[i]);
+    context->lines[i] = NULL;
+  }
+  context->line_number = 0;
+  context->first_line = 0;
+  context->line_index = 0;
+  context->bytes_read = 0;
+  context->state = STATE_NORMAL;
+  context->quote_char = 0;
+  context->quote_line = 0;
+  context->quote_index = 0;
+  context->multi_comment_line = 0;
+  context->multi_comment_index = 0;
+  context->bracket_stack_size = 0;
+
+  region_reset(&context->token_values);
+  context->tokens_count = 0;
+  context->tokens_position = 0;
+  context->string_token_length = 0;
+
+  if (context->ast_root) {
+    free_node(context->ast_root);
+    context->ast_root = NULL;
+  }
+  context->has_syntax_error = false;
+  free_value(&context->result);
+
+  for (size_t i = 0; i < context->logs_count; ++i) {
+    free(context->logs[i].log_msg);
+    free(context->logs[i].log_symbol);
+  }
+  context->logs_count = 0;
+  context->total_errors = 0;
+  context->total_warnings = 0;
+  context->total_infos = 0;
+  context->logs_emitted = 0;
+  context->logs_heap = false;
+  context->logs_dropped = 0;
+  context->error_limit_reached = false;
+  clear_duplicates(context);
+  context->display_line = 0; // line numbers start over
+
+  cache_free(context->cache);
+  context->cache = NULL;
+  context->stats = (Stats){0};
+}
+
+// Frees a context and everything it owns.
+void destroy_context(NoonContext *context) {
+  debug_func("");
+  if (!context)
+    return;
+
+  // Free all stored lines of source code, and the buffers kept for reuse.
+  if (context->lines) {
+    for (size_t i = 0; i < context->lines_capacity; i++)
+      free(context->lines[i]);
+    free((void *)context->lines);
+  }
+
+  // Free the Abstract Syntax Tree and the last result.
+  if (context->ast_root)
+    free_node(context->ast_root);
+  free_value(&context->result);
+
+  // Free the bracket matching stack.
+  free(context->bracket_stack);
+
+  // Free all tokens and their values.
+  free(context->tokens);
+  region_free(&context->token_values);
+  intern_free(&context->interns);
+
+  // Free the temporary string token buffer.
+  free(context->string_token);
+
+  // Free the diagnostic output buffer, the deduplication table and all
+  // saved log entries.
+  free(context->log_buffer);
+  clear_duplicates(context);
+  free(context->duplicates);
+  free(context->display_columns);
+  if (context->logs) {
+    for (size_t i = 0; i < context->logs_count; ++i) {
+      free(context->logs[i].log_msg);
+      free(context->logs[i].log_symbol);
+    }
+    free(context->logs);
+  }
+
+  // Free the compiled cache state.
+  cache_free(context->cache);
+
+  // Free the buffer for the current line being processed.
+  free(context->current_line);
+
+  free(context);
+}
+
+// Creates the context of the current thread.
+void init_context(void) {
+  debug_func("");
+  ctx = create_context();
 }
@@ -0,0 +1,417 @@
+// eval/bigint.c
+// This file implements arbitrary-precision integers. Magnitudes are arrays
+// of 32-bit limbs, so every partial product fits in 64 bits. Multiplication
+// is schoolbook for short operands and Karatsuba once both have at least
+// KARATSUBA_THRESHOLD limbs. Division is binary long division, which is
+// enough for the occasional `//` or `%` on a promoted integer.
+
+#include "eval/bigint.h"
+#include "config.h"
+#include "utils/memory.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Allocates a BigInt with room for `length` limbs, all zero.
+static BigInt *alloc_bigint(size_t length) {
+  BigInt *value = safe_calloc(1, sizeof(BigInt) + length * sizeof(uint32_t));
+  value->length = length;
+  return value;
+}
+
+// Drops leading zero limbs. Zero is never negative.
+static BigInt *trim(BigInt *value) {
+  while (value->length && !value->limbs[value->length - 1])
+    value->length--;
+  if (!value->length)
+    value->negative = false;
+  return value;
+}
+
+// Compares two magnitudes, ignoring leading zero limbs.
+static int mag_compare(const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+  while (an && !a[an - 1])
+    an--;
+  while (bn && !b[bn - 1])
+    bn--;
+  if (an != bn)
+    return an < bn ? -1 : 1;
+  for (size_t i = an; i-- > 0;)
+    if (a[i] != b[i])
+      return a[i] < b[i] ? -1 : 1;
+  return 0;
+}
+
+// Stores a + b in `out`, which has room for one limb more than the longer
+// operand.
+static void mag_add(const uint32_t *a, size_t an, const uint32_t *b, size_t bn, uint32_t *out) {
+  if (an < bn) {
+    const uint32_t *t = a;
+    a = b;
+    b = t;
+    size_t tn = an;
+    an = bn;
+    bn = tn;
+  }
+  uint64_t carry = 0;
+  for (size_t i = 0; i < an; i++) {
+    uint64_t sum = (uint64_t)a[i] + (i < bn ? b[i] : 0) + carry;
+    out[i] = (uint32_t)sum;
+    carry = sum >> 32;
+  }
+  out[an] = (uint32_t)carry;
+}
+
+// Stores a - b in `out[0..an)`. `a` must be at least `b`; `out` may be `a`.
+static void mag_sub(const uint32_t *a, size_t an, const uint32_t *b, size_t bn, uint32_t *out) {
+  uint64_t borrow = 0;
+  for (size_t i = 0; i < an; i++) {
+    uint64_t difference = (uint64_t)a[i] - (i < bn ? b[i] : 0) - borrow;
+    out[i] = (uint32_t)difference;
+    borrow = difference >> 63;
+  }
+}
+
+// Adds `x` into `out[0..n)`, carrying as far as needed.
+static void add_into(uint32_t *out, size_t n, const uint32_t *x, size_t xn) {
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < xn; i++) {
+    uint64_t sum = (uint64_t)out[i] + x[i] + carry;
+    out[i] = (uint32_t)sum;
+    carry = sum >> 32;
+  }
+  for (; carry && i < n; i++) {
+    uint64_t sum = (uint64_t)out[i] + carry;
+    out[i] = (uint32_t)sum;
+    carry = sum >> 32;
+  }
+}
+
+// Subtracts `x` from `out[0..n)`, which must be at least `x`.
+static void sub_from(uint32_t *out, size_t n, const uint32_t *x, size_t xn) {
+  uint64_t borrow = 0;
+  size_t i = 0;
+  for (; i < xn; i++) {
+    uint64_t difference = (uint64_t)out[i] - x[i] - borrow;
+    out[i] = (uint32_t)difference;
+    borrow = difference >> 63;
+  }
+  for (; borrow && i < n; i++) {
+    uint64_t difference = (uint64_t)out[i] - borrow;
+    out[i] = (uint32_t)difference;
+    borrow = difference >> 63;
+  }
+}
+
+// Returns the length of a magnitude without its leading zero limbs.
+static size_t significant(const uint32_t *a, size_t n) {
+  while (n && !a[n - 1])
+    n--;
+  return n;
+}
+
+// Stores a * b in `out`, which has an + bn zeroed limbs.
+static void mag_mul(const uint32_t *a, size_t an, const uint32_t *b, size_t bn, uint32_t *out) {
+  if (an < bn) {
+    const uint32_t *t = a;
+    a = b;
+    b = t;
+    size_t tn = an;
+    an = bn;
+    bn = tn;
+  }
+  if (bn < KARATSUBA_THRESHOLD) {
+    for (size_t j = 0; j < bn; j++) {
+      uint64_t carry = 0;
+      for (size_t i = 0; i < an; i++) {
+        uint64_t product = (uint64_t)a[i] * b[j] + out[i + j] + carry;
+        out[i + j] = (uint32_t)product;
+        carry = product >> 32;
+      }
+      out[j + an] = (uint32_t)carry;
+    }
+    return;
+  }
+
+  // A much longer `a` is multiplied one `bn`-limb slice at a time, so
+  // every Karatsuba step splits operands of similar length.
+  if (2 * bn <= an) {
+    uint32_t *part = safe_malloc(2 * bn * sizeof(uint32_t));
+    for (size_t i = 0; i < an; i += bn) {
+      size_t length = an - i < bn ? an - i : bn;
+      memset(part, 0, (length + bn) * sizeof(uint32_t));
+      mag_mul(a + i, length, b, bn, part);
+      add_into(out + i, an + bn - i, part, length + bn);
+    }
+    free(part);
+    return;
+  }
+
+  // Karatsuba: with a = a1 B^m + a0 and b = b1 B^m + b0, the middle term
+  // a0 b1 + a1 b0 is (a0 + a1)(b0 + b1) - a0 b0 - a1 b1, three products
+  // instead of four.
+  size_t m = an / 2;
+  size_t a1n = an - m, b1n = bn - m;
+  size_t sa_n = a1n + 1, sb_n = (m > b1n ? m : b1n) + 1;
+  size_t z1_n = sa_n + sb_n;
+  uint32_t *buffer = safe_calloc(sa_n + sb_n + z1_n + 2 * m + a1n + b1n, sizeof(uint32_t));
+  uint32_t *sa = buffer, *sb = sa + sa_n, *z1 = sb + sb_n, *z0 = z1 + z1_n, *z2 = z0 + 2 * m;
+  mag_add(a, m, a + m, a1n, sa);
+  mag_add(b, m, b + m, b1n, sb);
+  mag_mul(a, m, b, m, z0);
+  mag_mul(a + m, a1n, b + m, b1n, z2);
+  mag_mul(sa, sa_n, sb, sb_n, z1);
+  sub_from(z1, z1_n, z0, 2 * m);
+  sub_from(z1, z1_n, z2, a1n + b1n);
+  add_into(out, an + bn, z0, significant(z0, 2 * m));
+  add_into(out + m, an + bn - m, z1, significant(z1, z1_n));
+  add_into(out + 2 * m, an + bn - 2 * m, z2, significant(z2, a1n + b1n));
+  free(buffer);
+}
+
+/* create a big integer from a 64-bit one */
+BigInt *bigint_from_int64(int64_t value) {
+  uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+  BigInt *result = alloc_bigint(2);
+  result->limbs[0] = (uint32_t)magnitude;
+  result->limbs[1] = (uint32_t)(magnitude >> 32);
+  result->negative = value < 0;
+  return trim(result);
+}
+
+/* create a big integer from decimal digits */
+BigInt *bigint_from_decimal(const char *digits, size_t length) {
+  // Every 9 digits add less than 30 bits.
+  BigInt *result = alloc_bigint(length / 9 + 2);
+  size_t used = 0;
+  for (size_t i = 0; i < length;) {
+    uint32_t chunk = 0, scale = 1;
+    for (size_t k = 0; k < 9 && i < length; k++, i++) {
+      chunk = chunk * 10 + (uint32_t)(digits[i] - '0');
+      scale *= 10;
+    }
+    uint64_t carry = chunk;
+    for (size_t j = 0; j < used; j++) {
+      uint64_t product = (uint64_t)result->limbs[j] * scale + carry;
+      result->limbs[j] = (uint32_t)product;
+      carry = product >> 32;
+    }
+    if (carry)
+      result->limbs[used++] = (uint32_t)carry;
+  }
+  result->length = used;
+  return trim(result);
+}
+
+/* create a big integer from an integral, finite double */
+BigInt *bigint_from_double(double value) {
+  double magnitude = fabs(value);
+  int exponent;
+  frexp(magnitude, &exponent);
+  size_t length = exponent > 0 ? (size_t)exponent / 32 + 1 : 0;
+  BigInt *result = alloc_bigint(length);
+  for (size_t i = 0; i < length; i++) {
+    result->limbs[i] = (uint32_t)fmod(magnitude, 4294967296.0);
+    magnitude = floor(magnitude / 4294967296.0);
+  }
+  result->negative = value < 0;
+  return trim(result);
+}
+
+/* copy a big integer */
+BigInt *bigint_copy(const BigInt *value) {
+  BigInt *copy = alloc_bigint(value->length);
+  memcpy(copy->limbs, value->limbs, value->length * sizeof(uint32_t));
+  copy->negative = value->negative;
+  return copy;
+}
+
+// Adds `left` and `right` with the sign of `right` replaced by
+// `right_negative`, which makes subtraction an addition.
+static BigInt *add_signed(const BigInt *left, const BigInt *right, bool right_negative) {
+  BigInt *result;
+  if (left->negative == right_negative) {
+    result = alloc_bigint((left->length > right->length ? left->length : right->length) + 1);
+    mag_add(left->limbs, left->length, right->limbs, right->length, result->limbs);
+    result->negative = left->negative;
+  } else if (mag_compare(left->limbs, left->length, right->limbs, right->length) >= 0) {
+    result = alloc_bigint(left->length);
+    mag_sub(left->limbs, left->length, right->limbs, right->length, result->limbs);
+    result->negative = left->negative;
+  } else {
+    result = alloc_bigint(right->length);
+    mag_sub(right->limbs, right->length, left->limbs, left->length, result->limbs);
+    result->negative = right_negative;
+  }
+  return trim(result);
+}
+
+BigInt *bigint_add(const BigInt *left, const BigInt *right) { return add_signed(left, right, right->negative); }
+
+BigInt *bigint_sub(const BigInt *left, const BigInt *right) { return add_signed(left, right, !right->negative); }
+
+/* multiply two big integers */
+BigInt *bigint_mul(const BigInt *left, const BigInt *right) {
+  if (!left->length || !right->length)
+    return alloc_bigint(0);
+  BigInt *result = alloc_bigint(left->length + right->length);
+  mag_mul(left->limbs, left->length, right->limbs, right->length, result->limbs);
+  result->negative = left->negative != right->negative;
+  return trim(result);
+}
+
+/* negate a big integer */
+BigInt *bigint_negate(const BigInt *value) {
+  BigInt *result = bigint_copy(value);
+  result->negative = value->length && !value->negative;
+  return result;
+}
+
+/* divide two big integers, rounding the quotient down */
+BigInt *bigint_divmod(const BigInt *left, const BigInt *right, BigInt **remainder) {
+  BigInt *quotient = alloc_bigint(left->length + 1);
+  BigInt *rest = alloc_bigint(right->length + 1);
+  size_t rest_length = 0;
+  // Bring down one bit of the dividend at a time.
+  for (size_t bit = left->length * 32; bit-- > 0;) {
+    uint32_t carry = (left->limbs[bit / 32] >> (bit % 32)) & 1;
+    for (size_t i = 0; i < rest_length; i++) {
+      uint32_t next = rest->limbs[i] >> 31;
+      rest->limbs[i] = (rest->limbs[i] << 1) | carry;
+      carry = next;
+    }
+    if (carry)
+      rest->limbs[rest_length++] = carry;
+    if (mag_compare(rest->limbs, rest_length, right->limbs, right->length) >= 0) {
+      mag_sub(rest->limbs, rest_length, right->limbs, right->length, rest->limbs);
+      rest_length = significant(rest->limbs, rest_length);
+      quotient->limbs[bit / 32] |= 1u << (bit % 32);
+    }
+  }
+  rest->length = rest_length;
+
+  // Truncation rounds toward zero; move a negative inexact quotient down
+  // and give the remainder the divisor's sign.
+  quotient->negative = left->negative != right->negative;
+  if (quotient->negative && rest_length) {
+    uint32_t one = 1;
+    add_into(quotient->limbs, quotient->length, &one, 1);
+    mag_sub(right->limbs, right->length, rest->limbs, rest_length, rest->limbs);
+    rest->length = right->length;
+  }
+  rest->negative = right->negative;
+  if (remainder)
+    *remainder = trim(rest);
+  else
+    free(rest);
+  return trim(quotient);
+}
+
+/* shift a big integer left */
+BigInt *bigint_shift_left(const BigInt *value, uint64_t bits) {
+  size_t limbs = (size_t)(bits / 32);
+  unsigned shift = (unsigned)(bits % 32);
+  BigInt *result = alloc_bigint(value->length + limbs + 1);
+  for (size_t i = 0; i < value->length; i++) {
+    uint64_t shifted = (uint64_t)value->limbs[i] << shift;
+    result->limbs[i + limbs] |= (uint32_t)shifted;
+    result->limbs[i + limbs + 1] |= (uint32_t)(shifted >> 32);
+  }
+  result->negative = value->negative;
+  return trim(result);
+}
+
+/* shift a big integer right, rounding down */
+BigInt *bigint_shift_right(const BigInt *value, uint64_t bits) {
+  size_t limbs = (size_t)(bits / 32);
+  unsigned shift = (unsigned)(bits % 32);
+  if (bits / 32 >= value->length) {
+    // Everything is shifted out: 0, or -1 for a negative number.
+    BigInt *result = bigint_from_int64(value->negative ? -1 : 0);
+    return result;
+  }
+  size_t length = value->length - limbs;
+  BigInt *result = alloc_bigint(length + 1);
+  bool lost = shift && (value->limbs[limbs] & ((1u << shift) - 1));
+  for (size_t i = 0; i < limbs && !lost; i++)
+    lost = value->limbs[i] != 0;
+  for (size_t i = 0; i < length; i++) {
+    uint32_t high = shift && i + 1 < length ? value->limbs[i + limbs + 1] << (32 - shift) : 0;
+    result->limbs[i] = (value->limbs[i + limbs] >> shift) | high;
+  }
+  result->negative = value->negative;
+  if (value->negative && lost) {
+    uint32_t one = 1;
+    add_into(result->limbs, length + 1, &one, 1);
+  }
+  return trim(result);
+}
+
+/* compare two big integers */
+int bigint_compare(const BigInt *left, const BigInt *right) {
+  if (left->negative != right->negative)
+    return left->negative ? -1 : 1;
+  int magnitude = mag_compare(left->limbs, left->length, right->limbs, right->length);
+  return left->negative ? -magnitude : magnitude;
+}
+
+/* convert a big integer to 64 bits if it fits */
+bool bigint_to_int64(const BigInt *value, int64_t *out) {
+  if (value->length > 2)
+    return false;
+  uint64_t magnitude = value->length ? value->limbs[0] : 0;
+  if (value->length == 2)
+    magnitude |= (uint64_t)value->limbs[1] << 32;
+  if (value->negative) {
+    if (magnitude > (uint64_t)INT64_MAX + 1)
+      return false;
+    *out = magnitude == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)magnitude;
+    return true;
+  }
+  if (magnitude > (uint64_t)INT64_MAX)
+    return false;
+  *out = (int64_t)magnitude;
+  return true;
+}
+
+/* convert a big integer to the nearest double */
+double bigint_to_double(const BigInt *value) {
+  double result = 0;
+  for (size_t i = value->length; i-- > 0;)
+    result = result * 4294967296.0 + value->limbs[i];
+  return value->negative ? -result : result;
+}
+
+/* format a big integer in decimal */
+char *bigint_to_string(const BigInt *value) {
+  if (!value->length)
+    return safe_strdup("0");
+  // Peel off 9 decimal digits at a time.
+  size_t length = value->length;
+  uint32_t *magnitude = safe_malloc(length * sizeof(uint32_t));
+  memcpy(magnitude, value->limbs, length * sizeof(uint32_t));
+  uint32_t *chunks = safe_malloc((length * 32 / 29 + 2) * sizeof(uint32_t));
+  size_t count = 0;
+  while (length) {
+    uint64_t rest = 0;
+    for (size_t i = length; i-- > 0;) {
+      uint64_t current = (rest << 32) | magnitude[i];
+      magnitude[i] = (uint32_t)(current / 1000000000);
+      rest = current % 1000000000;
+    }
+    chunks[count++] = (uint32_t)rest;
+    length = significant(magnitude, length);
+  }
+
+  char *text = safe_malloc(count * 9 + 2);
+  char *p = text;
+  if (value->negative)
+    *p++ = '-';
+  p += sprintf(p, "%u", chunks[count - 1]);
+  for (size_t i = count - 1; i-- > 0;)
+    p += sprintf(p, "%09u", chunks[i]);
+  free(magnitude);
+  free(chunks);
+  return text;
+}
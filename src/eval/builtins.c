@@ -0,0 +1,156 @@
+// eval/builtins.c
+// This file implements the builtin functions. They work on ranges without
+// expanding them: the length, sum and membership of a range have closed
+// forms, so `sum(0 ... 1e9)` takes constant time and memory. Lists are
+// walked in place.
+
+#include "eval/builtins.h"
+#include "config.h"
+#include "eval/dict.h"
+#include "eval/eval.h"
+#include <math.h>
+#include <string.h>
+
+// Name and number of arguments of each builtin.
+typedef struct {
+  const char *name;
+  size_t arity;
+} BuiltinInfo;
+
+static const BuiltinInfo BUILTINS[] = {
+    [BUILTIN_LEN] = {"len", 1},
+    [BUILTIN_SUM] = {"sum", 1},
+    [BUILTIN_CONTAINS] = {"contains", 2},
+};
+
+/* look up a builtin by name */
+bool find_builtin(const char *name, Builtin *builtin) {
+  for (size_t i = 0; i < sizeof(BUILTINS) / sizeof(BUILTINS[0]); i++) {
+    if (strcmp(BUILTINS[i].name, name) == 0) {
+      *builtin = (Builtin)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *builtin_name(Builtin builtin) { return BUILTINS[builtin].name; }
+
+size_t builtin_arity(Builtin builtin) { return BUILTINS[builtin].arity; }
+
+// Reports an argument that a builtin doesn't support.
+static bool unsupported(Builtin builtin, Token name, Value arg) {
+  runtime_error(name, ERR_ARGUMENT_TYPE, builtin_name(builtin), value_type_to_string(arg.value_type), NULL);
+  return false;
+}
+
+// Returns the number of items in a string, list, range or dictionary.
+static bool builtin_len(Token name, Value arg, Value *result) {
+  switch (arg.value_type) {
+  case VALUE_STRING: *result = make_integer((int64_t)arg.string_length); return true;
+  case VALUE_LIST: *result = make_integer((int64_t)arg.list_length); return true;
+  case VALUE_RANGE: *result = make_integer((int64_t)arg.range_length); return true;
+  case VALUE_DICT: *result = make_integer((int64_t)arg.dict_value->count); return true;
+  default: return unsupported(BUILTIN_LEN, name, arg);
+  }
+}
+
+// Adds up the numbers of a list or range.
+static bool builtin_sum(Token name, Value arg, Value *result) {
+  if (arg.value_type == VALUE_RANGE) {
+    // An arithmetic series: the count times the mean of its ends.
+    size_t length = arg.range_length;
+    double sum = length ? (double)length * (arg.range_start + range_item(arg, length - 1)) / 2 : 0;
+    *result = make_number(sum);
+    return true;
+  }
+  if (arg.value_type == VALUE_LIST && arg.list_type == VALUE_NUMBER) {
+    const double *items = arg.list_items;
+    double sum = 0;
+    for (size_t i = 0; i < arg.list_length; i++)
+      sum += items[i];
+    *result = make_number(sum);
+    return true;
+  }
+  return unsupported(BUILTIN_SUM, name, arg);
+}
+
+// Checks whether a number is in a range by finding the index it would have.
+static bool range_contains(Value range, double number) {
+  if (range.range_length == 0 || !isfinite(number))
+    return false;
+  if (range.range_step == 0)
+    return number == range.range_start;
+  double index = nearbyint((number - range.range_start) / range.range_step);
+  if (index < 0 || index >= (double)range.range_length)
+    return false;
+  return range_item(range, (size_t)index) == number;
+}
+
+// Converts a number item to the double it equals. Returns false for a value
+// no double equals, which no list or range can hold.
+static bool item_number(Value item, double *number) {
+  if (!is_numeric(item))
+    return false;
+  *number = number_to_double(item);
+  return item.value_type == VALUE_NUMBER || values_equal(make_number(*number), item);
+}
+
+// Checks whether `needle` occurs in `length` bytes of `haystack`.
+static bool contains_bytes(const char *haystack, size_t length, const char *needle, size_t needle_length) {
+  if (needle_length == 0)
+    return true;
+  for (const char *p = haystack; needle_length <= length - (size_t)(p - haystack);) {
+    p = memchr(p, needle[0], length - needle_length + 1 - (size_t)(p - haystack));
+    if (!p)
+      return false;
+    if (memcmp(p, needle, needle_length) == 0)
+      return true;
+    p++;
+  }
+  return false;
+}
+
+// Checks whether a list or range holds an item, a dictionary holds a key or
+// a string holds a substring.
+static bool builtin_contains(Token name, const Value *args, Value *result) {
+  Value container = args[0], item = args[1];
+  bool found = false;
+  double number;
+  switch (container.value_type) {
+  case VALUE_RANGE: found = item_number(item, &number) && range_contains(container, number); break;
+  case VALUE_LIST:
+    if (container.list_type == VALUE_BOOLEAN && item.value_type == VALUE_BOOLEAN) {
+      const bool *items = container.list_items;
+      for (size_t i = 0; i < container.list_length && !found; i++)
+        found = items[i] == item.boolean_value;
+    } else if (container.list_type == VALUE_NUMBER && item_number(item, &number)) {
+      const double *items = container.list_items;
+      for (size_t i = 0; i < container.list_length && !found; i++)
+        found = items[i] == number;
+    }
+    break;
+  case VALUE_DICT:
+    if (is_numeric(item) || item.value_type == VALUE_STRING || item.value_type == VALUE_BOOLEAN)
+      found = dict_find(container.dict_value, item, 0) != NULL;
+    break;
+  case VALUE_STRING:
+    if (item.value_type != VALUE_STRING)
+      return unsupported(BUILTIN_CONTAINS, name, item);
+    found = contains_bytes(container.string_value, container.string_length, item.string_value, item.string_length);
+    break;
+  default: return unsupported(BUILTIN_CONTAINS, name, container);
+  }
+  *result = make_boolean(found);
+  return true;
+}
+
+/* apply a builtin to evaluated arguments */
+bool call_builtin(Builtin builtin, Token name, const Value *args, Value *result) {
+  switch (builtin) {
+  case BUILTIN_LEN: return builtin_len(name, args[0], result);
+  case BUILTIN_SUM: return builtin_sum(name, args[0], result);
+  case BUILTIN_CONTAINS:
+  default: return builtin_contains(name, args, result);
+  }
+}
@@ -0,0 +1,259 @@
+// eval/dict.c
+// This file implements dictionaries as an open-addressing hash table in the
+// style of SwissTable. Each slot has a control byte holding 7 bits of its
+// key's hash, and a lookup compares 16 control bytes at once (with SSE2
+// where the compiler has it), so most probes never touch a key. Keys that
+// come from the same literal are matched by intern id without comparing
+// their bytes.
+
+#include "eval/dict.h"
+#include "eval/bigint.h"
+#include "utils/memory.h"
+#include "utils/strings.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define HAVE_SSE2_GROUPS 1
+#include <emmintrin.h>
+#endif
+
+// Control byte of an empty slot. Full slots have the top bit clear.
+#define CONTROL_EMPTY 0x80
+
+// Returns the bits of a group of 16 control bytes, starting at `control`,
+// that are equal to `byte`.
+static uint32_t match_group(const uint8_t *control, uint8_t byte) {
+#ifdef HAVE_SSE2_GROUPS
+  __m128i group = _mm_loadu_si128((const __m128i *)control);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < DICT_GROUP; i++)
+    mask |= (uint32_t)(control[i] == byte) << i;
+  return mask;
+#endif
+}
+
+// Returns the index of the lowest set bit of a non-zero mask.
+static unsigned lowest_bit(uint32_t mask) {
+#ifdef __GNUC__
+  return (unsigned)__builtin_ctz(mask);
+#else
+  unsigned bit = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+// Mixes the bits of a 64-bit key.
+static uint64_t mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  return x ^ (x >> 33);
+}
+
+// Hashes a double key. Whole numbers in the 64-bit range hash like the
+// equal integer, and 0 and -0 hash the same.
+static uint64_t hash_double(double number) {
+  if (number == floor(number) && number >= -9223372036854775808.0 && number < 9223372036854775808.0)
+    return mix((uint64_t)(int64_t)number);
+  uint64_t bits;
+  memcpy(&bits, &number, sizeof(bits));
+  return mix(bits);
+}
+
+/* hash a number, string or boolean key */
+uint64_t hash_value(Value key) {
+  switch (key.value_type) {
+  case VALUE_STRING: return mix(string_hash(&key));
+  case VALUE_NUMBER: return hash_double(key.number_value);
+  case VALUE_INTEGER: return mix((uint64_t)key.integer_value);
+  // A big integer hashes like the nearest double, which is the double
+  // equal to it if there is one.
+  case VALUE_BIGINT: return hash_double(bigint_to_double(key.bigint_value));
+  case VALUE_BOOLEAN: return mix(key.boolean_value ? 2 : 1);
+  default: return mix(0);
+  }
+}
+
+// Checks whether a key matches an entry. Keys written as the same literal
+// share an intern id, so they match without comparing their contents.
+static bool key_matches(const DictEntry *entry, Value key, uint64_t hash, uint32_t key_intern) {
+  if (entry->hash != hash)
+    return false;
+  if (key_intern && entry->key_intern == key_intern)
+    return true;
+  if (key.value_type == VALUE_STRING && entry->key.value_type == VALUE_STRING)
+    return strings_equal(key, entry->key);
+  return values_equal(entry->key, key);
+}
+
+// Marks slot `slot` as full with the 7 hash bits `tag`, keeping the copy of
+// the first group in step.
+static void set_control(Dict *dict, size_t slot, uint8_t tag) {
+  dict->control[slot] = tag;
+  if (slot < DICT_GROUP)
+    dict->control[dict->capacity + slot] = tag;
+}
+
+// Finds the slot of a key. Returns true with its slot if the key is
+// present, or false with the empty slot where it belongs.
+static bool find_slot(const Dict *dict, Value key, uint64_t hash, uint32_t key_intern, size_t *slot) {
+  size_t mask = dict->capacity - 1;
+  uint8_t tag = (uint8_t)(hash & 0x7f);
+  size_t position = (size_t)(hash >> 7) & mask;
+  // Step by one more group each time; over a power-of-two table this
+  // visits every group.
+  for (size_t stride = DICT_GROUP;; stride += DICT_GROUP) {
+    const uint8_t *group = dict->control + position;
+    for (uint32_t match = match_group(group, tag); match; match &= match - 1) {
+      size_t candidate = (position + lowest_bit(match)) & mask;
+      if (key_matches(&dict->entries[dict->slots[candidate]], key, hash, key_intern)) {
+        *slot = candidate;
+        return true;
+      }
+    }
+    uint32_t empty = match_group(group, CONTROL_EMPTY);
+    if (empty) {
+      *slot = (position + lowest_bit(empty)) & mask;
+      return false;
+    }
+    position = (position + stride) & mask;
+  }
+}
+
+// Returns the table size that holds `count` entries at most 7/8 full.
+static size_t capacity_for(size_t count) {
+  size_t capacity = DICT_GROUP;
+  while (capacity / 8 * 7 < count)
+    capacity *= 2;
+  return capacity;
+}
+
+// Allocates an empty table of `capacity` slots.
+static void alloc_table(Dict *dict, size_t capacity) {
+  dict->capacity = capacity;
+  dict->control = safe_malloc(capacity + DICT_GROUP);
+  memset(dict->control, CONTROL_EMPTY, capacity + DICT_GROUP);
+  dict->slots = safe_malloc(capacity * sizeof(uint32_t));
+}
+
+// Doubles the table and puts every entry back, using the stored hashes.
+static void grow_table(Dict *dict) {
+  free(dict->control);
+  free(dict->slots);
+  alloc_table(dict, dict->capacity * 2);
+  size_t mask = dict->capacity - 1;
+  for (size_t i = 0; i < dict->count; i++) {
+    uint64_t hash = dict->entries[i].hash;
+    size_t position = (size_t)(hash >> 7) & mask;
+    // Every key is distinct, so only an empty slot is needed.
+    for (size_t stride = DICT_GROUP;; stride += DICT_GROUP) {
+      uint32_t empty = match_group(dict->control + position, CONTROL_EMPTY);
+      if (empty) {
+        size_t slot = (position + lowest_bit(empty)) & mask;
+        set_control(dict, slot, (uint8_t)(hash & 0x7f));
+        dict->slots[slot] = (uint32_t)i;
+        break;
+      }
+      position = (position + stride) & mask;
+    }
+  }
+}
+
+/* create a dictionary sized for `count` entries */
+Dict *dict_create(size_t count) {
+  Dict *dict = safe_calloc(1, sizeof(Dict));
+  alloc_table(dict, capacity_for(count));
+  dict->entries_capacity = count ? count : 1;
+  dict->entries = safe_malloc(dict->entries_capacity * sizeof(DictEntry));
+  return dict;
+}
+
+/* add a key or replace its value */
+bool dict_insert(Dict *dict, Value key, uint32_t key_intern, Value value) {
+  // A stored string key keeps its hash for the comparisons to come.
+  if (key.value_type == VALUE_STRING)
+    string_hash(&key);
+  uint64_t hash = hash_value(key);
+  size_t slot;
+  if (find_slot(dict, key, hash, key_intern, &slot)) {
+    DictEntry *entry = &dict->entries[dict->slots[slot]];
+    free_value(&entry->value);
+    entry->value = value;
+    free_value(&key);
+    return false;
+  }
+  if (dict->count + 1 > dict->capacity / 8 * 7) {
+    grow_table(dict);
+    find_slot(dict, key, hash, key_intern, &slot);
+  }
+  if (dict->count == dict->entries_capacity) {
+    dict->entries_capacity *= 2;
+    dict->entries = safe_realloc(dict->entries, dict->entries_capacity * sizeof(DictEntry));
+  }
+  dict->entries[dict->count] = (DictEntry){key, value, hash, key_intern};
+  set_control(dict, slot, (uint8_t)(hash & 0x7f));
+  dict->slots[slot] = (uint32_t)dict->count++;
+  return true;
+}
+
+/* look up the value of a key */
+const Value *dict_find(const Dict *dict, Value key, uint32_t key_intern) {
+  size_t slot;
+  if (!find_slot(dict, key, hash_value(key), key_intern, &slot))
+    return NULL;
+  return &dict->entries[dict->slots[slot]].value;
+}
+
+/* copy a dictionary with its keys and values */
+Dict *dict_copy(const Dict *dict) {
+  Dict *copy = safe_malloc(sizeof(Dict));
+  *copy = *dict;
+  copy->control = safe_malloc(dict->capacity + DICT_GROUP);
+  memcpy(copy->control, dict->control, dict->capacity + DICT_GROUP);
+  copy->slots = safe_malloc(dict->capacity * sizeof(uint32_t));
+  memcpy(copy->slots, dict->slots, dict->capacity * sizeof(uint32_t));
+  copy->entries = safe_malloc(dict->entries_capacity * sizeof(DictEntry));
+  for (size_t i = 0; i < dict->count; i++) {
+    copy->entries[i] = dict->entries[i];
+    copy->entries[i].key = copy_value(dict->entries[i].key);
+    copy->entries[i].value = copy_value(dict->entries[i].value);
+  }
+  return copy;
+}
+
+/* compare two dictionaries regardless of insertion order */
+bool dict_equal(const Dict *left, const Dict *right) {
+  if (left->count != right->count)
+    return false;
+  for (size_t i = 0; i < left->count; i++) {
+    const DictEntry *entry = &left->entries[i];
+    size_t slot;
+    if (!find_slot(right, entry->key, entry->hash, entry->key_intern, &slot))
+      return false;
+    if (!values_equal(entry->value, right->entries[right->slots[slot]].value))
+      return false;
+  }
+  return true;
+}
+
+/* free a dictionary with its keys and values */
+void dict_free(Dict *dict) {
+  if (!dict)
+    return;
+  for (size_t i = 0; i < dict->count; i++) {
+    free_value(&dict->entries[i].key);
+    free_value(&dict->entries[i].value);
+  }
+  free(dict->entries);
+  free(dict->control);
+  free(dict->slots);
+  free(dict);
+}
@@ -0,0 +1,947 @@
+// eval/eval.c
+// This file implements the evaluator. It walks an AST produced by the parser
+// and computes the resulting value, reporting runtime errors such as
+// division by zero through the logging system.
+
+#include "eval/eval.h"
+#include "config.h"
+#include "context.h"
+#include "eval/bigint.h"
+#include "eval/builtins.h"
+#include "eval/dict.h"
+#include "eval/kernels.h"
+#include "eval/power.h"
+#include "eval/value.h"
+#include "lexer/tokens.h"
+#include "parser/ast.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Reports a runtime error at an operator and marks the statement as failed.
+// Unused arguments are ignored by the format string.
+void runtime_error(Token op, const char *fmt, const char *arg1, const char *arg2, const char *arg3) {
+  ctx->has_syntax_error = 1;
+  print_log(LOG_ERROR, fmt, (LogPosition){op.token_line, op.token_index}, op.token_value, arg1, arg2, arg3);
+}
+
+// Converts a number to an integer for bitwise operators, rejecting fractions
+// and values outside the 64-bit range.
+static bool to_integer(double number, int64_t *out) {
+  if (!isfinite(number) || number != floor(number) || number < -9223372036854775808.0 || number >= 9223372036854775808.0)
+    return false;
+  *out = (int64_t)number;
+  return true;
+}
+
+// Converts a number that goes into a list or range, which `kind` names, to
+// a double. Integers past 2^53 are rejected instead of rounded, since the
+// list or range could no longer hold them exactly.
+static bool exact_double(Token op, Value value, const char *kind, double *out) {
+  const int64_t limit = INT64_C(1) << 53;
+  if (value.value_type == VALUE_BIGINT || (value.value_type == VALUE_INTEGER && (value.integer_value > limit || value.integer_value < -limit))) {
+    runtime_error(op, ERR_INTEGER_INEXACT, kind, NULL, NULL);
+    return false;
+  }
+  *out = number_to_double(value);
+  return true;
+}
+
+// Creates the range `first ... last`: every number from `first` up to
+// `last` in steps of one. Only its ends are stored.
+static bool eval_range(Token op, double first, double last, Value *result) {
+  if (!isfinite(first) || !isfinite(last)) {
+    runtime_error(op, ERR_RANGE_BOUNDS, NULL, NULL, NULL);
+    return false;
+  }
+  if (last < first) {
+    *result = make_range(first, 1, 0);
+    return true;
+  }
+  // Past 2^53 consecutive numbers can no longer be told apart.
+  double span = floor(last - first);
+  if (span >= 9007199254740992.0) {
+    runtime_error(op, ERR_RANGE_TOO_LONG, NULL, NULL, NULL);
+    return false;
+  }
+  *result = make_range(first, 1, (size_t)span + 1);
+  return true;
+}
+
+// Creates a range whose bounds may be integers, which must be exact as
+// doubles.
+static bool eval_exact_range(Token op, Value left, Value right, Value *result) {
+  double first, last;
+  return exact_double(op, left, "range", &first) && exact_double(op, right, "range", &last) && eval_range(op, first, last, result);
+}
+
+static bool eval_bitwise_op(Token op, double left, double right, Value *result);
+
+// Applies a binary operator to two numbers.
+static bool eval_number_op(Token op, double left, double right, Value *result) {
+  switch (op.token_type) {
+  case TOKEN_PLUS: *result = make_number(left + right); return true;
+  case TOKEN_MINUS: *result = make_number(left - right); return true;
+  case TOKEN_STAR: *result = make_number(left * right); return true;
+  case TOKEN_SLASH:
+  case TOKEN_DOUBLEPERCENT:
+  case TOKEN_PERCENT:
+    if (right == 0) {
+      runtime_error(op, ERR_DIVISION_BY_ZERO, NULL, NULL, NULL);
+      return false;
+    }
+    if (op.token_type == TOKEN_SLASH) {
+      *result = make_number(left / right);
+    } else if (op.token_type == TOKEN_DOUBLEPERCENT) {
+      *result = make_number(floor(left / right));
+    } else {
+      // The remainder takes the sign of the divisor, matching floor division.
+      double remainder = fmod(left, right);
+      if (remainder != 0 && (remainder < 0) != (right < 0))
+        remainder += right;
+      *result = make_number(remainder);
+    }
+    return true;
+  case TOKEN_POW: *result = make_number(pow(left, right)); return true;
+  case TOKEN_ELLIPSIS: return eval_range(op, left, right, result);
+  case TOKEN_LEFTSHIFT:
+  case TOKEN_RIGHTSHIFT:
+  case TOKEN_AMPERSAND:
+  case TOKEN_PIPE:
+  case TOKEN_CARET: return eval_bitwise_op(op, left, right, result);
+  case TOKEN_EQEQUAL: *result = make_boolean(left == right); return true;
+  case TOKEN_NOTEQUAL: *result = make_boolean(left != right); return true;
+  case TOKEN_LESS: *result = make_boolean(left < right); return true;
+  case TOKEN_LESSEQUAL: *result = make_boolean(left <= right); return true;
+  case TOKEN_GREATER: *result = make_boolean(left > right); return true;
+  case TOKEN_GREATEREQUAL: *result = make_boolean(left >= right); return true;
+  default: runtime_error(op, ERR_TYPE_OP_NOT_SUPPORTED, op.token_value, "number", "number"); return false;
+  }
+}
+
+// Checks whether an operator compares its operands.
+static bool is_comparison(TokenType type) {
+  switch (type) {
+  case TOKEN_EQEQUAL:
+  case TOKEN_NOTEQUAL:
+  case TOKEN_LESS:
+  case TOKEN_LESSEQUAL:
+  case TOKEN_GREATER:
+  case TOKEN_GREATEREQUAL: return true;
+  default: return false;
+  }
+}
+
+// Compares two numbers of any kinds exactly, so a large integer is never
+// rounded to the double it is compared with.
+static bool eval_comparison(Token op, Value left, Value right, Value *result) {
+  int order;
+  bool ordered = compare_numbers(left, right, &order);
+  switch (op.token_type) {
+  case TOKEN_EQEQUAL: *result = make_boolean(ordered && order == 0); break;
+  case TOKEN_NOTEQUAL: *result = make_boolean(!ordered || order != 0); break;
+  case TOKEN_LESS: *result = make_boolean(ordered && order < 0); break;
+  case TOKEN_LESSEQUAL: *result = make_boolean(ordered && order <= 0); break;
+  case TOKEN_GREATER: *result = make_boolean(ordered && order > 0); break;
+  case TOKEN_GREATEREQUAL:
+  default: *result = make_boolean(ordered && order >= 0); break;
+  }
+  return true;
+}
+
+// Raises an integer to a non-negative exponent exactly, refusing results
+// too large to compute.
+static bool eval_integer_power(Token op, Value base, uint64_t exponent, Value *result) {
+  if (!power_fits(base, exponent)) {
+    runtime_error(op, ERR_INTEGER_TOO_LARGE, op.token_value, NULL, NULL);
+    return false;
+  }
+  *result = power_integer(base, exponent);
+  return true;
+}
+
+// Applies an operator to two integers when at least one is a big integer,
+// or when the 64-bit result overflowed. The operands stay owned by the
+// caller.
+static bool eval_bigint_op(Token op, Value left, Value right, Value *result) {
+  if (is_comparison(op.token_type))
+    return eval_comparison(op, left, right, result);
+  switch (op.token_type) {
+  case TOKEN_POW:
+    if (right.value_type == VALUE_INTEGER && right.integer_value >= 0)
+      return eval_integer_power(op, left, (uint64_t)right.integer_value, result);
+    return eval_number_op(op, number_to_double(left), number_to_double(right), result);
+  case TOKEN_SLASH: return eval_number_op(op, number_to_double(left), number_to_double(right), result);
+  case TOKEN_ELLIPSIS: return eval_exact_range(op, left, right, result);
+  case TOKEN_AMPERSAND:
+  case TOKEN_PIPE:
+  case TOKEN_CARET: runtime_error(op, ERR_INTEGER_TOO_LARGE, op.token_value, NULL, NULL); return false;
+  default: break;
+  }
+
+  BigInt *a = value_to_bigint(left), *b = value_to_bigint(right), *value = NULL;
+  switch (op.token_type) {
+  case TOKEN_PLUS: value = bigint_add(a, b); break;
+  case TOKEN_MINUS: value = bigint_sub(a, b); break;
+  case TOKEN_STAR: value = bigint_mul(a, b); break;
+  case TOKEN_DOUBLEPERCENT:
+  case TOKEN_PERCENT: {
+    if (!b->length) {
+      runtime_error(op, ERR_DIVISION_BY_ZERO, NULL, NULL, NULL);
+      break;
+    }
+    BigInt *remainder;
+    BigInt *quotient = bigint_divmod(a, b, &remainder);
+    value = op.token_type == TOKEN_DOUBLEPERCENT ? quotient : remainder;
+    free(op.token_type == TOKEN_DOUBLEPERCENT ? remainder : quotient);
+    break;
+  }
+  case TOKEN_LEFTSHIFT:
+  case TOKEN_RIGHTSHIFT: {
+    int64_t count;
+    bool small = bigint_to_int64(b, &count);
+    if (b->negative) {
+      runtime_error(op, ERR_NEGATIVE_SHIFT, NULL, NULL, NULL);
+    } else if (op.token_type == TOKEN_RIGHTSHIFT) {
+      value = bigint_shift_right(a, small ? (uint64_t)count : UINT64_MAX);
+    } else if (!a->length) {
+      value = bigint_from_int64(0);
+    } else if (!small || count > BIGINT_SHIFT_LIMIT) {
+      runtime_error(op, ERR_INTEGER_TOO_LARGE, op.token_value, NULL, NULL);
+    } else {
+      value = bigint_shift_left(a, (uint64_t)count);
+    }
+    break;
+  }
+  default: runtime_error(op, ERR_TYPE_OP_NOT_SUPPORTED, op.token_value, "integer", "integer"); break;
+  }
+  free(a);
+  free(b);
+  if (!value)
+    return false;
+  *result = make_bigint(value);
+  return true;
+}
+
+// Applies an operator to two 64-bit integers. Arithmetic is checked for
+// overflow and only moves to big integers when it happens, so integer code
+// stays on machine words. `/`, `...` and negative powers work on doubles.
+static bool eval_integer_op(Token op, int64_t a, int64_t b, Value *result) {
+  int64_t value;
+  switch (op.token_type) {
+  case TOKEN_PLUS:
+    if (__builtin_add_overflow(a, b, &value))
+      break;
+    *result = make_integer(value);
+    return true;
+  case TOKEN_MINUS:
+    if (__builtin_sub_overflow(a, b, &value))
+      break;
+    *result = make_integer(value);
+    return true;
+  case TOKEN_STAR:
+    if (__builtin_mul_overflow(a, b, &value))
+      break;
+    *result = make_integer(value);
+    return true;
+  case TOKEN_DOUBLEPERCENT:
+  case TOKEN_PERCENT: {
+    if (b == 0) {
+      runtime_error(op, ERR_DIVISION_BY_ZERO, NULL, NULL, NULL);
+      return false;
+    }
+    // INT64_MIN // -1 is the one quotient that overflows.
+    if (a == INT64_MIN && b == -1)
+      break;
+    // Round the quotient down, so the remainder takes the divisor's sign.
+    int64_t quotient = a / b, remainder = a % b;
+    if (remainder != 0 && (remainder < 0) != (b < 0)) {
+      quotient--;
+      remainder += b;
+    }
+    *result = make_integer(op.token_type == TOKEN_DOUBLEPERCENT ? quotient : remainder);
+    return true;
+  }
+  case TOKEN_LEFTSHIFT:
+    if (b < 0) {
+      runtime_error(op, ERR_NEGATIVE_SHIFT, NULL, NULL, NULL);
+      return false;
+    }
+    if (a != 0 && (b >= 63 || (a >= 0 ? a > INT64_MAX >> b : a < INT64_MIN >> b)))
+      break;
+    *result = make_integer(a == 0 ? 0 : (int64_t)((uint64_t)a << b));
+    return true;
+  case TOKEN_RIGHTSHIFT:
+    if (b < 0) {
+      runtime_error(op, ERR_NEGATIVE_SHIFT, NULL, NULL, NULL);
+      return false;
+    }
+    *result = make_integer(b >= 64 ? (a < 0 ? -1 : 0) : a >> b);
+    return true;
+  case TOKEN_POW:
+    if (b < 0)
+      return eval_number_op(op, (double)a, (double)b, result);
+    return eval_integer_power(op, make_integer(a), (uint64_t)b, result);
+  case TOKEN_AMPERSAND: *result = make_integer(a & b); return true;
+  case TOKEN_PIPE: *result = make_integer(a | b); return true;
+  case TOKEN_CARET: *result = make_integer(a ^ b); return true;
+  case TOKEN_EQEQUAL: *result = make_boolean(a == b); return true;
+  case TOKEN_NOTEQUAL: *result = make_boolean(a != b); return true;
+  case TOKEN_LESS: *result = make_boolean(a < b); return true;
+  case TOKEN_LESSEQUAL: *result = make_boolean(a <= b); return true;
+  case TOKEN_GREATER: *result = make_boolean(a > b); return true;
+  case TOKEN_GREATEREQUAL: *result = make_boolean(a >= b); return true;
+  case TOKEN_ELLIPSIS: return eval_exact_range(op, make_integer(a), make_integer(b), result);
+  default: return eval_number_op(op, (double)a, (double)b, result);
+  }
+  // The result doesn't fit in 64 bits.
+  return eval_bigint_op(op, make_integer(a), make_integer(b), result);
+}
+
+// Applies a bitwise or shift operator to two integral doubles.
+static bool eval_bitwise_op(Token op, double left, double right, Value *result) {
+  int64_t a, b;
+  if (!to_integer(left, &a) || !to_integer(right, &b)) {
+    runtime_error(op, ERR_INTEGER_OPERANDS, op.token_value, NULL, NULL);
+    return false;
+  }
+  return eval_integer_op(op, a, b, result);
+}
+
+// Applies an operator to an integer and a double. Comparisons are exact;
+// everything else works on doubles.
+static bool eval_mixed_op(Token op, Value left, Value right, Value *result) {
+  if (is_comparison(op.token_type))
+    return eval_comparison(op, left, right, result);
+  if (op.token_type == TOKEN_ELLIPSIS)
+    return eval_exact_range(op, left, right, result);
+  return eval_number_op(op, number_to_double(left), number_to_double(right), result);
+}
+
+// Turns an integer operand of a list or range operator into a double,
+// since those hold doubles. Other values are left as they are.
+static bool as_double(Token op, Value *value, const char *kind) {
+  double number;
+  if (!is_integral(*value))
+    return true;
+  if (!exact_double(op, *value, kind, &number))
+    return false;
+  free_value(value);
+  *value = make_number(number);
+  return true;
+}
+
+// Applies a binary operator to two strings.
+static bool eval_string_op(Token op, Value left, Value right, Value *result) {
+  if (op.token_type == TOKEN_PLUS) {
+    Value value;
+    value.value_type = VALUE_STRING;
+    value.string_length = left.string_length + right.string_length;
+    value.string_value = safe_malloc(value.string_length + 1);
+    value.string_hash = 0;
+    memcpy(value.string_value, left.string_value, left.string_length);
+    memcpy(value.string_value + left.string_length, right.string_value, right.string_length);
+    value.string_value[value.string_length] = '\0';
+    *result = value;
+    return true;
+  }
+
+  // Equality checks lengths and cached hashes before any bytes.
+  if (op.token_type == TOKEN_EQEQUAL || op.token_type == TOKEN_NOTEQUAL) {
+    bool equal = strings_equal(left, right);
+    *result = make_boolean(op.token_type == TOKEN_EQEQUAL ? equal : !equal);
+    return true;
+  }
+
+  // Order by the common prefix, then the lengths. memcmp() compares whole
+  // vector registers at a time.
+  size_t common = left.string_length < right.string_length ? left.string_length : right.string_length;
+  int cmp = memcmp(left.string_value, right.string_value, common);
+  if (cmp == 0)
+    cmp = (left.string_length > right.string_length) - (left.string_length < right.string_length);
+
+  switch (op.token_type) {
+  case TOKEN_LESS: *result = make_boolean(cmp < 0); return true;
+  case TOKEN_LESSEQUAL: *result = make_boolean(cmp <= 0); return true;
+  case TOKEN_GREATER: *result = make_boolean(cmp > 0); return true;
+  case TOKEN_GREATEREQUAL: *result = make_boolean(cmp >= 0); return true;
+  default: runtime_error(op, ERR_TYPE_OP_NOT_SUPPORTED, op.token_value, "string", "string"); return false;
+  }
+}
+
+// Returns the number items of a list operand and how far to step between
+// them; a number operand is repeated with a step of 0.
+static const double *list_operand(const Value *value, size_t *step) {
+  if (value->value_type == VALUE_LIST) {
+    *step = 1;
+    return value->list_items;
+  }
+  *step = 0;
+  return &value->number_value;
+}
+
+// Applies an arithmetic or comparison operator element-wise to lists of
+// numbers, or to a list and a number.
+static bool eval_list_op(Token op, Value left, Value right, Value *result) {
+  const Value *list = left.value_type == VALUE_LIST ? &left : &right;
+  bool numeric = (left.value_type == VALUE_NUMBER || (left.value_type == VALUE_LIST && left.list_type == VALUE_NUMBER)) &&
+                 (right.value_type == VALUE_NUMBER || (right.value_type == VALUE_LIST && right.list_type == VALUE_NUMBER));
+  bool compare = false;
+  ArithKernel arith = KERNEL_ADD;
+  CompareKernel comparison = KERNEL_EQ;
+  switch (op.token_type) {
+  case TOKEN_PLUS: arith = KERNEL_ADD; break;
+  case TOKEN_MINUS: arith = KERNEL_SUB; break;
+  case TOKEN_STAR: arith = KERNEL_MUL; break;
+  case TOKEN_SLASH: arith = KERNEL_DIV; break;
+  case TOKEN_POW: arith = KERNEL_POW; break;
+  case TOKEN_EQEQUAL: comparison = KERNEL_EQ, compare = true; break;
+  case TOKEN_NOTEQUAL: comparison = KERNEL_NE, compare = true; break;
+  case TOKEN_LESS: comparison = KERNEL_LT, compare = true; break;
+  case TOKEN_LESSEQUAL: comparison = KERNEL_LE, compare = true; break;
+  case TOKEN_GREATER: comparison = KERNEL_GT, compare = true; break;
+  case TOKEN_GREATEREQUAL: comparison = KERNEL_GE, compare = true; break;
+  default: numeric = false; break;
+  }
+  if (!numeric) {
+    runtime_error(op, ERR_TYPE_OP_NOT_SUPPORTED, op.token_value, value_type_to_string(left.value_type), value_type_to_string(right.value_type));
+    return false;
+  }
+  if (left.value_type == VALUE_LIST && right.value_type == VALUE_LIST && left.list_length != right.list_length) {
+    char left_length[32], right_length[32];
+    snprintf(left_length, sizeof(left_length), "%zu", left.list_length);
+    snprintf(right_length, sizeof(right_length), "%zu", right.list_length);
+    runtime_error(op, ERR_LIST_LENGTHS, op.token_value, left_length, right_length);
+    return false;
+  }
+
+  size_t left_step, right_step;
+  const double *a = list_operand(&left, &left_step);
+  const double *b = list_operand(&right, &right_step);
+  size_t length = list->list_length;
+  // Squaring is a multiplication, which has a vector kernel; pow() has none.
+  if (arith == KERNEL_POW && right_step == 0 && *b == 2) {
+    arith = KERNEL_MUL;
+    b = a;
+    right_step = left_step;
+  }
+  if (op.token_type == TOKEN_SLASH && kernel_has_zero(b, right_step ? length : 1)) {
+    runtime_error(op, ERR_DIVISION_BY_ZERO, NULL, NULL, NULL);
+    return false;
+  }
+  if (compare) {
+    *result = make_list(VALUE_BOOLEAN, length);
+    kernel_compare(comparison, a, left_step, b, right_step, result->list_items, length);
+  } else {
+    *result = make_list(VALUE_NUMBER, length);
+    kernel_arith(arith, a, left_step, b, right_step, result->list_items, length);
+  }
+  return true;
+}
+
+// Expands a range into a list of its numbers, for operations that have no
+// closed form.
+static bool expand_range(Token op, Value range, Value *list) {
+  if (range.range_length > RANGE_EXPAND_LIMIT) {
+    char length[32];
+    snprintf(length, sizeof(length), "%zu", range.range_length);
+    runtime_error(op, ERR_RANGE_TOO_LARGE, length, NULL, NULL);
+    return false;
+  }
+  *list = make_list(VALUE_NUMBER, range.range_length);
+  double *items = list->list_items;
+  for (size_t i = 0; i < range.range_length; i++)
+    items[i] = range_item(range, i);
+  return true;
+}
+
+// Applies an operator to a range and a number, list or range. Shifting and
+// scaling have closed forms that give another range, so they take constant
+// time and memory; other operators expand the ranges into lists.
+static bool eval_range_op(Token op, Value left, Value right, Value *result) {
+  bool left_range = left.value_type == VALUE_RANGE, right_range = right.value_type == VALUE_RANGE;
+  bool left_number = left.value_type == VALUE_NUMBER, right_number = right.value_type == VALUE_NUMBER;
+  if (!(left_range || left_number || left.value_type == VALUE_LIST) || !(right_range || right_number || right.value_type == VALUE_LIST)) {
+    runtime_error(op, ERR_TYPE_OP_NOT_SUPPORTED, op.token_value, value_type_to_string(left.value_type), value_type_to_string(right.value_type));
+    return false;
+  }
+
+  if (left_range && right_range && (op.token_type == TOKEN_PLUS || op.token_type == TOKEN_MINUS)) {
+    if (left.range_length != right.range_length) {
+      char left_length[32], right_length[32];
+      snprintf(left_length, sizeof(left_length), "%zu", left.range_length);
+      snprintf(right_length, sizeof(right_length), "%zu", right.range_length);
+      runtime_error(op, ERR_LIST_LENGTHS, op.token_value, left_length, right_length);
+      return false;
+    }
+    double sign = op.token_type == TOKEN_PLUS ? 1 : -1;
+    *result = make_range(left.range_start + sign * right.range_start, left.range_step + sign * right.range_step, left.range_length);
+    return true;
+  }
+  if (left_range && right_number) {
+    double k = right.number_value;
+    switch (op.token_type) {
+    case TOKEN_PLUS: *result = make_range(left.range_start + k, left.range_step, left.range_length); return true;
+    case TOKEN_MINUS: *result = make_range(left.range_start - k, left.range_step, left.range_length); return true;
+    case TOKEN_STAR: *result = make_range(left.range_start * k, left.range_step * k, left.range_length); return true;
+    case TOKEN_SLASH:
+      if (k == 0) {
+        runtime_error(op, ERR_DIVISION_BY_ZERO, NULL, NULL, NULL);
+        return false;
+      }
+      *result = make_range(left.range_start / k, left.range_step / k, left.range_length);
+      return true;
+    default: break;
+    }
+  }
+  if (left_number && right_range) {
+    double k = left.number_value;
+    switch (op.token_type) {
+    case TOKEN_PLUS: *result = make_range(k + right.range_start, right.range_step, right.range_length); return true;
+    case TOKEN_MINUS: *result = make_range(k - right.range_start, -right.range_step, right.range_length); return true;
+    case TOKEN_STAR: *result = make_range(k * right.range_start, k * right.range_step, right.range_length); return true;
+    default: break;
+    }
+  }
+
+  Value left_list = left, right_list = right;
+  if (left_range && !expand_range(op, left, &left_list))
+    return false;
+  if (right_range && !expand_range(op, right, &right_list)) {
+    if (left_range)
+      free_value(&left_list);
+    return false;
+  }
+  bool ok = eval_list_op(op, left_list, right_list, result);
+  if (left_range)
+    free_value(&left_list);
+  if (right_range)
+    free_value(&right_list);
+  return ok;
+}
+
+// Checks whether a node is a binary operator that evaluates both operands
+// without short-circuiting.
+static bool is_plain_binary(const Node *node) {
+  if (!node || node->node_type != NODE_BINARY_OP)
+    return false;
+  switch (node->binary.op.token_type) {
+  case TOKEN_AND:
+  case TOKEN_OR:
+  case TOKEN_EQUAL:
+  case TOKEN_PLUSEQUAL:
+  case TOKEN_MINEQUAL:
+  case TOKEN_STAREQUAL:
+  case TOKEN_SLASHEQUAL:
+  case TOKEN_PERCENTEQUAL:
+  case TOKEN_AMPERSANDEQUAL:
+  case TOKEN_PIPEEQUAL:
+  case TOKEN_CARETEQUAL:
+  case TOKEN_LEFTSHIFTEQUAL:
+  case TOKEN_RIGHTSHIFTEQUAL:
+  case TOKEN_DOUBLESTAREQUAL:
+  case TOKEN_DOUBLEPERCENTEQUAL: return false;
+  default: return true;
+  }
+}
+
+// Answers == and != between two literals from their intern ids alone: the
+// lexer interns decoded values, so the ids match exactly when the strings do.
+static bool compare_literals(const Node *node, Value *result) {
+  Token op = node->binary.op;
+  const Node *left = node->binary.left, *right = node->binary.right;
+  if ((op.token_type != TOKEN_EQEQUAL && op.token_type != TOKEN_NOTEQUAL) || !left || !right || !is_string_literal(left) || !is_string_literal(right))
+    return false;
+  bool equal = left->token.token_intern == right->token.token_intern;
+  *result = make_boolean(equal == (op.token_type == TOKEN_EQEQUAL));
+  return true;
+}
+
+// Applies a binary operator to two evaluated operands and frees them.
+static bool apply_binary(Token op, Value left, Value right, Value *result) {
+  bool ok;
+  if (left.value_type == VALUE_INTEGER && right.value_type == VALUE_INTEGER) {
+    ok = eval_integer_op(op, left.integer_value, right.integer_value, result);
+  } else if (left.value_type == VALUE_NUMBER && right.value_type == VALUE_NUMBER) {
+    ok = eval_number_op(op, left.number_value, right.number_value, result);
+  } else if (is_integral(left) && is_integral(right)) {
+    ok = eval_bigint_op(op, left, right, result);
+  } else if (is_numeric(left) && is_numeric(right)) {
+    ok = eval_mixed_op(op, left, right, result);
+  } else if (left.value_type == VALUE_STRING && right.value_type == VALUE_STRING) {
+    ok = eval_string_op(op, left, right, result);
+  } else if (left.value_type == VALUE_RANGE || right.value_type == VALUE_RANGE) {
+    ok = as_double(op, &left, "range") && as_double(op, &right, "range") && eval_range_op(op, left, right, result);
+  } else if (left.value_type == VALUE_LIST || right.value_type == VALUE_LIST) {
+    ok = as_double(op, &left, "list") && as_double(op, &right, "list") && eval_list_op(op, left, right, result);
+  } else if (op.token_type == TOKEN_EQEQUAL || op.token_type == TOKEN_NOTEQUAL) {
+    bool equal = values_equal(left, right);
+    *result = make_boolean(op.token_type == TOKEN_EQEQUAL ? equal : !equal);
+    ok = true;
+  } else {
+    runtime_error(op, ERR_TYPE_OP_NOT_SUPPORTED, op.token_value, value_type_to_string(left.value_type), value_type_to_string(right.value_type));
+    ok = false;
+  }
+  free_value(&left);
+  free_value(&right);
+  return ok;
+}
+
+// Applies a `**` whose exponent is a constant picked out by the parser to
+// the operand in place. Integers are left to the exact path, except for
+// square roots. Returns false if the node needs the generic path.
+static bool constant_power(const Node *node, Value *operand) {
+  switch (node->binary.power) {
+  case POWER_SQRT: {
+    if (!is_numeric(*operand))
+      return false;
+    double number = number_to_double(*operand);
+    free_value(operand);
+    *operand = make_number(power_sqrt(number));
+    return true;
+  }
+  case POWER_SMALL:
+    if (operand->value_type != VALUE_NUMBER)
+      return false;
+    operand->number_value = power_chain(operand->number_value, node->binary.exponent);
+    return true;
+  default: return false;
+  }
+}
+
+// Evaluates a chain of plain binary operators such as `1 + 2 * 3 - 4`. Its
+// left operands nest as deep as the chain is long, so they are walked in a
+// loop instead of recursively.
+static bool eval_chain(Node *node, Value *result) {
+  size_t depth = 0;
+  for (Node *n = node; is_plain_binary(n); n = n->binary.left)
+    depth++;
+  Node *stack_chain[16];
+  Node **chain = depth <= 16 ? stack_chain : safe_malloc(depth * sizeof(Node *));
+  chain[0] = node;
+  for (size_t i = 1; i < depth; i++)
+    chain[i] = chain[i - 1]->binary.left;
+
+  // Start from the innermost operator and apply the others outwards.
+  Value left;
+  size_t next = depth;
+  bool ok = true;
+  if (compare_literals(chain[depth - 1], &left))
+    next--;
+  else
+    ok = evaluate(chain[depth - 1]->binary.left, &left);
+  while (ok && next-- > 0) {
+    // The exponent of a constant power is never evaluated.
+    if (constant_power(chain[next], &left))
+      continue;
+    Value right;
+    if (!evaluate(chain[next]->binary.right, &right)) {
+      free_value(&left);
+      ok = false;
+      break;
+    }
+    Value value;
+    ok = apply_binary(chain[next]->binary.op, left, right, &value);
+    left = value;
+  }
+  if (ok)
+    *result = left;
+  if (chain != stack_chain)
+    free(chain);
+  return ok;
+}
+
+// Evaluates a binary operation node.
+static bool eval_binary(Node *node, Value *result) {
+  Token op = node->binary.op;
+  switch (op.token_type) {
+  case TOKEN_EQUAL:
+  case TOKEN_PLUSEQUAL:
+  case TOKEN_MINEQUAL:
+  case TOKEN_STAREQUAL:
+  case TOKEN_SLASHEQUAL:
+  case TOKEN_PERCENTEQUAL:
+  case TOKEN_AMPERSANDEQUAL:
+  case TOKEN_PIPEEQUAL:
+  case TOKEN_CARETEQUAL:
+  case TOKEN_LEFTSHIFTEQUAL:
+  case TOKEN_RIGHTSHIFTEQUAL:
+  case TOKEN_DOUBLESTAREQUAL:
+  case TOKEN_DOUBLEPERCENTEQUAL:
+    // There are no variables yet, so nothing can be assigned to.
+    runtime_error(op, ERR_INVALID_ASSIGNMENT, op.token_value, NULL, NULL);
+    return false;
+  case TOKEN_AND:
+  case TOKEN_OR: break;
+  default: return eval_chain(node, result);
+  }
+
+  // Logical operators short-circuit on the left operand.
+  Value left, right;
+  if (!evaluate(node->binary.left, &left))
+    return false;
+  bool truthy = is_truthy(left);
+  free_value(&left);
+  if (truthy == (op.token_type == TOKEN_OR)) {
+    *result = make_boolean(truthy);
+    return true;
+  }
+  if (!evaluate(node->binary.right, &right))
+    return false;
+  *result = make_boolean(is_truthy(right));
+  free_value(&right);
+  return true;
+}
+
+// Evaluates a chain of string '+'. The pieces are evaluated first, so the
+// result is allocated once at its final size and each piece copied once.
+static bool eval_concat(Node *node, Value *result) {
+  size_t count = node->concat.count;
+  Value *parts = safe_malloc(count * sizeof(Value));
+  size_t length = 0;
+  size_t done = 0;
+  bool ok = true;
+  for (; done < count; done++) {
+    Node *part = node->concat.parts[done];
+    if (is_string_literal(part)) {
+      // Copy a literal's bytes straight from the node.
+      parts[done] = (Value){.value_type = VALUE_STRING, .string_value = (char *)part->string_value, .string_length = literal_length(part)};
+      length += parts[done].string_length;
+      continue;
+    }
+    if (!evaluate(part, &parts[done])) {
+      ok = false;
+      break;
+    }
+    if (parts[done].value_type != VALUE_STRING) {
+      runtime_error(node->concat.op, ERR_TYPE_OP_NOT_SUPPORTED, node->concat.op.token_value, "string", value_type_to_string(parts[done].value_type));
+      done++;
+      ok = false;
+      break;
+    }
+    length += parts[done].string_length;
+  }
+
+  if (ok) {
+    Value value;
+    value.value_type = VALUE_STRING;
+    value.string_length = length;
+    value.string_value = safe_malloc(length + 1);
+    value.string_hash = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+      memcpy(value.string_value + offset, parts[i].string_value, parts[i].string_length);
+      offset += parts[i].string_length;
+    }
+    value.string_value[length] = '\0';
+    *result = value;
+  }
+  for (size_t i = 0; i < done; i++)
+    if (!is_string_literal(node->concat.parts[i]))
+      free_value(&parts[i]);
+  free(parts);
+  return ok;
+}
+
+// Evaluates a list literal into a packed array of numbers.
+static bool eval_list(Node *node, Value *result) {
+  Value list = make_list(VALUE_NUMBER, node->list.count);
+  double *items = list.list_items;
+  for (size_t i = 0; i < node->list.count; i++) {
+    Value item;
+    if (!evaluate(node->list.items[i], &item)) {
+      free_value(&list);
+      return false;
+    }
+    if (!is_numeric(item)) {
+      runtime_error(node_start(node->list.items[i]), ERR_LIST_ITEM_TYPE, value_type_to_string(item.value_type), NULL, NULL);
+      free_value(&item);
+      free_value(&list);
+      return false;
+    }
+    bool exact = exact_double(node_start(node->list.items[i]), item, "list", &items[i]);
+    free_value(&item);
+    if (!exact) {
+      free_value(&list);
+      return false;
+    }
+  }
+  *result = list;
+  return true;
+}
+
+// Evaluates a dictionary literal. The table is sized for every entry up
+// front, and keys written as string literals carry their intern id.
+static bool eval_dict(Node *node, Value *result) {
+  size_t count = node->dict.count / 2;
+  Dict *dict = dict_create(count);
+  for (size_t i = 0; i < count; i++) {
+    Node *key_node = node->dict.entries[2 * i];
+    Value key, value;
+    if (!evaluate(key_node, &key)) {
+      dict_free(dict);
+      return false;
+    }
+    if (!is_numeric(key) && key.value_type != VALUE_STRING && key.value_type != VALUE_BOOLEAN) {
+      runtime_error(node_start(key_node), ERR_DICT_KEY_TYPE, value_type_to_string(key.value_type), NULL, NULL);
+      free_value(&key);
+      dict_free(dict);
+      return false;
+    }
+    if (!evaluate(node->dict.entries[2 * i + 1], &value)) {
+      free_value(&key);
+      dict_free(dict);
+      return false;
+    }
+    dict_insert(dict, key, is_string_literal(key_node) ? key_node->token.token_intern : 0, value);
+  }
+  *result = make_dict(dict);
+  return true;
+}
+
+// Evaluates a builtin call. The arguments are evaluated first and freed
+// once the builtin has run.
+static bool eval_call(Node *node, Value *result) {
+  Value args[BUILTIN_MAX_ARGS];
+  size_t done = 0;
+  bool ok = true;
+  for (; done < node->call.count && done < BUILTIN_MAX_ARGS; done++) {
+    if (!evaluate(node->call.args[done], &args[done])) {
+      ok = false;
+      break;
+    }
+  }
+  if (ok)
+    ok = call_builtin((Builtin)node->call.builtin, node_start(node), args, result);
+  for (size_t i = 0; i < done; i++)
+    free_value(&args[i]);
+  return ok;
+}
+
+// Applies a prefix operator to an integer and frees it. Only a result that
+// overflows 64 bits moves to big integers.
+static bool eval_integer_unary(Token op, Value operand, Value *result) {
+  int64_t value;
+  if (operand.value_type == VALUE_INTEGER) {
+    int64_t a = operand.integer_value;
+    switch (op.token_type) {
+    case TOKEN_PLUS: *result = operand; return true;
+    case TOKEN_TILDE: *result = make_integer(~a); return true;
+    case TOKEN_MINUS:
+      if (__builtin_sub_overflow((int64_t)0, a, &value))
+        break;
+      *result = make_integer(value);
+      return true;
+    case TOKEN_INCREMENT:
+      if (__builtin_add_overflow(a, (int64_t)1, &value))
+        break;
+      *result = make_integer(value);
+      return true;
+    case TOKEN_DECREMENT:
+      if (__builtin_sub_overflow(a, (int64_t)1, &value))
+        break;
+      *result = make_integer(value);
+      return true;
+    default: break;
+    }
+  }
+
+  // On big integers -x is 0 - x, ++x is x + 1, --x is x - 1 and ~x is
+  // -1 - x.
+  Token arith = op;
+  Value left = operand, right = make_integer(1);
+  switch (op.token_type) {
+  case TOKEN_PLUS: *result = operand; return true;
+  case TOKEN_MINUS: arith.token_type = TOKEN_MINUS, left = make_integer(0), right = operand; break;
+  case TOKEN_INCREMENT: arith.token_type = TOKEN_PLUS; break;
+  case TOKEN_DECREMENT: arith.token_type = TOKEN_MINUS; break;
+  case TOKEN_TILDE: arith.token_type = TOKEN_MINUS, left = make_integer(-1), right = operand; break;
+  default:
+    runtime_error(op, ERR_UNARY_NOT_SUPPORTED, op.token_value, "integer", NULL);
+    free_value(&operand);
+    return false;
+  }
+  bool ok = eval_bigint_op(arith, left, right, result);
+  free_value(&operand);
+  return ok;
+}
+
+// Evaluates a prefix or postfix unary operation node.
+static bool eval_unary(Node *node, Value *result) {
+  Token op = node->unary.op;
+  Value operand;
+  if (!evaluate(node->unary.operand, &operand))
+    return false;
+
+  if (op.token_type == TOKEN_NOT) {
+    *result = make_boolean(!is_truthy(operand));
+    free_value(&operand);
+    return true;
+  }
+  // A range negates in closed form.
+  if (operand.value_type == VALUE_RANGE && node->node_type == NODE_UNARY_OP && (op.token_type == TOKEN_PLUS || op.token_type == TOKEN_MINUS)) {
+    double sign = op.token_type == TOKEN_MINUS ? -1 : 1;
+    *result = make_range(sign * operand.range_start, sign * operand.range_step, operand.range_length);
+    return true;
+  }
+  if (!is_numeric(operand)) {
+    runtime_error(op, ERR_UNARY_NOT_SUPPORTED, op.token_value, value_type_to_string(operand.value_type), NULL);
+    free_value(&operand);
+    return false;
+  }
+
+  // Postfix operators yield the operand's value before the update.
+  if (node->node_type == NODE_POSTFIX_OP) {
+    *result = operand;
+    return true;
+  }
+  if (is_integral(operand))
+    return eval_integer_unary(op, operand, result);
+  double number = operand.number_value;
+  switch (op.token_type) {
+  case TOKEN_PLUS: *result = make_number(number); return true;
+  case TOKEN_MINUS: *result = make_number(-number); return true;
+  case TOKEN_INCREMENT: *result = make_number(number + 1); return true;
+  case TOKEN_DECREMENT: *result = make_number(number - 1); return true;
+  case TOKEN_TILDE: {
+    int64_t integer;
+    if (!to_integer(number, &integer)) {
+      runtime_error(op, ERR_INTEGER_OPERANDS, op.token_value, NULL, NULL);
+      return false;
+    }
+    *result = make_number((double)~integer);
+    return true;
+  }
+  default: runtime_error(op, ERR_UNARY_NOT_SUPPORTED, op.token_value, "number", NULL); return false;
+  }
+}
+
+// Evaluates an AST and stores its value in `result`.
+bool evaluate(Node *node, Value *result) {
+  debug_func("");
+  *result = make_null();
+  if (!node)
+    return true;
+
+  switch (node->node_type) {
+  case NODE_NUMBER: *result = make_number(node->number_value); return true;
+  case NODE_INTEGER: *result = make_integer(node->integer_value); return true;
+  case NODE_BIGINT: *result = make_bigint(bigint_copy(node->bigint_value)); return true;
+  case NODE_CHAR:
+  case NODE_STRING: *result = make_string(node->string_value, literal_length(node)); return true;
+  case NODE_BOOLEAN: *result = make_boolean(node->boolean_value); return true;
+  case NODE_NULL: return true;
+  case NODE_BINARY_OP: return eval_binary(node, result);
+  case NODE_CONCAT: return eval_concat(node, result);
+  case NODE_LIST: return eval_list(node, result);
+  case NODE_DICT: return eval_dict(node, result);
+  case NODE_CALL: return eval_call(node, result);
+  case NODE_UNARY_OP:
+  case NODE_POSTFIX_OP: return eval_unary(node, result);
+  default: return true;
+  }
+}
@@ -0,0 +1,153 @@
+// eval/kernels.c
+// This file implements the element-wise list kernels. Each loop has a plain
+// C version and, on x86 compilers that support it, an AVX2 version that
+// handles four numbers per instruction. The AVX2 versions are compiled with
+// a target attribute and picked at run time, so the binary still runs on
+// processors without AVX2.
+
+#include "eval/kernels.h"
+#include <math.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// Applies one arithmetic operator to two numbers.
+static double arith(ArithKernel op, double a, double b) {
+  switch (op) {
+  case KERNEL_ADD: return a + b;
+  case KERNEL_SUB: return a - b;
+  case KERNEL_MUL: return a * b;
+  case KERNEL_DIV: return a / b;
+  case KERNEL_POW:
+  default: return pow(a, b);
+  }
+}
+
+// Applies one comparison operator to two numbers.
+static bool compare(CompareKernel op, double a, double b) {
+  switch (op) {
+  case KERNEL_EQ: return a == b;
+  case KERNEL_NE: return a != b;
+  case KERNEL_LT: return a < b;
+  case KERNEL_LE: return a <= b;
+  case KERNEL_GT: return a > b;
+  case KERNEL_GE:
+  default: return a >= b;
+  }
+}
+
+// Plain C loops, also used for the elements left over after the vector
+// loops.
+static void scalar_arith(ArithKernel op, const double *a, size_t a_step, const double *b, size_t b_step, double *out, size_t from, size_t n) {
+  for (size_t i = from; i < n; i++)
+    out[i] = arith(op, a[i * a_step], b[i * b_step]);
+}
+
+static void scalar_compare(CompareKernel op, const double *a, size_t a_step, const double *b, size_t b_step, bool *out, size_t from, size_t n) {
+  for (size_t i = from; i < n; i++)
+    out[i] = compare(op, a[i * a_step], b[i * b_step]);
+}
+
+#ifdef HAVE_AVX2_KERNELS
+// Checks whether the processor supports AVX2. The compiler runtime fills
+// in the answer at startup, so this is a load and a test.
+static bool has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+
+// Loads four operands: the next four of a list, or one scalar four times.
+#define LOAD4(p, step, i) ((step) ? _mm256_loadu_pd((p) + (i)) : _mm256_set1_pd(*(p)))
+
+// Runs `expression` over four numbers at a time and returns how many were
+// handled.
+#define ARITH_LOOP(expression)                                                                                                                                                                         \
+  for (; i + 4 <= n; i += 4) {                                                                                                                                                                         \
+    __m256d x = LOAD4(a, a_step, i), y = LOAD4(b, b_step, i);                                                                                                                                          \
+    _mm256_storeu_pd(out + i, expression);                                                                                                                                                             \
+  }
+
+__attribute__((target("avx2"))) static size_t avx2_arith(ArithKernel op, const double *a, size_t a_step, const double *b, size_t b_step, double *out, size_t n) {
+  size_t i = 0;
+  switch (op) {
+  case KERNEL_ADD: ARITH_LOOP(_mm256_add_pd(x, y)); break;
+  case KERNEL_SUB: ARITH_LOOP(_mm256_sub_pd(x, y)); break;
+  case KERNEL_MUL: ARITH_LOOP(_mm256_mul_pd(x, y)); break;
+  case KERNEL_DIV: ARITH_LOOP(_mm256_div_pd(x, y)); break;
+  case KERNEL_POW: break; // There is no vector pow; the C loop does it.
+  }
+  return i;
+}
+
+// Compares four numbers at a time with `predicate` and stores one bool per
+// lane from the sign mask.
+#define COMPARE_LOOP(predicate)                                                                                                                                                                        \
+  for (; i + 4 <= n; i += 4) {                                                                                                                                                                         \
+    int mask = _mm256_movemask_pd(_mm256_cmp_pd(LOAD4(a, a_step, i), LOAD4(b, b_step, i), predicate));                                                                                               \
+    out[i] = mask & 1;                                                                                                                                                                                 \
+    out[i + 1] = (mask >> 1) & 1;                                                                                                                                                                      \
+    out[i + 2] = (mask >> 2) & 1;                                                                                                                                                                      \
+    out[i + 3] = (mask >> 3) & 1;                                                                                                                                                                      \
+  }
+
+__attribute__((target("avx2"))) static size_t avx2_compare(CompareKernel op, const double *a, size_t a_step, const double *b, size_t b_step, bool *out, size_t n) {
+  size_t i = 0;
+  switch (op) {
+  case KERNEL_EQ: COMPARE_LOOP(_CMP_EQ_OQ); break;
+  case KERNEL_NE: COMPARE_LOOP(_CMP_NEQ_UQ); break;
+  case KERNEL_LT: COMPARE_LOOP(_CMP_LT_OQ); break;
+  case KERNEL_LE: COMPARE_LOOP(_CMP_LE_OQ); break;
+  case KERNEL_GT: COMPARE_LOOP(_CMP_GT_OQ); break;
+  case KERNEL_GE: COMPARE_LOOP(_CMP_GE_OQ); break;
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static size_t avx2_has_zero(const double *a, size_t n, bool *found) {
+  __m256d zero = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    if (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + i), zero, _CMP_EQ_OQ))) {
+      *found = true;
+      return i;
+    }
+  }
+  *found = false;
+  return i;
+}
+#endif
+
+// Computes `out[i] = a[i * a_step] op b[i * b_step]` for `n` elements.
+void kernel_arith(ArithKernel op, const double *a, size_t a_step, const double *b, size_t b_step, double *out, size_t n) {
+  size_t done = 0;
+#ifdef HAVE_AVX2_KERNELS
+  if (has_avx2())
+    done = avx2_arith(op, a, a_step, b, b_step, out, n);
+#endif
+  scalar_arith(op, a, a_step, b, b_step, out, done, n);
+}
+
+// Computes `out[i] = a[i * a_step] op b[i * b_step]` for `n` elements.
+void kernel_compare(CompareKernel op, const double *a, size_t a_step, const double *b, size_t b_step, bool *out, size_t n) {
+  size_t done = 0;
+#ifdef HAVE_AVX2_KERNELS
+  if (has_avx2())
+    done = avx2_compare(op, a, a_step, b, b_step, out, n);
+#endif
+  scalar_compare(op, a, a_step, b, b_step, out, done, n);
+}
+
+// Checks whether any of `n` numbers is zero.
+bool kernel_has_zero(const double *a, size_t n) {
+  size_t done = 0;
+#ifdef HAVE_AVX2_KERNELS
+  bool found = false;
+  if (has_avx2())
+    done = avx2_has_zero(a, n, &found);
+  if (found)
+    return true;
+#endif
+  for (size_t i = done; i < n; i++)
+    if (a[i] == 0)
+      return true;
+  return false;
+}
@@ -0,0 +1,94 @@
+// eval/power.c
+// This file implements the exponentiation kernels. A constant exponent of 2
+// is one multiplication and 0.5 is a square root, both much cheaper than a
+// call to pow(). Integer powers are exact: they square on 64 bits while the
+// products fit and move to big integers when one overflows.
+
+#include "eval/power.h"
+#include "config.h"
+#include "eval/bigint.h"
+#include <math.h>
+#include <stdlib.h>
+
+/* raise a number to a whole exponent up to POW_CHAIN_LIMIT */
+double power_chain(double base, unsigned exponent) {
+  // Only a single product is rounded once, like pow(); longer chains drift
+  // from it, and then `x ** 13` and `x ** (12 + 1)` would disagree.
+  switch (exponent) {
+  case 0: return 1;
+  case 1: return base;
+  default: return base * base;
+  }
+}
+
+/* raise a number to the power 0.5 */
+double power_sqrt(double base) {
+  // pow() gives +0 for -0 and +inf for -inf, where sqrt() gives -0 and NaN.
+  if (base == -INFINITY)
+    return INFINITY;
+  return sqrt(base) + 0.0;
+}
+
+// Returns floor(log2(|value|)) of an integer value whose magnitude is at
+// least 2.
+static uint64_t integer_log2(Value value) {
+  if (value.value_type == VALUE_INTEGER) {
+    int64_t integer = value.integer_value;
+    uint64_t magnitude = integer < 0 ? 0 - (uint64_t)integer : (uint64_t)integer;
+    return 63 - (uint64_t)__builtin_clzll(magnitude);
+  }
+  const BigInt *bigint = value.bigint_value;
+  return (bigint->length - 1) * 32 + 31 - (uint64_t)__builtin_clz(bigint->limbs[bigint->length - 1]);
+}
+
+/* check whether an integer power stays a reasonable size */
+bool power_fits(Value base, uint64_t exponent) {
+  if (exponent == 0 || (base.value_type == VALUE_INTEGER && base.integer_value >= -1 && base.integer_value <= 1))
+    return true;
+  return exponent <= BIGINT_POW_LIMIT / integer_log2(base);
+}
+
+// Finishes `result * square ** exponent` on big integers, taking over both.
+static Value big_power(BigInt *result, BigInt *square, uint64_t exponent) {
+  while (exponent) {
+    if (exponent & 1) {
+      BigInt *product = bigint_mul(result, square);
+      free(result);
+      result = product;
+      if (--exponent == 0)
+        break;
+    }
+    BigInt *product = bigint_mul(square, square);
+    free(square);
+    square = product;
+    exponent >>= 1;
+  }
+  free(square);
+  return make_bigint(result);
+}
+
+/* raise an integer to a non-negative exponent exactly */
+Value power_integer(Value base, uint64_t exponent) {
+  if (base.value_type == VALUE_BIGINT)
+    return big_power(bigint_from_int64(1), bigint_copy(base.bigint_value), exponent);
+
+  // The answer is always result * square ** exponent, so an overflow can
+  // hand the remaining work to big integers as it is.
+  int64_t result = 1, square = base.integer_value, product;
+  while (exponent) {
+    if (exponent & 1) {
+      if (__builtin_mul_overflow(result, square, &product))
+        break;
+      result = product;
+      if (--exponent == 0)
+        break;
+    }
+    if (__builtin_mul_overflow(square, square, &product))
+      break;
+    square = product;
+    exponent >>= 1;
+  }
+  if (!exponent)
+    return make_integer(result);
+  return big_power(bigint_from_int64(result), bigint_from_int64(square), exponent);
+}
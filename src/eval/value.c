@@ -0,0 +1,391 @@
+// eval/value.c
+// This file implements runtime values: creating them from literals,
+// copying, comparing, printing and freeing them.
+
+#include "eval/value.h"
+#include "config.h"
+#include "eval/bigint.h"
+#include "eval/dict.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include "utils/strings.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Creates a null value.
+Value make_null(void) {
+  Value value;
+  value.value_type = VALUE_NULL;
+  value.number_value = 0;
+  return value;
+}
+
+// Creates a number value.
+Value make_number(double number) {
+  Value value;
+  value.value_type = VALUE_NUMBER;
+  value.number_value = number;
+  return value;
+}
+
+// Creates an integer value.
+Value make_integer(int64_t integer) {
+  Value value;
+  value.value_type = VALUE_INTEGER;
+  value.integer_value = integer;
+  return value;
+}
+
+// Creates an integer value from a big integer, which the value takes over.
+// A big integer that fits in 64 bits becomes a plain integer.
+Value make_bigint(BigInt *bigint) {
+  int64_t integer;
+  if (bigint_to_int64(bigint, &integer)) {
+    free(bigint);
+    return make_integer(integer);
+  }
+  Value value;
+  value.value_type = VALUE_BIGINT;
+  value.bigint_value = bigint;
+  return value;
+}
+
+// Creates a boolean value.
+Value make_boolean(bool boolean) {
+  Value value;
+  value.value_type = VALUE_BOOLEAN;
+  value.boolean_value = boolean;
+  return value;
+}
+
+// Creates a string value holding a copy of `length` bytes.
+Value make_string(const char *string, size_t length) {
+  Value value;
+  value.value_type = VALUE_STRING;
+  value.string_value = safe_malloc(length + 1);
+  if (length > 0)
+    memcpy(value.string_value, string, length);
+  value.string_value[length] = '\0';
+  value.string_length = length;
+  value.string_hash = 0;
+  return value;
+}
+
+// Returns the size of one packed list item.
+static size_t list_item_size(ValueType item_type) { return item_type == VALUE_BOOLEAN ? sizeof(bool) : sizeof(double); }
+
+// Creates a list value with room for `length` items of one type. The items
+// are left for the caller to fill in.
+Value make_list(ValueType item_type, size_t length) {
+  Value value;
+  value.value_type = VALUE_LIST;
+  value.list_type = item_type;
+  value.list_length = length;
+  value.list_items = safe_malloc(length ? length * list_item_size(item_type) : 1);
+  return value;
+}
+
+// Creates a dictionary value that owns `dict`.
+Value make_dict(Dict *dict) {
+  Value value;
+  value.value_type = VALUE_DICT;
+  value.dict_value = dict;
+  return value;
+}
+
+// Creates a range of `length` numbers from `start`, `step` apart.
+Value make_range(double start, double step, size_t length) {
+  Value value;
+  value.value_type = VALUE_RANGE;
+  value.range_start = start;
+  value.range_step = step;
+  value.range_length = length;
+  return value;
+}
+
+// Returns the number at `index` in a range.
+double range_item(Value range, size_t index) { return range.range_start + range.range_step * (double)index; }
+
+// Checks whether a value is a number of any kind.
+bool is_numeric(Value value) { return value.value_type == VALUE_NUMBER || value.value_type == VALUE_INTEGER || value.value_type == VALUE_BIGINT; }
+
+// Checks whether a value is an exact integer.
+bool is_integral(Value value) { return value.value_type == VALUE_INTEGER || value.value_type == VALUE_BIGINT; }
+
+// Returns the nearest double to a number of any kind.
+double number_to_double(Value value) {
+  switch (value.value_type) {
+  case VALUE_INTEGER: return (double)value.integer_value;
+  case VALUE_BIGINT: return bigint_to_double(value.bigint_value);
+  default: return value.number_value;
+  }
+}
+
+// Returns a new big integer holding an integer value.
+BigInt *value_to_bigint(Value value) {
+  if (value.value_type == VALUE_BIGINT)
+    return bigint_copy(value.bigint_value);
+  return bigint_from_int64(value.integer_value);
+}
+
+// Compares an integer with a double exactly, without rounding the integer.
+static int compare_integer_double(int64_t integer, double number) {
+  if (number >= 9223372036854775808.0)
+    return -1;
+  if (number < -9223372036854775808.0)
+    return 1;
+  int64_t whole = (int64_t)number;
+  if (integer != whole)
+    return integer < whole ? -1 : 1;
+  double fraction = number - (double)whole;
+  return (fraction < 0) - (fraction > 0);
+}
+
+// Compares a big integer with a double exactly.
+static int compare_bigint_double(const BigInt *bigint, double number) {
+  if (isinf(number))
+    return number > 0 ? -1 : 1;
+  double whole = floor(number);
+  BigInt *other = bigint_from_double(whole);
+  int order = bigint_compare(bigint, other);
+  free(other);
+  return order == 0 && number != whole ? -1 : order;
+}
+
+// Compares two numbers of any kinds exactly and stores -1, 0 or 1 in
+// `order`. Returns false if either is NaN, which is unordered.
+bool compare_numbers(Value left, Value right, int *order) {
+  if (left.value_type == VALUE_NUMBER && right.value_type == VALUE_NUMBER) {
+    double a = left.number_value, b = right.number_value;
+    *order = (a > b) - (a < b);
+    return !isnan(a) && !isnan(b);
+  }
+  if (left.value_type == VALUE_NUMBER) {
+    if (!compare_numbers(right, left, order))
+      return false;
+    *order = -*order;
+    return true;
+  }
+  if (right.value_type == VALUE_NUMBER) {
+    if (isnan(right.number_value))
+      return false;
+    if (left.value_type == VALUE_INTEGER)
+      *order = compare_integer_double(left.integer_value, right.number_value);
+    else
+      *order = compare_bigint_double(left.bigint_value, right.number_value);
+    return true;
+  }
+  if (left.value_type == VALUE_INTEGER && right.value_type == VALUE_INTEGER) {
+    *order = (left.integer_value > right.integer_value) - (left.integer_value < right.integer_value);
+    return true;
+  }
+  BigInt *a = value_to_bigint(left), *b = value_to_bigint(right);
+  *order = bigint_compare(a, b);
+  free(a);
+  free(b);
+  return true;
+}
+
+// Returns a deep copy of a value.
+Value copy_value(Value value) {
+  if (value.value_type == VALUE_STRING) {
+    Value copy = make_string(value.string_value, value.string_length);
+    copy.string_hash = value.string_hash;
+    return copy;
+  }
+  if (value.value_type == VALUE_LIST) {
+    Value copy = make_list(value.list_type, value.list_length);
+    memcpy(copy.list_items, value.list_items, value.list_length * list_item_size(value.list_type));
+    return copy;
+  }
+  if (value.value_type == VALUE_DICT)
+    return make_dict(dict_copy(value.dict_value));
+  if (value.value_type == VALUE_BIGINT) {
+    Value copy = value;
+    copy.bigint_value = bigint_copy(value.bigint_value);
+    return copy;
+  }
+  return value;
+}
+
+// Frees the memory owned by a value and resets it to null.
+void free_value(Value *value) {
+  if (!value)
+    return;
+  if (value->value_type == VALUE_STRING)
+    free(value->string_value);
+  else if (value->value_type == VALUE_LIST)
+    free(value->list_items);
+  else if (value->value_type == VALUE_DICT)
+    dict_free(value->dict_value);
+  else if (value->value_type == VALUE_BIGINT)
+    free(value->bigint_value);
+  *value = make_null();
+}
+
+// Returns the truthiness of a value for logical operators.
+bool is_truthy(Value value) {
+  switch (value.value_type) {
+  case VALUE_NUMBER: return value.number_value != 0;
+  case VALUE_INTEGER: return value.integer_value != 0;
+  case VALUE_BIGINT: return true;
+  case VALUE_BOOLEAN: return value.boolean_value;
+  case VALUE_STRING: return value.string_length > 0;
+  case VALUE_LIST: return value.list_length > 0;
+  case VALUE_DICT: return value.dict_value->count > 0;
+  case VALUE_RANGE: return value.range_length > 0;
+  case VALUE_NULL:
+  default: return false;
+  }
+}
+
+// Returns the hash of a string's bytes, computing it the first time and
+// keeping it in the value. Only dictionaries need it, so strings that are
+// never used as keys are never hashed.
+uint64_t string_hash(Value *string) {
+  if (!string->string_hash) {
+    uint64_t hash = hash_bytes(string->string_value, string->string_length);
+    // 0 marks a hash not computed yet.
+    string->string_hash = hash ? hash : 1;
+  }
+  return string->string_hash;
+}
+
+// Checks whether two strings hold the same bytes. Strings of different
+// lengths, or whose hashes are both known and differ, are told apart
+// without reading their bytes; others usually differ within the first
+// block memcmp() reads.
+bool strings_equal(Value left, Value right) {
+  if (left.string_length != right.string_length)
+    return false;
+  if (left.string_hash && right.string_hash && left.string_hash != right.string_hash)
+    return false;
+  return memcmp(left.string_value, right.string_value, left.string_length) == 0;
+}
+
+// Checks whether two values have the same type and contents. Numbers of
+// different kinds are equal when they have the same value.
+bool values_equal(Value left, Value right) {
+  if (is_numeric(left) && is_numeric(right)) {
+    int order;
+    return compare_numbers(left, right, &order) && order == 0;
+  }
+  if (left.value_type != right.value_type)
+    return false;
+  switch (left.value_type) {
+  case VALUE_BOOLEAN: return left.boolean_value == right.boolean_value;
+  case VALUE_STRING: return strings_equal(left, right);
+  case VALUE_LIST:
+    if (left.list_type != right.list_type || left.list_length != right.list_length)
+      return false;
+    for (size_t i = 0; i < left.list_length; i++) {
+      bool equal = left.list_type == VALUE_BOOLEAN ? ((bool *)left.list_items)[i] == ((bool *)right.list_items)[i] : ((double *)left.list_items)[i] == ((double *)right.list_items)[i];
+      if (!equal)
+        return false;
+    }
+    return true;
+  case VALUE_DICT: return dict_equal(left.dict_value, right.dict_value);
+  case VALUE_RANGE:
+    // Ranges are equal when they hold the same numbers.
+    if (left.range_length != right.range_length)
+      return false;
+    return left.range_length == 0 || (left.range_start == right.range_start && (left.range_length == 1 || left.range_step == right.range_step));
+  case VALUE_NULL:
+  default: return true;
+  }
+}
+
+// Converts a ValueType enum to its string representation for diagnostics.
+const char *value_type_to_string(ValueType type) {
+  switch (type) {
+  case VALUE_NUMBER: return "number";
+  case VALUE_INTEGER:
+  case VALUE_BIGINT: return "integer";
+  case VALUE_STRING: return "string";
+  case VALUE_BOOLEAN: return "boolean";
+  case VALUE_LIST: return "list";
+  case VALUE_DICT: return "dict";
+  case VALUE_RANGE: return "range";
+  case VALUE_NULL:
+  default: return "null";
+  }
+}
+
+// Prints a number with the shortest precision that reads back as the same
+// number.
+static void print_number(FILE *stream, double number) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.15g", number);
+  if (strtod(buf, NULL) != number)
+    snprintf(buf, sizeof(buf), "%.17g", number);
+  fputs(buf, stream);
+}
+
+// Prints a value inside a dictionary, where strings keep their quotes.
+static void print_item(FILE *stream, Value value) {
+  if (value.value_type != VALUE_STRING) {
+    print_value(stream, value);
+    return;
+  }
+  fputc('"', stream);
+  fwrite(value.string_value, 1, value.string_length, stream);
+  fputc('"', stream);
+}
+
+// Prints a value the way the REPL shows results.
+void print_value(FILE *stream, Value value) {
+  switch (value.value_type) {
+  case VALUE_NUMBER: print_number(stream, value.number_value); break;
+  case VALUE_INTEGER: fprintf(stream, "%" PRId64, value.integer_value); break;
+  case VALUE_BIGINT: {
+    char *digits = bigint_to_string(value.bigint_value);
+    fputs(digits, stream);
+    free(digits);
+    break;
+  }
+  case VALUE_STRING: fwrite(value.string_value, 1, value.string_length, stream); break;
+  case VALUE_BOOLEAN: fputs(value.boolean_value ? "true" : "false", stream); break;
+  case VALUE_LIST:
+    fputc('[', stream);
+    for (size_t i = 0; i < value.list_length; i++) {
+      if (i)
+        fputs(", ", stream);
+      if (value.list_type == VALUE_BOOLEAN)
+        fputs(((bool *)value.list_items)[i] ? "true" : "false", stream);
+      else
+        print_number(stream, ((double *)value.list_items)[i]);
+    }
+    fputc(']', stream);
+    break;
+  case VALUE_DICT:
+    fputc('{', stream);
+    for (size_t i = 0; i < value.dict_value->count; i++) {
+      if (i)
+        fputs(", ", stream);
+      print_item(stream, value.dict_value->entries[i].key);
+      fputs(": ", stream);
+      print_item(stream, value.dict_value->entries[i].value);
+    }
+    fputc('}', stream);
+    break;
+  case VALUE_RANGE:
+    // Long ranges show their first and last numbers only.
+    fputc('[', stream);
+    for (size_t i = 0; i < value.range_length; i++) {
+      if (value.range_length > RANGE_PRINT_LIMIT && i == 3) {
+        fputs(", ...", stream);
+        i = value.range_length - 1;
+      }
+      if (i)
+        fputs(", ", stream);
+      print_number(stream, range_item(value, i));
+    }
+    fputc(']', stream);
+    break;
+  case VALUE_NULL:
+  default: fputs("null", stream); break;
+  }
+}
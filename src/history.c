@@ -0,0 +1,329 @@
+// history.c
+// This file implements the REPL command history. Entries are kept in a
+// fixed-size ring (NOON_HISTORY_SIZE entries), so adding one never moves the
+// others. Startup only reads the tail of ~/.noon_history and every new entry
+// is appended to the file as it is entered. Reverse search uses an index
+// from each trigram to the entries that contain it, so a lookup only visits
+// entries that may match instead of scanning the whole history.
+
+#include "history.h"
+#include "config.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bytes read at a time while looking for the start of the tail of the file.
+#define HISTORY_BLOCK_SIZE 65536
+
+// Builds the path of the history file. Returns false if there is no home
+// directory or the path does not fit in `size` bytes.
+static bool history_path(char *path, size_t size) {
+  const char *home = getenv("HOME");
+  if (!home)
+    home = getenv("USERPROFILE"); // For Windows
+  if (!home)
+    return false;
+  // A truncated path would name some other file.
+  int length = snprintf(path, size, "%s/%s", home, HISTORY_FILE);
+  return length >= 0 && (size_t)length < size;
+}
+
+// Returns the maximum number of entries from the environment, or the default.
+static size_t history_capacity(void) {
+  const char *size = getenv(HISTORY_SIZE_ENV);
+  if (!size || !*size)
+    return HISTORY_SIZE;
+  char *end;
+  unsigned long long value = strtoull(size, &end, 10);
+  if (*end != '\0' || size[0] == '-')
+    return HISTORY_SIZE;
+  return (size_t)value;
+}
+
+// Packs three bytes into an index key. The extra bit keeps 0 free to mark
+// empty slots.
+static uint32_t trigram_at(const char *s) {
+  return (1u << 24) | ((uint32_t)(unsigned char)s[0] << 16) | ((uint32_t)(unsigned char)s[1] << 8) | (uint32_t)(unsigned char)s[2];
+}
+
+// Returns the index slot for a trigram: the slot holding it, or the empty
+// slot where it belongs.
+static HistoryGram *find_gram(const History *history, uint32_t trigram) {
+  if (!history->grams_capacity)
+    return NULL;
+  size_t mask = history->grams_capacity - 1;
+  size_t slot = (size_t)(trigram * 2654435761u) & mask;
+  while (history->grams[slot].trigram && history->grams[slot].trigram != trigram)
+    slot = (slot + 1) & mask;
+  return &history->grams[slot];
+}
+
+// Doubles the index once it is three quarters full.
+static void grow_grams(History *history) {
+  if (history->grams_capacity && (history->grams_count + 1) * 4 <= history->grams_capacity * 3)
+    return;
+  HistoryGram *old_grams = history->grams;
+  size_t old_capacity = history->grams_capacity;
+  history->grams_capacity = old_capacity ? old_capacity * 2 : 1024;
+  history->grams = safe_calloc(history->grams_capacity, sizeof(HistoryGram));
+  for (size_t i = 0; i < old_capacity; i++)
+    if (old_grams[i].trigram)
+      *find_gram(history, old_grams[i].trigram) = old_grams[i];
+  free(old_grams);
+}
+
+// Records that entry `id` contains every trigram of `line`.
+static void index_entry(History *history, const char *line, uint64_t id) {
+  size_t length = strlen(line);
+  for (size_t i = 0; i + 3 <= length; i++) {
+    uint32_t trigram = trigram_at(line + i);
+    grow_grams(history);
+    HistoryGram *gram = find_gram(history, trigram);
+    if (!gram->trigram) {
+      gram->trigram = trigram;
+      history->grams_count++;
+    }
+    // A trigram repeated within the line is indexed once.
+    if (gram->count > gram->head && gram->ids[gram->count - 1] == id)
+      continue;
+    if (gram->count == gram->capacity) {
+      gram->capacity = gram->capacity ? gram->capacity * 2 : 4;
+      gram->ids = safe_realloc(gram->ids, gram->capacity * sizeof(uint64_t));
+    }
+    gram->ids[gram->count++] = id;
+  }
+}
+
+// Drops the postings of an evicted entry. It is always the oldest one, so
+// its postings are at the front of their lists.
+static void unindex_entry(History *history, const char *line, uint64_t oldest) {
+  size_t length = strlen(line);
+  for (size_t i = 0; i + 3 <= length; i++) {
+    HistoryGram *gram = find_gram(history, trigram_at(line + i));
+    while (gram->head < gram->count && gram->ids[gram->head] < oldest)
+      gram->head++;
+    // Reclaim the dead prefix once it makes up half of the list.
+    if (gram->head == gram->count) {
+      gram->head = gram->count = 0;
+    } else if (gram->head >= INITIAL_CAPACITY && gram->head * 2 >= gram->count) {
+      memmove(gram->ids, gram->ids + gram->head, (gram->count - gram->head) * sizeof(uint64_t));
+      gram->count -= gram->head;
+      gram->head = 0;
+    }
+  }
+}
+
+// Adds an entry to the ring, evicting the oldest one when it is full.
+static void history_push(History *history, const char *line, size_t length) {
+  if (!history->capacity || length == 0 || length >= LINE_SIZE)
+    return;
+  size_t slot = (size_t)(history->next_id % history->capacity);
+  if (history->count == history->capacity) {
+    unindex_entry(history, history->items[slot], history->next_id - history->count + 1);
+    free(history->items[slot]);
+    history->count--;
+  }
+  char *entry = safe_malloc(length + 1);
+  memcpy(entry, line, length);
+  entry[length] = '\0';
+  history->items[slot] = entry;
+  index_entry(history, entry, history->next_id);
+  history->next_id++;
+  history->count++;
+}
+
+// Rewrites the history file with only its tail. The new file is written
+// next to the old one and renamed over it, so a failure keeps the old file.
+static void compact_history(const char *path, const char *tail, size_t size) {
+  debug_func("path: %s, size: %zu", path, size);
+  size_t length = strlen(path);
+  char *temp = safe_malloc(length + sizeof(".tmp"));
+  memcpy(temp, path, length);
+  memcpy(temp + length, ".tmp", sizeof(".tmp"));
+  FILE *fp = fopen(temp, "wb");
+  if (fp) {
+    bool ok = fwrite(tail, 1, size, fp) == size;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(temp, path) != 0)
+      remove(temp);
+  }
+  free(temp);
+}
+
+/* load REPL history from a file */
+void history_load(History *history) {
+  debug_func("");
+  history->loaded = true;
+  history->capacity = history_capacity();
+  if (!history->capacity)
+    return;
+  history->items = safe_calloc(history->capacity, sizeof(char *));
+
+  char path[1024];
+  if (!history_path(path, sizeof(path)))
+    return; // Cannot find home directory
+  FILE *fp = fopen(path, "rb");
+  if (!fp)
+    return; // File doesn't exist or cannot be opened, which is fine
+  if (fseek(fp, 0, SEEK_END) != 0) {
+    fclose(fp);
+    return;
+  }
+  long end = ftell(fp);
+  if (end <= 0) {
+    fclose(fp);
+    return;
+  }
+  size_t size = (size_t)end;
+
+  // Walk back from the end until the last `capacity` lines are covered. A
+  // final newline ends the last line, it doesn't start a new one.
+  char *block = safe_malloc(HISTORY_BLOCK_SIZE);
+  size_t start = 0;
+  size_t newlines = 0;
+  size_t wanted = history->capacity;
+  size_t offset = size;
+  bool found = false;
+  while (offset > 0 && !found) {
+    size_t step = offset < HISTORY_BLOCK_SIZE ? offset : HISTORY_BLOCK_SIZE;
+    offset -= step;
+    if (fseek(fp, (long)offset, SEEK_SET) != 0 || fread(block, 1, step, fp) != step)
+      break;
+    for (size_t i = step; i-- > 0;) {
+      if (block[i] != '\n')
+        continue;
+      if (offset + i == size - 1)
+        continue;
+      if (++newlines == wanted) {
+        start = offset + i + 1;
+        found = true;
+        break;
+      }
+    }
+  }
+  free(block);
+
+  // Read the tail and add its lines in order.
+  size_t tail_size = size - start;
+  char *tail = safe_malloc(tail_size + 1);
+  if (fseek(fp, (long)start, SEEK_SET) != 0 || fread(tail, 1, tail_size, fp) != tail_size) {
+    free(tail);
+    fclose(fp);
+    return;
+  }
+  fclose(fp);
+  const char *line = tail;
+  const char *tail_end = tail + tail_size;
+  while (line < tail_end) {
+    const char *newline = memchr(line, '\n', (size_t)(tail_end - line));
+    const char *line_end = newline ? newline : tail_end;
+    size_t length = (size_t)(line_end - line);
+    if (length > 0 && line[length - 1] == '\r')
+      length--;
+    history_push(history, line, length);
+    line = newline ? newline + 1 : tail_end;
+  }
+
+  // Appending keeps the file growing; drop the old part once it outweighs
+  // the part that is still loaded.
+  if (start > tail_size)
+    compact_history(path, tail, tail_size);
+  free(tail);
+}
+
+/* add user input to REPL history */
+void history_add(History *history, const char *line) {
+  // debug_func("line: %s", line);
+  if (!line || *line == '\0')
+    return;
+  size_t length = strnlen(line, LINE_SIZE);
+  if (!history->capacity || length >= LINE_SIZE)
+    return;
+  history_push(history, line, length);
+
+  // Append the entry right away, so nothing is lost if the REPL is killed.
+  if (!history->file) {
+    char path[1024];
+    if (!history_path(path, sizeof(path)))
+      return;
+    history->file = fopen(path, "a");
+    if (!history->file)
+      return;
+  }
+  fwrite(line, 1, length, history->file);
+  fputc('\n', history->file);
+  fflush(history->file);
+}
+
+/* get an entry counting back from the newest one */
+const char *history_get(const History *history, size_t back) {
+  if (back == 0 || back > history->count)
+    return NULL;
+  return history->items[(history->next_id - back) % history->capacity];
+}
+
+/* find the newest entry at or before `*back` that contains `query` */
+bool history_search(const History *history, const char *query, size_t *back) {
+  debug_func("query: %s, back: %zu", query, *back);
+  if (*back == 0 || *back > history->count)
+    return false;
+  size_t length = strlen(query);
+  uint64_t newest = history->next_id - *back;
+  uint64_t oldest = history->next_id - history->count;
+
+  // Short queries have no trigram to look up; they match almost anything,
+  // so a scan stops early.
+  if (length < 3) {
+    for (uint64_t id = newest + 1; id-- > oldest;) {
+      if (strstr(history->items[id % history->capacity], query)) {
+        *back = (size_t)(history->next_id - id);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Only entries in the shortest posting list of the query's trigrams can
+  // match. Check them from the newest one back.
+  const HistoryGram *best = NULL;
+  for (size_t i = 0; i + 3 <= length; i++) {
+    const HistoryGram *gram = find_gram(history, trigram_at(query + i));
+    if (!gram || !gram->trigram || gram->head == gram->count)
+      return false;
+    if (!best || gram->count - gram->head < best->count - best->head)
+      best = gram;
+  }
+  size_t low = best->head, high = best->count;
+  while (low < high) { // first posting newer than `newest`
+    size_t middle = low + (high - low) / 2;
+    if (best->ids[middle] <= newest)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  for (size_t i = low; i-- > best->head;) {
+    uint64_t id = best->ids[i];
+    if (strstr(history->items[id % history->capacity], query)) {
+      *back = (size_t)(history->next_id - id);
+      return true;
+    }
+  }
+  return false;
+}
+
+/* free the history entries and index */
+void history_free(History *history) {
+  if (history->items) {
+    for (size_t i = 0; i < history->capacity; i++)
+      free(history->items[i]);
+    free(history->items);
+  }
+  for (size_t i = 0; i < history->grams_capacity; i++)
+    free(history->grams[i].ids);
+  free(history->grams);
+  if (history->file)
+    fclose(history->file);
+  *history = (History){0};
+}
@@ -12,6 +12,7 @@
 #include "parser/parser.h"
 #include "utils/log.h"
 #include "utils/memory.h"
+#include "utils/utf8.h"
 #include <ctype.h>
 #include <math.h>
 #include <signal.h>
@@ -28,89 +29,78 @@
 #include <unistd.h>
 #endif
 
-// Global pointer to the input state.
-NoonInput *ni = NULL;
+// Pointer to the input state used by the current thread.
+_Thread_local NoonInput *ni = NULL;
 
-/* initialize the global input state */
-void init_input(void) {
-  ni = safe_malloc(sizeof(NoonInput));
+/* allocate a new input state with default options */
+NoonInput *create_input(void) {
+  NoonInput *input = safe_malloc(sizeof(NoonInput));
   // Input
-  ni->program_name = "";
-  ni->is_repl = 0;
-  ni->file = NULL;
-  ni->input = "<stdin>";
+  input->program_name = "";
+  input->is_repl = 0;
+  input->file = NULL;
+  input->reader = (LineReader){0};
+  input->reader.fd = -1;
+  input->input = "<stdin>";
   // Options
-  ni->debug = 0;
-  ni->dump_tokens = 0;
-  ni->dump_ast = 0;
-  ni->check_syntax = 0;
-  // Repl history
-  ni->history = (History){NULL, 0};
+  input->debug = 0;
+  input->dump_tokens = 0;
+  input->dump_ast = 0;
+  input->check_syntax = 0;
+  input->use_cache = 0;
+  input->collect_logs = 0;
+  input->diagnostics_format = DIAGNOSTICS_TEXT;
+  input->max_errors = 0;
+  input->stream = 0;
+  input->stats = STATS_NONE;
+  // Output streams
+  input->out_stream = stdout;
+  input->log_stream = stderr;
+  // Repl history and line editor
+  input->history = (History){0};
+  input->editor = (LineEditor){0};
+  return input;
+}
+
+/* close the input file and free the input state with its history */
+void destroy_input(NoonInput *input) {
+  if (!input)
+    return;
+  // Close the input file if it's not stdin.
+  if (input->file && input->file != stdin)
+    fclose(input->file);
+  reader_free(&input->reader);
+  history_free(&input->history);
+  free(input->editor.text);
+  free(input->editor.output);
+  free(input->editor.paste);
+  free(input);
+}
 
+/* initialize the input state of the current thread */
+void init_input(void) {
+  ni = create_input();
   debug_func("");
 }
 
-/* protect repl columns for prompt text:
-   - ">>> " for normal input
-   - "... " for multiline input */
-enum { PROTECT_COLS = 4 };
+/* key codes returned by read_key besides plain bytes */
+enum {
+  KEY_LEFT = 1000,
+  KEY_RIGHT,
+  KEY_UP,
+  KEY_DOWN,
+  KEY_HOME,
+  KEY_END,
+  KEY_DELETE,
+  KEY_PASTE, /* start of a bracketed paste */
+};
 
 /* forward declarations for raw input mode setup */
 static void enable_raw(void);
 static void disable_raw(void);
 
-/* forward declarations for history file operations */
-static void history_load(void);
 /* history */
 
-/* add user input to REPL history */
-static void history_add(const char *s) {
-  // debug_func("s: %s",s);
-  // The check for ni->is_repl is removed because this function is only
-  // called from within the REPL-specific part of portable_getline.
-  if (!s || *s == '\0')
-    return;
-
-  // check string length and validity
-  size_t len = strnlen(s, 1024);
-  if (len == 0 || len >= 1024)
-    return;
-
-  // duplicate string and store it
-  char *dup = safe_strdup(s);
-  char **tmp = safe_realloc(ni->history.items, (ni->history.count + 1) * sizeof(char *));
-  ni->history.items = tmp;
-  ni->history.items[ni->history.count++] = dup;
-}
-
-/* load REPL history from a file */
-static void history_load(void) {
-  const char *home = getenv("HOME");
-  if (!home) {
-    home = getenv("USERPROFILE"); // For Windows
-  }
-  if (!home) {
-    return; // Cannot find home directory
-  }
-
-  char path[1024];
-  snprintf(path, sizeof(path), "%s/.noon_history", home);
-
-  FILE *fp = fopen(path, "r");
-  if (!fp) {
-    return; // File doesn't exist or cannot be opened, which is fine
-  }
-
-  char line_buf[2048]; // Max line length for history
-  while (fgets(line_buf, sizeof(line_buf), fp)) {
-    // Remove trailing newline character(s)
-    line_buf[strcspn(line_buf, "\r\n")] = 0;
-    history_add(line_buf);
-  }
-
-  fclose(fp);
-}
-
 /* get previous history entry */
 static const char *history_up(size_t *idx) {
   debug_func("idx: %zu", *idx);
@@ -120,7 +110,7 @@ static const char *history_up(size_t *idx) {
     return NULL;
   if (*idx < ni->history.count)
     (*idx)++;
-  const char *result = ni->history.items[ni->history.count - *idx];
+  const char *result = history_get(&ni->history, *idx);
   return result ? result : "";
 }
 
@@ -134,14 +124,16 @@ static const char *history_down(size_t *idx) {
   (*idx)--;
   if (*idx == 0)
     return "";
-  const char *result = ni->history.items[ni->history.count - *idx];
+  const char *result = history_get(&ni->history, *idx);
   return result ? result : "";
 }
 
 /* platform raw + key read */
 #ifdef _WIN32
 static DWORD win_orig_mode;
+static DWORD win_orig_out_mode;
 static HANDLE win_hin = NULL;
+static HANDLE win_hout = NULL;
 static int win_raw = 0;
 
 /* disable raw input mode on Windows */
@@ -151,6 +143,7 @@ static void disable_raw(void) {
     return; // skip if not in REPL mode
   if (win_raw && win_hin) {
     SetConsoleMode(win_hin, win_orig_mode);
+    SetConsoleMode(win_hout, win_orig_out_mode);
     win_raw = 0;
   }
 }
@@ -163,10 +156,14 @@ static void enable_raw(void) {
   if (win_raw)
     return;
   win_hin = GetStdHandle(STD_INPUT_HANDLE);
+  win_hout = GetStdHandle(STD_OUTPUT_HANDLE);
   if (GetConsoleMode(win_hin, &win_orig_mode)) {
     DWORD m = win_orig_mode;
     m &= ~(ENABLE_LINE_INPUT | ENABLE_ECHO_INPUT);
     SetConsoleMode(win_hin, m);
+    // The editor repaints with VT escape sequences.
+    if (GetConsoleMode(win_hout, &win_orig_out_mode))
+      SetConsoleMode(win_hout, win_orig_out_mode | 0x0004 /* ENABLE_VIRTUAL_TERMINAL_PROCESSING */);
     atexit(disable_raw);
     win_raw = 1;
   }
@@ -181,22 +178,22 @@ static int read_key(void) {
   DWORD read;
   while (1) {
     if (!ReadConsoleInput(win_hin, &rec, 1, &read))
-      continue;
+      return 4; // input closed, same as Ctrl-D
     if (rec.EventType != KEY_EVENT)
       continue;
     KEY_EVENT_RECORD k = rec.Event.KeyEvent;
     if (!k.bKeyDown)
       continue;
     switch (k.wVirtualKeyCode) {
-    case VK_LEFT: return 'L';
-    case VK_RIGHT: return 'R';
-    case VK_UP: return 'U';
-    case VK_DOWN: return 'D';
-    case VK_HOME: return 'H';
-    case VK_END: return 'E';
+    case VK_LEFT: return KEY_LEFT;
+    case VK_RIGHT: return KEY_RIGHT;
+    case VK_UP: return KEY_UP;
+    case VK_DOWN: return KEY_DOWN;
+    case VK_HOME: return KEY_HOME;
+    case VK_END: return KEY_END;
     case VK_RETURN: return '\n';
     case VK_BACK: return 127;
-    case VK_DELETE: return 127;
+    case VK_DELETE: return KEY_DELETE;
     default:
       if (k.uChar.AsciiChar) {
         unsigned char ch = (unsigned char)k.uChar.AsciiChar;
@@ -211,12 +208,20 @@ static int read_key(void) {
 static struct termios orig_term;
 static int unix_raw = 0;
 
+/* bracketed paste makes the terminal wrap pasted text in ESC[200~ and
+   ESC[201~, so it can be inserted at once instead of key by key */
+#define PASTE_ON "\x1b[?2004h"
+#define PASTE_OFF "\x1b[?2004l"
+#define PASTE_END "\x1b[201~"
+
 /* disable raw input mode on Unix */
 static void disable_raw(void) {
   // debug_func("");
   if (!ni->is_repl)
     return; // skip if not in REPL mode
   if (unix_raw) {
+    fputs(PASTE_OFF, stdout);
+    fflush(stdout);
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_term);
     unix_raw = 0;
   }
@@ -235,6 +240,7 @@ static void enable_raw(void) {
     raw.c_cc[VMIN] = 1;
     raw.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+    fputs(PASTE_ON, stdout);
     atexit(disable_raw);
     unix_raw = 1;
   }
@@ -246,119 +252,297 @@ static int read_key(void) {
   if (!ni->is_repl)
     return 0; // skip if not in REPL mode
   int c = getchar();
-  if (c == 4)
-    return 4;      /* Ctrl-D */
+  if (c == 4 || c == EOF)
+    return 4;      /* Ctrl-D, or the end of piped input */
   if (c == 0x1b) { /* escape */
     int c2 = getchar();
     if (c2 == '[') {
       int c3 = getchar();
       if (c3 >= '0' && c3 <= '9') {
-        int c4 = getchar(); /* expect ~ */
-        if (c4 == '~') {
-          switch (c3) {
-          case '1':
-          case '7': return 'H';
-          case '4':
-          case '8': return 'E';
-          case '3': return 127;
-          default: return 0;
-          }
+        int number = 0;
+        while (c3 >= '0' && c3 <= '9' && number < 1000) {
+          number = number * 10 + (c3 - '0');
+          c3 = getchar();
+        }
+        if (c3 != '~') /* expect ~ */
+          return 0;
+        switch (number) {
+        case 1:
+        case 7: return KEY_HOME;
+        case 4:
+        case 8: return KEY_END;
+        case 3: return KEY_DELETE;
+        case 200: return KEY_PASTE;
+        default: return 0;
         }
-        return 0;
       } else {
         switch (c3) {
-        case 'A': return 'U';
-        case 'B': return 'D';
-        case 'C': return 'R';
-        case 'D': return 'L';
-        case 'H': return 'H';
-        case 'F': return 'E';
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'C': return KEY_RIGHT;
+        case 'D': return KEY_LEFT;
+        case 'H': return KEY_HOME;
+        case 'F': return KEY_END;
         default: return 0;
         }
       }
     } else if (c2 == 'O') {
       int c3 = getchar();
       if (c3 == 'H')
-        return 'H';
+        return KEY_HOME;
       if (c3 == 'F')
-        return 'E';
+        return KEY_END;
       return 0;
     }
     return 0;
   }
+  if (c == 8)
+    return 127; /* Ctrl-H is backspace on some terminals */
   return c;
 }
+
+/* read the rest of a bracketed paste into the pending paste buffer */
+static void read_paste(LineEditor *editor) {
+  debug_func("");
+  size_t end_length = strlen(PASTE_END);
+  int c;
+  while ((c = getchar()) != EOF) {
+    if (editor->paste_size == editor->paste_capacity) {
+      editor->paste_capacity = editor->paste_capacity ? editor->paste_capacity * 2 : LINE_SIZE;
+      editor->paste = safe_realloc(editor->paste, editor->paste_capacity);
+    }
+    editor->paste[editor->paste_size++] = (char)c;
+    if (c == '~' && editor->paste_size - editor->paste_offset >= end_length &&
+        memcmp(editor->paste + editor->paste_size - end_length, PASTE_END, end_length) == 0) {
+      editor->paste_size -= end_length;
+      break;
+    }
+  }
+}
 #endif
 
-/* cursor movement and line redraw functions */
+/* gap buffer */
 
-/* move cursor left n times */
-static void move_left_stdout(size_t count) {
-  // debug_func("count: %zu", count);
-  if (!ni->is_repl)
-    return; // skip if not in REPL mode
-  while (count--)
-    putchar('\b');
+/* number of bytes in the line */
+static size_t line_length(const LineEditor *editor) { return editor->capacity - (editor->gap_end - editor->gap_start); }
+
+/* make room for `extra` more bytes in the gap */
+static void reserve_gap(LineEditor *editor, size_t extra) {
+  if (editor->gap_end - editor->gap_start >= extra)
+    return;
+  size_t after = editor->capacity - editor->gap_end;
+  size_t capacity = editor->capacity ? editor->capacity * 2 : 64;
+  while (capacity - line_length(editor) < extra)
+    capacity *= 2;
+  editor->text = safe_realloc(editor->text, capacity);
+  memmove(editor->text + capacity - after, editor->text + editor->gap_end, after);
+  editor->gap_end = capacity - after;
+  editor->capacity = capacity;
 }
 
-/* redraw user line after modification */
-static void render_replace(const char *buf, size_t len, size_t cursor, size_t *displayed_len, size_t *displayed_cursor) {
-  // debug_func("buf: %s, len: %zu, cursor: %zu, displayed_len: %zu, displayed_cursor: %zu", buf, len, cursor, *displayed_len, *displayed_cursor);
-  if (!ni->is_repl)
-    return; // skip if not in REPL mode
-  if (*displayed_cursor > 0)
-    move_left_stdout(*displayed_cursor);
-  if (len > 0)
-    fwrite(buf, 1, len, stdout);
-  if (*displayed_len > len) {
-    size_t extra = *displayed_len - len;
-    for (size_t i = 0; i < extra; i++)
-      putchar(' ');
-    for (size_t i = 0; i < extra; i++)
-      putchar('\b');
+/* move the gap, and with it the cursor, to `position` */
+static void move_gap(LineEditor *editor, size_t position) {
+  if (position < editor->gap_start) {
+    size_t count = editor->gap_start - position;
+    memmove(editor->text + editor->gap_end - count, editor->text + position, count);
+    editor->gap_start -= count;
+    editor->gap_end -= count;
+  } else if (position > editor->gap_start) {
+    size_t count = position - editor->gap_start;
+    memmove(editor->text + editor->gap_start, editor->text + editor->gap_end, count);
+    editor->gap_start += count;
+    editor->gap_end += count;
   }
-  if (len > cursor) {
-    size_t back = len - cursor;
-    for (size_t i = 0; i < back; i++)
-      putchar('\b');
+}
+
+/* number of bytes of the character before the cursor */
+static size_t char_before(const LineEditor *editor) {
+  size_t length = 1;
+  while (length < editor->gap_start && ((unsigned char)editor->text[editor->gap_start - length] & 0xc0) == 0x80)
+    length++;
+  return length;
+}
+
+/* number of bytes of the character after the cursor */
+static size_t char_after(const LineEditor *editor) {
+  size_t length = 1;
+  while (editor->gap_end + length < editor->capacity && ((unsigned char)editor->text[editor->gap_end + length] & 0xc0) == 0x80)
+    length++;
+  return length;
+}
+
+/* replace the whole line with `text` and put the cursor at its end */
+static void set_line(LineEditor *editor, const char *text, size_t length) {
+  editor->gap_start = 0;
+  editor->gap_end = editor->capacity;
+  reserve_gap(editor, length + 1);
+  memcpy(editor->text, text, length);
+  editor->gap_start = length;
+}
+
+/* terminal output */
+
+/* queue bytes for the terminal */
+static void queue_output(LineEditor *editor, const char *text, size_t length) {
+  if (editor->output_size + length > editor->output_capacity) {
+    size_t capacity = editor->output_capacity ? editor->output_capacity * 2 : LINE_SIZE;
+    while (capacity < editor->output_size + length)
+      capacity *= 2;
+    editor->output = safe_realloc(editor->output, capacity);
+    editor->output_capacity = capacity;
   }
-  fflush(stdout);
-  *displayed_len = len;
-  *displayed_cursor = cursor;
+  memcpy(editor->output + editor->output_size, text, length);
+  editor->output_size += length;
 }
 
-/* print new char and update display */
-static void render_insert_char(char ch, const char *tail, size_t tail_len, size_t insert_pos, size_t *displayed_len, size_t *displayed_cursor) {
-  // debug_func("ch: %c, tail: %s, tail_len: %zu, insert_pos: %zu, displayed_len: %zu, displayed_cursor: %zu", ch, tail , tail_len, insert_pos, *displayed_len, *displayed_cursor);
-  if (!ni->is_repl)
-    return; // skip if not in REPL mode
-  (void)insert_pos;
-  putchar(ch);
-  if (tail_len > 0)
-    fwrite(tail, 1, tail_len, stdout);
-  for (size_t i = 0; i < tail_len; i++)
-    putchar('\b');
-  fflush(stdout);
-  (*displayed_len)++;
-  (*displayed_cursor)++;
+/* queue a cursor movement or insertion escape sequence with a count */
+static void queue_escape(LineEditor *editor, size_t count, char command) {
+  char sequence[32];
+  int length = snprintf(sequence, sizeof(sequence), "\x1b[%zu%c", count, command);
+  queue_output(editor, sequence, (size_t)length);
 }
 
-/* delete char before cursor and update display */
-static void render_delete_before(const char *tail, size_t tail_len, size_t *displayed_len, size_t *displayed_cursor) {
-  // debug_func("tail: %s, tail_len: %zu, displayed_len: %zu, displayed_cursor: %zu", tail , tail_len, *displayed_len, *displayed_cursor);
-  if (!ni->is_repl)
-    return; // skip if not in REPL mode
-  putchar('\b');
-  if (tail_len > 0)
-    fwrite(tail, 1, tail_len, stdout);
-  putchar(' ');
-  for (size_t i = 0; i < tail_len + 1; i++)
-    putchar('\b');
+/* write everything queued for one keystroke with a single call */
+static void flush_output(LineEditor *editor) {
+  if (editor->output_size == 0)
+    return;
+  fflush(stdout); // keep the order of anything printed through stdio
+#ifdef _WIN32
+  fwrite(editor->output, 1, editor->output_size, stdout);
   fflush(stdout);
-  if (*displayed_len > 0)
-    (*displayed_len)--;
-  if (*displayed_cursor > 0)
-    (*displayed_cursor)--;
+#else
+  size_t written = 0;
+  while (written < editor->output_size) {
+    ssize_t count = write(STDOUT_FILENO, editor->output + written, editor->output_size - written);
+    if (count <= 0)
+      break;
+    written += (size_t)count;
+  }
+#endif
+  editor->output_size = 0;
+}
+
+/* prompt the REPL printed before the line being edited */
+static const char *current_prompt(void) {
+  if (ctx && (ctx->state != STATE_NORMAL || ctx->bracket_stack_size != 0))
+    return "... ";
+  return ">>> ";
+}
+
+/* repaint the whole terminal line as prompt + line and restore the cursor */
+static void repaint_line(LineEditor *editor, const char *prompt) {
+  size_t after = editor->capacity - editor->gap_end;
+  queue_output(editor, "\r", 1);
+  queue_output(editor, prompt, strlen(prompt));
+  queue_output(editor, editor->text, editor->gap_start);
+  queue_output(editor, editor->text + editor->gap_end, after);
+  queue_output(editor, "\x1b[K", 3);
+  size_t width = utf8_width(editor->text + editor->gap_end, after);
+  if (width > 0)
+    queue_escape(editor, width, 'D');
+}
+
+/* insert text at the cursor; the terminal shifts the rest of the line, so
+   the echo does not depend on the line length */
+static void insert_text(LineEditor *editor, const char *text, size_t length) {
+  reserve_gap(editor, length + 1);
+  size_t inserted = 0;
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)text[i];
+    if ((c < 32 && c != '\t') || c == 127)
+      continue; // control characters have no place in a line
+    editor->text[editor->gap_start + inserted++] = (char)c;
+  }
+  if (inserted == 0)
+    return;
+  if (editor->gap_end < editor->capacity)
+    queue_escape(editor, utf8_width(editor->text + editor->gap_start, inserted), '@');
+  queue_output(editor, editor->text + editor->gap_start, inserted);
+  editor->gap_start += inserted;
+}
+
+/* insert pending pasted text up to the next line break. Returns true if
+   the paste ends the line. */
+static bool insert_paste(LineEditor *editor) {
+  const char *start = editor->paste + editor->paste_offset;
+  const char *end = editor->paste + editor->paste_size;
+  const char *p = start;
+  while (p < end && *p != '\n' && *p != '\r')
+    p++;
+  insert_text(editor, start, (size_t)(p - start));
+  bool line_break = p < end;
+  if (line_break) {
+    if (*p == '\r' && p + 1 < end && p[1] == '\n')
+      p++;
+    p++;
+  }
+  editor->paste_offset = (size_t)(p - editor->paste);
+  if (editor->paste_offset == editor->paste_size)
+    editor->paste_offset = editor->paste_size = 0;
+  return line_break;
+}
+
+/* incremental reverse history search (Ctrl-R). Typing narrows the search,
+   Ctrl-R again finds an older match and Ctrl-G restores the original line.
+   Any other key accepts the match into the line and is returned so the
+   caller can handle it; 0 means there is nothing left to handle. */
+static int search_history(LineEditor *editor) {
+  debug_func("length: %zu", line_length(editor));
+  char query[LINE_SIZE] = "";
+  char prefix[LINE_SIZE + 32];
+  size_t query_len = 0;
+  size_t match_back = 0;
+  const char *match = "";
+  bool failed = false;
+  int k;
+
+  while (1) {
+    int length = snprintf(prefix, sizeof(prefix), "\r(%sreverse-i-search)`%s': ", failed ? "failed " : "", query);
+    queue_output(editor, prefix, (size_t)length);
+    queue_output(editor, match, strlen(match));
+    queue_output(editor, "\x1b[K", 3);
+    flush_output(editor);
+    k = read_key();
+    if (k == 18) { /* Ctrl-R: next older match */
+      size_t back = match_back + 1;
+      if (query_len > 0 && match_back > 0 && history_search(&ni->history, query, &back)) {
+        match_back = back;
+        match = history_get(&ni->history, back);
+      } else if (query_len > 0) {
+        failed = true;
+      }
+      continue;
+    }
+    if (k == 127 || (k >= 32 && k <= 126)) { /* edit the query */
+      if (k == 127) {
+        if (query_len == 0)
+          continue;
+        query[--query_len] = '\0';
+      } else if (query_len + 1 < sizeof(query)) {
+        query[query_len++] = (char)k;
+        query[query_len] = '\0';
+      }
+      // The current match may still contain a longer query, so typing only
+      // moves back in time; deleting starts again from the newest entry.
+      size_t back = (k == 127 || match_back == 0) ? 1 : match_back;
+      failed = !history_search(&ni->history, query, &back);
+      if (!failed) {
+        match_back = back;
+        match = history_get(&ni->history, back);
+      }
+      continue;
+    }
+    if (k == 7) { /* Ctrl-G: cancel */
+      k = 0;
+      break;
+    }
+    if (match_back > 0)
+      set_line(editor, match, strlen(match));
+    break;
+  }
+
+  repaint_line(editor, current_prompt());
+  return k;
 }
 
 /* our custom getline version that works on all systems and supports REPL
@@ -406,159 +590,134 @@ ssize_t portable_getline(char **lineptr, size_t *n, FILE *stream) {
   }
 
   /* REPL mode with editing and history */
-  static bool history_initialized = false;
-  if (!history_initialized) {
-    history_load();
-    history_initialized = true;
-  }
+  if (!ni->history.loaded)
+    history_load(&ni->history);
 
   enable_raw();
   fflush(stdout);
 
-  size_t cap = (*n && *lineptr) ? *n : 64;
-  int allocated_here = 0;
-  char *buf = *lineptr ? *lineptr : safe_malloc(cap), *tmp;
-  if (!*lineptr)
-    allocated_here = 1;
-
-  if (allocated_here)
-    buf[0] = '\0';
-
-  size_t len = 0;
-  size_t cursor = 0;
+  LineEditor *editor = &ni->editor;
+  set_line(editor, "", 0);
   size_t hist_idx = 0;
   const char *hist_line = NULL;
-  size_t displayed_len = 0;
-  size_t displayed_cursor = 0;
+  int pending = -1; /* key read past an incomplete UTF-8 character */
 
-  while (1) {
-    int k = read_key();
-    if (k == 4) { /* Ctrl-D -> EOF */
-      disable_raw();
-      if (allocated_here)
-        free(buf);
-      return -1;
-    }
-    if (k == '\n') {
-      putchar('\n');
-      fflush(stdout);
-      if (len > 0)
-        history_add(buf);
-      hist_idx = 0;
-      buf[len] = '\0';
-      *lineptr = buf;
-      *n = cap;
-      disable_raw();
-      return (ssize_t)len;
-    }
+  // A paste that spanned several lines fills the following ones first.
+  bool done = editor->paste_size > 0 && insert_paste(editor);
 
-    if (k == 127) { /* backspace */
-      if (cursor > 0) {
-        memmove(buf + cursor - 1, buf + cursor, len - cursor + 1);
-        render_delete_before(buf + cursor - 1, len - cursor, &displayed_len, &displayed_cursor);
-        cursor--;
-        len--;
-        buf[len] = '\0';
-      }
-      continue;
+  while (!done) {
+    flush_output(editor);
+    int k = pending >= 0 ? pending : read_key();
+    pending = -1;
+    if (k == 18) { /* Ctrl-R: reverse history search */
+      k = search_history(editor);
+      hist_idx = 0;
+      if (k == 0)
+        continue;
     }
-    if (k == 'L') { /* left */
-      if (cursor > 0) {
-        if (cursor > 0) {
-          putchar('\b');
-          fflush(stdout);
-          cursor--;
-          if (displayed_cursor > 0)
-            displayed_cursor--;
+    switch (k) {
+    case 4: /* Ctrl-D -> EOF */
+      flush_output(editor);
+      disable_raw();
+      return -1;
+    case '\n': done = true; break;
+    case 127: /* backspace */
+      if (editor->gap_start > 0) {
+        size_t length = char_before(editor);
+        size_t width = utf8_width(editor->text + editor->gap_start - length, length);
+        editor->gap_start -= length;
+        if (width > 0) {
+          queue_escape(editor, width, 'D');
+          queue_escape(editor, width, 'P');
         }
       }
-      continue;
-    }
-    if (k == 'R') { /* right */
-      if (cursor < len) {
-        putchar(buf[cursor]);
-        cursor++;
-        if (displayed_cursor < displayed_len)
-          displayed_cursor++;
-        fflush(stdout);
+      break;
+    case KEY_DELETE:
+      if (editor->gap_end < editor->capacity) {
+        size_t length = char_after(editor);
+        size_t width = utf8_width(editor->text + editor->gap_end, length);
+        editor->gap_end += length;
+        if (width > 0)
+          queue_escape(editor, width, 'P');
       }
-      continue;
-    }
-    if (k == 'H') { /* Home key */
-      if (displayed_cursor > 0)
-        move_left_stdout(displayed_cursor);
-      cursor = 0;
-      displayed_cursor = 0;
-      continue;
-    }
-    if (k == 'E') { /* End key */
-      size_t toprint = len - cursor;
-      if (toprint > 0) {
-        fwrite(buf + cursor, 1, toprint, stdout);
-        fflush(stdout);
+      break;
+    case KEY_LEFT:
+      if (editor->gap_start > 0) {
+        size_t length = char_before(editor);
+        size_t width = utf8_width(editor->text + editor->gap_start - length, length);
+        move_gap(editor, editor->gap_start - length);
+        if (width > 0)
+          queue_escape(editor, width, 'D');
       }
-      cursor = len;
-      displayed_cursor = displayed_len = len;
-      continue;
-    }
-    if (k == 'U') { /* history up */
-      if (ni->history.count == 0)
-        continue;
+      break;
+    case KEY_RIGHT:
+      if (editor->gap_end < editor->capacity) {
+        size_t length = char_after(editor);
+        queue_output(editor, editor->text + editor->gap_end, length);
+        move_gap(editor, editor->gap_start + length);
+      }
+      break;
+    case KEY_HOME:
+      if (editor->gap_start > 0) {
+        queue_escape(editor, utf8_width(editor->text, editor->gap_start), 'D');
+        move_gap(editor, 0);
+      }
+      break;
+    case KEY_END:
+      if (editor->gap_end < editor->capacity) {
+        queue_escape(editor, utf8_width(editor->text + editor->gap_end, editor->capacity - editor->gap_end), 'C');
+        move_gap(editor, line_length(editor));
+      }
+      break;
+    case KEY_UP: /* history up */
       hist_line = history_up(&hist_idx);
       if (!hist_line)
-        continue;
-      size_t hlen = strlen(hist_line);
-      if (cap < hlen + 1) {
-        tmp = safe_realloc(buf, hlen + 1);
-        buf = tmp;
-        cap = hlen + 1;
-        if (allocated_here == 0)
-          allocated_here = 1;
-      }
-      memcpy(buf, hist_line, hlen + 1);
-      len = hlen;
-      cursor = len;
-      buf[len] = '\0';
-      render_replace(buf, len, cursor, &displayed_len, &displayed_cursor);
-      continue;
-    }
-    if (k == 'D') { /* history down */
+        break;
+      set_line(editor, hist_line, strlen(hist_line));
+      repaint_line(editor, current_prompt());
+      break;
+    case KEY_DOWN: /* history down */
       hist_line = history_down(&hist_idx);
-      size_t hlen = strlen(hist_line);
-      if (cap < hlen + 1) {
-        tmp = safe_realloc(buf, hlen + 1);
-        buf = tmp;
-        cap = hlen + 1;
-        if (allocated_here == 0)
-          allocated_here = 1;
-      }
-      memcpy(buf, hist_line, hlen + 1);
-      len = hlen;
-      cursor = len;
-      buf[len] = '\0';
-      render_replace(buf, len, cursor, &displayed_len, &displayed_cursor);
-      continue;
-    }
-    if (k >= 32 && k <= 126) { /* printable */
-      if (len + 2 > cap) {
-        size_t newcap = cap * 2;
-        if (newcap < len + 2)
-          newcap = len + 2;
-        tmp = safe_realloc(buf, newcap);
-        buf = tmp;
-        cap = newcap;
-        if (allocated_here == 0)
-          allocated_here = 1;
+      set_line(editor, hist_line, strlen(hist_line));
+      repaint_line(editor, current_prompt());
+      break;
+#ifndef _WIN32
+    case KEY_PASTE:
+      read_paste(editor);
+      done = insert_paste(editor);
+      break;
+#endif
+    default:
+      if (k >= 32 && k <= 126) { /* printable */
+        char ch = (char)k;
+        insert_text(editor, &ch, 1);
+      } else if (k >= 0xc2 && k <= 0xf4) { /* first byte of a UTF-8 character */
+        char bytes[4] = {(char)k};
+        size_t length = k < 0xe0 ? 2 : k < 0xf0 ? 3 : 4, count = 1;
+        while (count < length && (k = read_key()) >= 0x80 && k <= 0xbf)
+          bytes[count++] = (char)k;
+        if (count < length) /* the key that cut it short is handled next */
+          pending = k;
+        else if (utf8_valid_prefix(bytes, count) == length)
+          insert_text(editor, bytes, length);
       }
-      memmove(buf + cursor + 1, buf + cursor, len - cursor + 1);
-      buf[cursor] = (char)k;
-      cursor++;
-      len++;
-      buf[len] = '\0';
-      render_insert_char((char)k, buf + cursor + 1, len - cursor, cursor, &displayed_len, &displayed_cursor);
-      continue;
+      break;
     }
   }
 
-  return -1;
+  // Hand the line over as one contiguous string.
+  move_gap(editor, line_length(editor));
+  size_t len = editor->gap_start;
+  queue_output(editor, "\n", 1);
+  flush_output(editor);
+  if (!*lineptr || *n < len + 1) {
+    *lineptr = safe_realloc(*lineptr, len + 1);
+    *n = len + 1;
+  }
+  memcpy(*lineptr, editor->text, len);
+  (*lineptr)[len] = '\0';
+  if (len > 0)
+    history_add(&ni->history, *lineptr);
+  disable_raw();
+  return (ssize_t)len;
 }
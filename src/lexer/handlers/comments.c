@@ -17,7 +17,7 @@
 void handle_multi_comment(char c) {
   debug_func("%c", c);
   // Check for the end of the multi-line comment.
-  if (c == '*' && safe_char(ctx->current_line, ctx->line_index + 1) == '/') {
+  if (c == '*' && peek_char(1) == '/') {
     ctx->state = STATE_NORMAL;
     ctx->multi_comment_line = 0;
     ctx->multi_comment_index = 0;
@@ -38,11 +38,11 @@ void handle_multi_comment(char c) {
 bool handle_comments(char c) {
   debug_func("%c", c);
   // Handle single-line comments.
-  if (c == '#' || (c == '/' && safe_char(ctx->current_line, ctx->line_index + 1) == '/')) {
+  if (c == '#' || (c == '/' && peek_char(1) == '/')) {
     // Terminate the line at the comment start to ignore the rest.
     ctx->current_line[ctx->line_index] = '\0';
     return true; // Indicates the rest of the line should be skipped.
-  } else if (c == '/' && safe_char(ctx->current_line, ctx->line_index + 1) == '*') {
+  } else if (c == '/' && peek_char(1) == '*') {
     // Handle the start of a multi-line comment.
     ctx->state = STATE_MULTI_COMMENT;
     ctx->multi_comment_line = ctx->line_number;
@@ -55,7 +55,7 @@ bool handle_comments(char c) {
 
     ctx->line_index++;
     return false;
-  } else if (c == '*' && safe_char(ctx->current_line, ctx->line_index + 1) == '/') {
+  } else if (c == '*' && peek_char(1) == '/') {
     // Error: Found a closing comment tag without an opening one.
     print_log(LOG_ERROR, ERR_UNMATCHED, (LogPosition){ctx->line_number, ctx->line_index + 1}, "*/", "comment", "*/");
     ctx->has_syntax_error = 1;
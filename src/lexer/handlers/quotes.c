@@ -1,7 +1,8 @@
 // lexer/handlers/quotes.c
 // This file contains the logic for tokenizing string (`"..."`) and
-// character (`'...'`) literals. It handles escape sequences and ensures
-// literals are properly terminated.
+// character (`'...'`) literals. Escape sequences are decoded here, once, so
+// a literal's token holds the bytes of its value without the quotes, and
+// malformed escapes are reported at the column where they start.
 
 #include "config.h"
 #include "context.h"
@@ -11,74 +12,181 @@
 #include "utils/log.h"
 #include "utils/memory.h"
 #include <ctype.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Processes characters while the lexer is in the STATE_QUOTE state.
-bool tokenize_strings(char c) {
-  debug_func("%c", c);
-  // Handle escape sequences (e.g., \n, \t, \").
-  if (c == '\\' && safe_char(ctx->current_line, ctx->line_index + 1) != '\0') {
-    // Ensure buffer has space.
-    if (ctx->string_token_length + 2 >= ctx->string_token_capacity) {
-      size_t new_cap = ctx->string_token_capacity ? ctx->string_token_capacity * 2 : INITIAL_CAPACITY;
-      ctx->string_token = safe_realloc(ctx->string_token, new_cap);
-      ctx->string_token_capacity = new_cap;
-    }
-    // Add both the backslash and the escaped character to the buffer.
-    ctx->string_token[ctx->string_token_length++] = c;
-    ctx->string_token[ctx->string_token_length++] = safe_char(ctx->current_line, ctx->line_index + 1);
-    ctx->string_token[ctx->string_token_length] = '\0';
-    ctx->line_index++; // Skip the escaped character.
-    return true;
+// Appends `length` bytes to the value of the literal being read.
+static void append_bytes(const char *bytes, size_t length) {
+  if (ctx->string_token_length + length >= ctx->string_token_capacity) {
+    size_t new_cap = ctx->string_token_capacity ? ctx->string_token_capacity * 2 : INITIAL_CAPACITY;
+    while (new_cap <= ctx->string_token_length + length)
+      new_cap *= 2;
+    ctx->string_token = safe_realloc(ctx->string_token, new_cap);
+    ctx->string_token_capacity = new_cap;
   }
+  memcpy(ctx->string_token + ctx->string_token_length, bytes, length);
+  ctx->string_token_length += length;
+  ctx->string_token[ctx->string_token_length] = '\0';
+}
 
-  if (c == '\0')
-    return true;
+// Returns the value of a hexadecimal digit.
+static unsigned hex_value(char c) { return isdigit((unsigned char)c) ? (unsigned)(c - '0') : (unsigned)(tolower((unsigned char)c) - 'a' + 10); }
 
-  // Check for the closing quote.
-  if (ctx->quote_char != '\0' && c == ctx->quote_char) {
-    // Ensure buffer has space.
-    if (ctx->string_token_length + 1 >= ctx->string_token_capacity) {
-      size_t new_cap = ctx->string_token_capacity ? ctx->string_token_capacity * 2 : INITIAL_CAPACITY;
-      ctx->string_token = safe_realloc(ctx->string_token, new_cap);
-      ctx->string_token_capacity = new_cap;
-    }
-    ctx->string_token[ctx->string_token_length++] = c;
-    ctx->string_token[ctx->string_token_length] = '\0';
+// Encodes a code point as UTF-8 and returns the number of bytes written.
+static size_t encode_utf8(uint32_t code, char *out) {
+  if (code < 0x80) {
+    out[0] = (char)code;
+    return 1;
+  }
+  if (code < 0x800) {
+    out[0] = (char)(0xc0 | (code >> 6));
+    out[1] = (char)(0x80 | (code & 0x3f));
+    return 2;
+  }
+  if (code < 0x10000) {
+    out[0] = (char)(0xe0 | (code >> 12));
+    out[1] = (char)(0x80 | ((code >> 6) & 0x3f));
+    out[2] = (char)(0x80 | (code & 0x3f));
+    return 3;
+  }
+  out[0] = (char)(0xf0 | (code >> 18));
+  out[1] = (char)(0x80 | ((code >> 12) & 0x3f));
+  out[2] = (char)(0x80 | ((code >> 6) & 0x3f));
+  out[3] = (char)(0x80 | (code & 0x3f));
+  return 4;
+}
+
+// Reports the malformed escape of `length` bytes at the current backslash.
+static void escape_error(const char *fmt, const char *escape, size_t length) {
+  char *text = safe_malloc(length + 1);
+  memcpy(text, escape, length);
+  text[length] = '\0';
+  print_log(LOG_ERROR, fmt, (LogPosition){ctx->line_number, ctx->line_index + 1}, text, text);
+  free(text);
+  ctx->has_syntax_error = 1;
+}
 
-    // Create the appropriate token (CHAR or STRING).
-    if (ctx->quote_char == '\'') {
-      size_t content = ctx->string_token_length - 2;
-      if (content > 1) {
-        // Warn if a character literal contains more than one character.
-        print_log(LOG_WARNING, WRN_MULTICHAR_COMMENT, (LogPosition){ctx->quote_line, ctx->quote_index}, ctx->string_token);
-      }
-      append_token(TOKEN_CHAR, ctx->string_token, ctx->line_number, ctx->line_index);
-    } else {
-      append_token(TOKEN_STRING, ctx->string_token, ctx->line_number, ctx->line_index);
+// Decodes a `\u{...}` escape: one to six hexadecimal digits naming a
+// Unicode scalar value, appended as UTF-8. Returns the escape's length.
+static size_t decode_unicode(const char *escape) {
+  if (escape[2] != '{') {
+    escape_error(ERR_INVALID_UNICODE_ESCAPE, escape, 2);
+    return 2;
+  }
+  uint32_t code = 0;
+  size_t digits = 0;
+  for (; isxdigit((unsigned char)escape[3 + digits]); digits++)
+    if (digits < 6)
+      code = code * 16 + hex_value(escape[3 + digits]);
+  size_t length = 3 + digits;
+  bool closed = escape[length] == '}';
+  if (closed)
+    length++;
+  if (!closed || digits == 0 || digits > 6) {
+    escape_error(ERR_INVALID_UNICODE_ESCAPE, escape, length);
+    return length;
+  }
+  if (code > 0x10ffff || (code >= 0xd800 && code <= 0xdfff)) {
+    escape_error(ERR_INVALID_CODE_POINT, escape, length);
+    return length;
+  }
+  char bytes[4];
+  append_bytes(bytes, encode_utf8(code, bytes));
+  return length;
+}
+
+// Decodes the escape sequence whose backslash is the current character and
+// moves the lexer onto its last character.
+static void decode_escape(void) {
+  const char *escape = ctx->current_line + ctx->line_index;
+  char decoded = escape[1];
+  size_t length = 2;
+  switch (escape[1]) {
+  case '\0': return; // The input ends inside the literal, which reports it.
+  case 'n': decoded = '\n'; break;
+  case 't': decoded = '\t'; break;
+  case 'r': decoded = '\r'; break;
+  case '0': decoded = '\0'; break;
+  case '\\':
+  case '"':
+  case '\'': break;
+  case 'x':
+    // Exactly two digits, giving one byte.
+    if (!isxdigit((unsigned char)escape[2]) || !isxdigit((unsigned char)escape[3])) {
+      length = isxdigit((unsigned char)escape[2]) ? 3 : 2;
+      escape_error(ERR_INVALID_HEX_ESCAPE, escape, length);
+      ctx->line_index += length - 1;
+      return;
     }
+    decoded = (char)(hex_value(escape[2]) * 16 + hex_value(escape[3]));
+    length = 4;
+    break;
+  case 'u': ctx->line_index += decode_unicode(escape) - 1; return;
+  case '\n':
+    // Leave the newline to the literal.
+    escape_error(ERR_UNKNOWN_ESCAPE, escape, 1);
+    return;
+  default:
+    // Quote the whole escaped character, even when it takes several bytes.
+    while ((escape[length] & 0xc0) == 0x80)
+      length++;
+    escape_error(ERR_UNKNOWN_ESCAPE, escape, length);
+    ctx->line_index += length - 1;
+    return;
+  }
+  append_bytes(&decoded, 1);
+  ctx->line_index += length - 1;
+}
 
-    // Reset the string tokenizing state.
-    ctx->string_token_length = 0;
-    if (ctx->string_token)
-      ctx->string_token[0] = '\0';
-    ctx->quote_char = '\0';
-    ctx->quote_line = 0;
-    ctx->quote_index = 0;
-    ctx->state = STATE_NORMAL;
+// Counts the characters, not the bytes, of a UTF-8 value.
+static size_t count_characters(const char *bytes, size_t length) {
+  size_t count = 0;
+  for (size_t i = 0; i < length; i++)
+    count += ((unsigned char)bytes[i] & 0xc0) != 0x80;
+  return count;
+}
 
-  } else {
-    // Append the character to the current string token buffer.
-    if (ctx->string_token_length + 1 >= ctx->string_token_capacity) {
-      size_t new_cap = ctx->string_token_capacity ? ctx->string_token_capacity * 2 : INITIAL_CAPACITY;
-      ctx->string_token = safe_realloc(ctx->string_token, new_cap);
-      ctx->string_token_capacity = new_cap;
+// Finishes the literal at its closing quote and appends its token.
+static void close_literal(void) {
+  if (ctx->quote_char == '\'') {
+    if (count_characters(ctx->string_token, ctx->string_token_length) > 1) {
+      // Warn if a character literal contains more than one character,
+      // quoting its source text when it fits on one line.
+      size_t start = ctx->quote_index - 1;
+      size_t length = ctx->quote_line == ctx->line_number ? ctx->line_index - start + 1 : 1;
+      char *text = safe_malloc(length + 1);
+      memcpy(text, length > 1 ? ctx->current_line + start : "'", length);
+      text[length] = '\0';
+      print_log(LOG_WARNING, WRN_MULTICHAR_COMMENT, (LogPosition){ctx->quote_line, ctx->quote_index}, text);
+      free(text);
     }
-    ctx->string_token[ctx->string_token_length++] = c;
-    ctx->string_token[ctx->string_token_length] = '\0';
+    append_token_value(TOKEN_CHAR, ctx->string_token, ctx->string_token_length, ctx->quote_line, ctx->quote_index);
+  } else {
+    append_token_value(TOKEN_STRING, ctx->string_token, ctx->string_token_length, ctx->quote_line, ctx->quote_index);
   }
+
+  // Reset the string tokenizing state.
+  ctx->string_token_length = 0;
+  ctx->string_token[0] = '\0';
+  ctx->quote_char = '\0';
+  ctx->quote_line = 0;
+  ctx->quote_index = 0;
+  ctx->state = STATE_NORMAL;
+}
+
+// Processes characters while the lexer is in the STATE_QUOTE state.
+bool tokenize_strings(char c) {
+  debug_func("%c", c);
+  if (c == '\0')
+    return true;
+  if (c == '\\')
+    decode_escape();
+  else if (c == ctx->quote_char)
+    close_literal();
+  else
+    append_bytes(&c, 1);
   return true;
 }
 
@@ -92,22 +200,13 @@ void handle_quotes(char c) {
     if (!ctx->string_token) {
       ctx->string_token_capacity = INITIAL_CAPACITY;
       ctx->string_token = safe_malloc(ctx->string_token_capacity);
-      ctx->string_token_length = 0;
-      ctx->string_token[0] = '\0';
     }
+    ctx->string_token_length = 0;
+    ctx->string_token[0] = '\0';
     // Record the quote type and its position for error reporting.
     ctx->quote_char = c;
     ctx->quote_line = ctx->line_number;
     ctx->quote_index = ctx->line_index + 1;
-
-    // Add the opening quote to the buffer.
-    if (ctx->string_token_length + 1 >= ctx->string_token_capacity) {
-      size_t new_cap = ctx->string_token_capacity ? ctx->string_token_capacity * 2 : INITIAL_CAPACITY;
-      ctx->string_token = safe_realloc(ctx->string_token, new_cap);
-      ctx->string_token_capacity = new_cap;
-    }
-    ctx->string_token[ctx->string_token_length++] = c;
-    ctx->string_token[ctx->string_token_length] = '\0';
   }
 }
 
@@ -4,14 +4,19 @@
 // and converts the character stream into a sequence of tokens for the parser.
 
 #include "lexer/lexer.h"
+#include "cache.h"
 #include "config.h"
 #include "context.h"
+#include "eval/eval.h"
+#include "eval/value.h"
 #include "lexer/tokens.h"
 #include "parser/ast.h"
 #include "parser/parser.h"
+#include "stats.h"
 #include "utils/log.h"
 #include "utils/memory.h"
 #include "utils/strings.h"
+#include "utils/utf8.h"
 #include <ctype.h>
 #include <math.h>
 #include <stdbool.h>
@@ -22,23 +27,10 @@
 // Initializes the lexer state and allocates memory for various buffers.
 void init_lexer(void) {
   debug_func("");
-  init_context(); // Prepare all fields in the global context `ctx`.
-
-  // Allocate initial memory for storing source code lines.
-  ctx->lines = safe_calloc(INITIAL_CAPACITY, sizeof(char *));
-  ctx->lines_capacity = INITIAL_CAPACITY;
-
-  // Allocate initial memory for the token list.
-  ctx->tokens = safe_calloc(INITIAL_CAPACITY, sizeof(Token));
-  ctx->tokens_capacity = INITIAL_CAPACITY;
-
-  // Allocate initial memory for the log entries.
-  ctx->logs = safe_calloc(INITIAL_CAPACITY, sizeof(LogEntry));
-  ctx->logs_capacity = INITIAL_CAPACITY;
-
-  // Allocate initial memory for the bracket matching stack.
-  ctx->bracket_stack = safe_calloc(INITIAL_CAPACITY, sizeof(BracketStackItem));
-  ctx->bracket_stack_capacity = INITIAL_CAPACITY;
+  // Prepare all fields of the thread's context `ctx` unless the caller
+  // already selected one.
+  if (!ctx)
+    init_context();
 
   // Print the initial REPL prompt if in REPL mode.
   if (ni->is_repl) {
@@ -48,28 +40,216 @@ void init_lexer(void) {
   }
 }
 
+// Stores a copy of the current line for error reporting.
+void store_line(void) {
+  debug_func("");
+  // Expand the lines buffer if necessary.
+  size_t slot = ctx->line_number - ctx->first_line;
+  if (slot >= ctx->lines_capacity) {
+    size_t new_cap = ctx->lines_capacity * 2;
+    ctx->lines = safe_realloc(ctx->lines, new_cap * sizeof(char *));
+    memset(ctx->lines + ctx->lines_capacity, 0, (new_cap - ctx->lines_capacity) * sizeof(char *));
+    ctx->lines_capacity = new_cap;
+  }
+
+  // Copy without the trailing newline, into the buffer of a released line
+  // if there is one.
+  size_t length = strcspn(ctx->current_line, "\n");
+  ctx->lines[slot] = safe_realloc(ctx->lines[slot], length + 1);
+  memcpy(ctx->lines[slot], ctx->current_line, length);
+  ctx->lines[slot][length] = '\0';
+  ctx->line_number++;
+}
+
+// Reverses the order of the stored lines in [from, to).
+static void reverse_lines(size_t from, size_t to) {
+  while (from + 1 < to) {
+    char *line = ctx->lines[from];
+    ctx->lines[from++] = ctx->lines[--to];
+    ctx->lines[to] = line;
+  }
+}
+
+// In streaming mode, releases the lines of finished statements, keeping the
+// last STREAM_LINE_WINDOW of them for diagnostics. The released buffers are
+// moved behind the kept lines and reused by store_line(), so a long run
+// neither grows nor keeps allocating.
+static void release_lines(void) {
+  size_t stored = ctx->line_number - ctx->first_line;
+  if (stored <= STREAM_LINE_WINDOW)
+    return;
+  size_t released = stored - STREAM_LINE_WINDOW;
+  // Rotate the kept lines to the front.
+  reverse_lines(0, released);
+  reverse_lines(released, stored);
+  reverse_lines(0, stored);
+  ctx->first_line += released;
+}
+
+// Tokenizes the current line, carrying lexer state over to the next line.
+void lex_line(void) {
+  debug_func("");
+  // Source text must be UTF-8. A line that is not is reported at its first
+  // bad byte and not lexed.
+  if (ctx->bytes_read > 0) {
+    size_t valid = utf8_valid_prefix(ctx->current_line, (size_t)ctx->bytes_read);
+    if (valid < (size_t)ctx->bytes_read) {
+      print_log(LOG_ERROR, ERR_INVALID_UTF8, (LogPosition){ctx->line_number, valid + 1}, NULL, (unsigned char)ctx->current_line[valid]);
+      ctx->has_syntax_error = 1;
+      return;
+    }
+  }
+  // Loop through each character of the current line.
+  for (ctx->line_index = 0; ctx->bytes_read > 0 && ctx->line_index < (size_t)ctx->bytes_read && ctx->current_line[ctx->line_index] != '\0' && !ctx->error_limit_reached; ctx->line_index++) {
+
+    char c = ctx->current_line[ctx->line_index];
+
+    // Handle characters based on the current lexer state. Whitespace inside
+    // a literal is part of its value.
+    if (ctx->state == STATE_QUOTE) {
+      tokenize_strings(c);
+      continue;
+    }
+
+    // Skip whitespace characters.
+    if (isspace((unsigned char)c))
+      continue;
+    if (ctx->state == STATE_MULTI_COMMENT) {
+      handle_multi_comment(c);
+
+      if (is_nothing(ctx->current_line) && ctx->current_line[ctx->line_index + 1] == '\0' && ni->is_repl) {
+
+        if (ctx->state != STATE_NORMAL || ctx->bracket_stack_size != 0) {
+          // // if line is empty and state is multi comment like
+          //                                                                     /*
+          //  this line the if statement is It will happen */
+          // If the current line ends, and the state is still STATE_MULTI_COMMENT, prompt for continuation.
+          printf("... "), fflush(stdout);
+        } else {
+          // example 1/**/ if line is multi line comment like /**/
+          // If the multi-line comment closed on this line, reset the prompt to '>>>'.
+          printf(">>> "), fflush(stdout);
+        }
+      }
+      continue;
+    }
+    if (ctx->state == STATE_NORMAL) {
+      handle_quotes(c);
+      if ((handle_comments(c) || handle_brackets(c)) && ni->is_repl) {
+        // A fatal, interactive error occurred.
+        break;
+      }
+      if (is_nothing(ctx->current_line) && ctx->current_line[ctx->line_index + 1] == '\0' && ni->is_repl && ctx->state == STATE_MULTI_COMMENT) {
+        // if line is empty and state is multi comment and this is last char
+        // example `/*`
+        // If a multi-line comment (/*) was started right before the end of the line, prompt for continuation.
+        printf("... "), fflush(stdout);
+      }
+    }
+    // A line comment ends the line where it starts.
+    if (ctx->current_line[ctx->line_index] == '\0')
+      break;
+    // In normal state, try to tokenize numbers, identifiers, or symbols.
+    if (ctx->state == STATE_NORMAL) {
+      if (tokenize_number())
+        continue;
+      if (tokenize_identifier())
+        continue;
+      if (tokenize_symbol())
+        continue;
+    }
+  }
+}
+
+// Returns the character `offset` positions after the current one, or '\0'
+// past the end of the line. Unlike safe_char, it only scans the characters
+// it skips over, so lexing a long line stays linear.
+char peek_char(size_t offset) {
+  const char *p = ctx->current_line + ctx->line_index;
+  for (size_t i = 0; i < offset; i++)
+    if (p[i] == '\0')
+      return '\0';
+  return p[offset];
+}
+
+// Checks whether the tokens read so far form a complete statement.
+bool statement_complete(void) { return ctx->state == STATE_NORMAL && ctx->bracket_stack_size == 0; }
+
+// Prints, parses and releases the statement currently held in the token list.
+void process_statement(void) {
+  debug_func("");
+  print_tokens();
+  uint64_t start = stats_clock();
+  ctx->ast_root = parse();
+  stats_add(STATS_PARSE, start);
+
+  // If parsing was successful, print the AST.
+  if (ctx->ast_root) {
+    print_ast(ctx->ast_root);
+
+    // Evaluate the statement unless only its syntax is being checked.
+    Value value;
+    start = stats_clock();
+    bool evaluated = !ni->check_syntax && evaluate(ctx->ast_root, &value);
+    stats_add(STATS_EVAL, start);
+    if (evaluated) {
+      free_value(&ctx->result);
+      ctx->result = value;
+      // The REPL shows the value of every statement.
+      if (ni->is_repl) {
+        print_value(stdout, ctx->result);
+        putchar('\n');
+      }
+    }
+    free_node(ctx->ast_root);
+    ctx->ast_root = NULL;
+  }
+
+  // Clear tokens for the next statement.
+  free_tokens();
+}
+
+// Reads the next line of input into the context's line buffer. The REPL
+// edits lines interactively; files, pipes and command strings go through
+// the block reader.
+static bool next_line(void) {
+  uint64_t start = stats_clock();
+  if (ni->is_repl && ni->file == stdin) {
+    ctx->bytes_read = portable_getline(&ctx->current_line, &ctx->line_length, ni->file);
+  } else {
+    size_t length;
+    const char *line = read_line(&ni->reader, &length);
+    if (line)
+      load_line(line, length);
+    else
+      ctx->bytes_read = -1;
+  }
+  stats_add(STATS_READ, start);
+  if (ctx->bytes_read == -1)
+    return false;
+  ctx->stats.bytes += (size_t)ctx->bytes_read;
+  ctx->stats.lines++;
+  return true;
+}
+
 // The main lexer function. It loops through input and produces tokens.
 int lexer(void) {
   debug_func("");
   init_lexer();
 
-  // Main loop: read one line at a time.
-  while ((ctx->bytes_read = portable_getline(&ctx->current_line, &ctx->line_length, ni->file)) != -1) {
+  // Replay a cached image of this file instead of lexing it again.
+  if (cache_open() && cache_replay())
+    return EXIT_SUCCESS;
 
-    // Expand the lines buffer if necessary.
-    if (ctx->line_number >= ctx->lines_capacity) {
-      size_t new_cap = ctx->lines_capacity * 2;
-      ctx->lines = safe_realloc(ctx->lines, new_cap * sizeof(char *));
-      ctx->lines_capacity = new_cap;
-    }
+  // Main loop: read one line at a time.
+  if (!ni->is_repl || ni->file != stdin)
+    reader_open(&ni->reader, ni->file);
+  while (!ctx->error_limit_reached && next_line()) {
 
-    // Store a copy of the current line for error reporting.
-    ctx->lines[ctx->line_number] = safe_strdup(ctx->current_line);
-    if (ctx->lines[ctx->line_number]) {
-      // Remove trailing newline character.
-      ctx->lines[ctx->line_number][strcspn(ctx->lines[ctx->line_number], "\n")] = '\0';
-    }
-    ctx->line_number++;
+    // Nothing before a finished statement is needed any more.
+    if (ni->stream && statement_complete())
+      release_lines();
+    store_line();
 
     if (ni->is_repl && ni->file != stdin) {
       // just for tests
@@ -100,62 +280,9 @@ int lexer(void) {
       continue;
     }
 
-    // Loop through each character of the current line.
-    for (ctx->line_index = 0; ctx->bytes_read > 0 && ctx->line_index < (size_t)ctx->bytes_read && ctx->current_line[ctx->line_index] != '\0'; ctx->line_index++) {
-
-      char c = ctx->current_line[ctx->line_index];
-
-      // Skip whitespace characters.
-      if (isspace((unsigned char)c))
-        continue;
-
-      // Handle characters based on the current lexer state.
-      if (ctx->state == STATE_QUOTE) {
-        tokenize_strings(c);
-        continue;
-      }
-      if (ctx->state == STATE_MULTI_COMMENT) {
-        handle_multi_comment(c);
-
-        if (is_nothing(ctx->current_line) && ctx->current_line[ctx->line_index + 1] == '\0' && ni->is_repl) {
-
-          if (ctx->state != STATE_NORMAL || ctx->bracket_stack_size != 0) {
-            // // if line is empty and state is multi comment like
-            //                                                                     /*
-            //  this line the if statement is It will happen */
-            // If the current line ends, and the state is still STATE_MULTI_COMMENT, prompt for continuation.
-            printf("... "), fflush(stdout);
-          } else {
-            // example 1/**/ if line is multi line comment like /**/
-            // If the multi-line comment closed on this line, reset the prompt to '>>>'.
-            printf(">>> "), fflush(stdout);
-          }
-        }
-        continue;
-      }
-      if (ctx->state == STATE_NORMAL) {
-        handle_quotes(c);
-        if ((handle_comments(c) || handle_brackets(c)) && ni->is_repl) {
-          // A fatal, interactive error occurred.
-          break;
-        }
-        if (is_nothing(ctx->current_line) && ctx->current_line[ctx->line_index + 1] == '\0' && ni->is_repl && ctx->state == STATE_MULTI_COMMENT) {
-          // if line is empty and state is multi comment and this is last char
-          // example `/*`
-          // If a multi-line comment (/*) was started right before the end of the line, prompt for continuation.
-          printf("... "), fflush(stdout);
-        }
-      }
-      // In normal state, try to tokenize numbers, identifiers, or symbols.
-      if (ctx->state == STATE_NORMAL) {
-        if (tokenize_number())
-          continue;
-        if (tokenize_identifier())
-          continue;
-        if (tokenize_symbol())
-          continue;
-      }
-    }
+    uint64_t start = stats_clock();
+    lex_line();
+    stats_add(STATS_LEX, start);
     if (!ni->check_syntax && !ni->is_repl && ctx->has_syntax_error) {
       exit(1);
     }
@@ -165,20 +292,23 @@ int lexer(void) {
       continue;
     }
     // If a complete statement is formed, parse it.
-    if (ctx->state == STATE_NORMAL && ctx->bracket_stack_size == 0) {
-      print_tokens();
-      ctx->ast_root = parse();
-
-      // If parsing was successful, print the AST.
-      if (ctx->ast_root) {
-        print_ast(ctx->ast_root);
-        free_node(ctx->ast_root);
-        ctx->ast_root = NULL;
+    if (statement_complete()) {
+      if (ctx->cache)
+        cache_record_statement();
+      process_statement();
+      // Report each statement as soon as it is checked, and keep the
+      // spellings of endless input or a long REPL session from piling up.
+      if (ni->stream)
+        flush_logs();
+      if (ni->stream || ni->is_repl)
+        intern_trim(&ctx->interns, INTERN_LIMIT);
+      // Each REPL statement is reported on its own, so a message repeated
+      // in earlier ones is shown again.
+      if (ni->is_repl) {
+        report_suppressed_logs();
+        clear_duplicates(ctx);
       }
 
-      // Clear tokens for the next statement.
-      free_tokens();
-
       if (!ni->check_syntax && !ni->is_repl && ctx->has_syntax_error) {
         exit(EXIT_FAILURE);
       }
@@ -228,5 +358,61 @@ int lexer(void) {
     // In file mode, exit with failure after printing summary.
     return EXIT_FAILURE;
   }
+
+  // A clean run can be replayed next time without lexing.
+  cache_store();
   return EXIT_SUCCESS;
 }
+
+// Copies one line of source into the context's line buffer.
+void load_line(const char *line, size_t length) {
+  if (length + 1 > ctx->line_length) {
+    ctx->current_line = safe_realloc(ctx->current_line, length + 1);
+    ctx->line_length = length + 1;
+  }
+  memcpy(ctx->current_line, line, length);
+  ctx->current_line[length] = '\0';
+  ctx->bytes_read = (ssize_t)length;
+}
+
+// Lexes, parses and evaluates an in-memory source buffer with the current
+// context, like lexer() does for a file but without exiting on errors.
+// Unless only checking syntax, it stops at the first statement with an
+// error. Logs are left sorted in the context for the caller to report.
+void lex_source(const char *source, size_t length) {
+  debug_func("length: %zu", length);
+  if (!ctx)
+    init_context();
+
+  // Nothing from a previous run refers to the interned spellings any more.
+  intern_trim(&ctx->interns, INTERN_LIMIT);
+
+  bool stopped = false;
+  const char *end = source + length;
+  for (const char *p = source; p < end && !stopped && !ctx->error_limit_reached;) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    size_t line_length = nl ? (size_t)(nl + 1 - p) : (size_t)(end - p);
+    load_line(p, line_length);
+    p += line_length;
+
+    store_line();
+    if (is_nothing(ctx->current_line))
+      continue;
+    lex_line();
+    stopped = !ni->check_syntax && ctx->has_syntax_error;
+    if (stopped || is_nothing(ctx->current_line))
+      continue;
+    if (statement_complete())
+      process_statement();
+    stopped = !ni->check_syntax && ctx->has_syntax_error;
+    ctx->has_syntax_error = 0;
+  }
+
+  // Report constructs left open at the end of the source.
+  if (!stopped) {
+    check_unclosed_quote();
+    check_unclosed_comment();
+    check_unclosed_brackets();
+  }
+  sort_logs();
+}
@@ -89,20 +89,26 @@ const char *token_type_to_string(TokenType type) {
   }
 }
 
-// Helper function to create and initialize a single Token struct.
-static Token create_token(TokenType token_type, const char *token_value, size_t token_line, size_t token_index) {
+// Helper function to create and initialize a single Token struct whose
+// value is `n` bytes long.
+static Token create_token(TokenType token_type, const char *token_value, size_t n, size_t token_line, size_t token_index) {
   debug_func("token_type: %d, token_value: %s,token_line: %zu, token_index: %zu", token_type, token_value, token_line, token_index);
   Token token;
   token.token_type = token_type;
   token.token_line = token_line;
   token.token_index = token_index;
-  if (!token_value)
-    token_value = "";
-  // Allocate memory for the token's value and copy it.
-  size_t n = strlen(token_value);
-  token.token_value = safe_malloc(n + 1);
-  memcpy(token.token_value, token_value, n);
-  token.token_value[n] = '\0';
+  // Names and literals repeat a lot: share one copy of each spelling.
+  if (token_type == TOKEN_IDENTIFIER || token_type == TOKEN_KEYWORD || token_type == TOKEN_STRING || token_type == TOKEN_CHAR) {
+    token.token_intern = intern(&ctx->interns, token_value, n);
+    token.token_value = intern_string(&ctx->interns, token.token_intern);
+    return token;
+  }
+  // Copy any other value into the statement's region.
+  char *value = region_alloc(&ctx->token_values, n + 1);
+  memcpy(value, token_value, n);
+  value[n] = '\0';
+  token.token_intern = 0;
+  token.token_value = value;
   return token;
 }
 
@@ -119,9 +125,18 @@ static void ensure_tokens_capacity(void) {
 
 // Appends a new token to the global tokens array.
 void append_token(TokenType token_type, const char *token_value, size_t token_line, size_t token_index) {
+  if (!token_value)
+    token_value = "";
+  append_token_value(token_type, token_value, strlen(token_value), token_line, token_index);
+}
+
+// Appends a new token whose value is `length` bytes long. String and char
+// literals use it, since their decoded values may hold NUL bytes.
+void append_token_value(TokenType token_type, const char *token_value, size_t length, size_t token_line, size_t token_index) {
   debug_func("token_type: %d, token_value: %s,token_line: %zu, token_index: %zu", token_type, token_value, token_line, token_index);
   ensure_tokens_capacity();
-  ctx->tokens[ctx->tokens_count++] = create_token(token_type, token_value, token_line, token_index);
+  ctx->tokens[ctx->tokens_count++] = create_token(token_type, token_value, length, token_line, token_index);
+  ctx->stats.tokens++;
 }
 
 // Prints all collected tokens if the dump_tokens flag is enabled.
@@ -129,28 +144,17 @@ void print_tokens(void) {
   debug_func("");
   if (ni->dump_tokens) {
     for (size_t i = 0; i < ctx->tokens_count; ++i) {
-      printf("[%zu] %s: %s\n", i, token_type_to_string(ctx->tokens[i].token_type), ctx->tokens[i].token_value);
+      fprintf(ni->out_stream, "[%zu] %s: %s\n", i, token_type_to_string(ctx->tokens[i].token_type), ctx->tokens[i].token_value);
     }
-    putchar('\n');
+    fputc('\n', ni->out_stream);
   }
 }
 
-// Frees the memory used by the global tokens array and resets its state.
+// Empties the global tokens array and releases the token values. The array
+// and the region keep their capacity for the next statement.
 void free_tokens(void) {
   debug_func("");
-  if (!ctx->tokens)
-    return;
-  // Free the value string for each token.
-  for (size_t i = 0; i < ctx->tokens_count; ++i) {
-    if (ctx->tokens[i].token_value) {
-      free(ctx->tokens[i].token_value);
-      ctx->tokens[i].token_value = NULL;
-    }
-  }
-  // Free the array itself.
-  free(ctx->tokens);
-  ctx->tokens = NULL;
-  ctx->tokens_capacity = 0;
+  region_reset(&ctx->token_values);
   ctx->tokens_position = 0;
   ctx->tokens_count = 0;
 }
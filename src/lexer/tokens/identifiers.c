@@ -1,8 +1,9 @@
 // lexer/tokens/identifiers.c
 // This file contains the logic for tokenizing identifiers. An identifier is a
 // sequence of letters, digits, and underscores, starting with a letter or
-// underscore. After tokenizing, it checks if the identifier is a reserved
-// keyword.
+// underscore, where letters and digits include the Unicode characters with
+// the XID_Start and XID_Continue properties. After tokenizing, it checks if
+// the identifier is a reserved keyword.
 
 #include "config.h"
 #include "context.h"
@@ -11,23 +12,39 @@
 #include "lexer/tokens.h"
 #include "utils/log.h"
 #include "utils/memory.h"
-#include <ctype.h>
+#include "utils/utf8.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Returns the length of the character at `p` if it can start an identifier
+// (or continue one, when `start` is false), and 0 otherwise. ASCII is
+// checked directly; other characters need the XID tables.
+static size_t identifier_char(const char *p, bool start) {
+  unsigned char c = (unsigned char)*p;
+  if (c < 0x80) {
+    bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    return letter || (!start && c >= '0' && c <= '9');
+  }
+  size_t length;
+  uint32_t code = utf8_decode(p, &length);
+  if (!length)
+    return 0;
+  return (start ? is_xid_start(code) : is_xid_continue(code)) ? length : 0;
+}
+
 // Attempts to tokenize an identifier from the current input position.
 bool tokenize_identifier(void) {
   debug_func("");
-  char ch = safe_char(ctx->current_line, ctx->line_index);
-
   // An identifier must start with a letter or an underscore.
-  if (isalpha((unsigned char)ch) || ch == '_') {
+  size_t first = identifier_char(ctx->current_line + ctx->line_index, true);
+  if (first) {
     size_t start = ctx->line_index;
-    // Consume all subsequent alphanumeric characters and underscores.
-    while (isalnum((unsigned char)safe_char(ctx->current_line, ctx->line_index)) || safe_char(ctx->current_line, ctx->line_index) == '_')
-      ctx->line_index++;
+    // Consume all subsequent letters, digits and underscores.
+    ctx->line_index += first;
+    for (size_t next; (next = identifier_char(ctx->current_line + ctx->line_index, false));)
+      ctx->line_index += next;
 
     // Extract the identifier string.
     size_t length = ctx->line_index - start;
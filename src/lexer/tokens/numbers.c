@@ -16,12 +16,12 @@
 // Attempts to tokenize a number from the current input position.
 bool tokenize_number(void) {
   debug_func("");
-  char ch = safe_char(ctx->current_line, ctx->line_index);
+  char ch = peek_char(0);
   size_t start = ctx->line_index;
   // A number must start with a digit, or a '.' followed by a digit.
   if (ch == '.')
     return false;
-  if (!isdigit((unsigned char)ch) && !(ch == '.' && isdigit((unsigned char)safe_char(ctx->current_line, start + 1))))
+  if (!isdigit((unsigned char)ch) && !(ch == '.' && isdigit((unsigned char)peek_char(1))))
     return false;
 
   TokenType type = TOKEN_INT;
@@ -37,7 +37,7 @@ bool tokenize_number(void) {
 
   // Loop to consume all parts of the number literal.
   while (1) {
-    char c = safe_char(ctx->current_line, ctx->line_index);
+    char c = peek_char(0);
 
     if (isdigit((unsigned char)c)) {
       has_digit = true;
@@ -51,9 +51,10 @@ bool tokenize_number(void) {
       }
       prev_underscore = true;
       ctx->line_index++;
-    } else if (c == '.' && !has_decimal_point && !has_exponent) {
+    } else if (c == '.' && peek_char(1) != '.' && !has_decimal_point && !has_exponent) {
+      // A second dot means `...`, as in `1...3`, not a decimal point.
       // A dot cannot be followed by an underscore.
-      if (safe_char(ctx->current_line, ctx->line_index + 1) == '_')
+      if (peek_char(1) == '_')
         goto error;
       has_decimal_point = true;
       prev_underscore = false;
@@ -62,12 +63,12 @@ bool tokenize_number(void) {
       has_exponent = true;
       prev_underscore = false;
       ctx->line_index++;
-      char next = safe_char(ctx->current_line, ctx->line_index);
+      char next = peek_char(0);
       if (next == '+' || next == '-') {
         ctx->line_index++;
       }
       // An exponent part cannot be followed by an underscore.
-      if (safe_char(ctx->current_line, ctx->line_index) == '_')
+      if (peek_char(0) == '_')
         goto error;
     } else
       break;
@@ -84,7 +85,7 @@ bool tokenize_number(void) {
     goto error;
 
   // Check for incomplete exponent part (e.g., 1e, 1e+).
-  char last_char = safe_char(ctx->current_line, end - 1);
+  char last_char = ctx->current_line[end - 1];
   if (last_char == 'e' || last_char == 'E' || last_char == '+' || last_char == '-')
     goto error;
 
@@ -107,8 +108,8 @@ bool tokenize_number(void) {
 error:
   end = ctx->line_index;
   // Consume the rest of the invalid number literal for error reporting.
-  while (isalnum(safe_char(ctx->current_line, end)) || safe_char(ctx->current_line, end) == '.' || safe_char(ctx->current_line, end) == '_' || safe_char(ctx->current_line, end) == 'e' ||
-         safe_char(ctx->current_line, end) == 'E')
+  // Every character up to `end` has been read, so the line extends that far.
+  while (isalnum((unsigned char)ctx->current_line[end]) || ctx->current_line[end] == '.' || ctx->current_line[end] == '_')
     end++;
   len = end - start;
   if (len == 0)
@@ -7,16 +7,18 @@
 #include "lexer/tokens.h"
 #include "utils/log.h"
 #include "utils/memory.h"
+#include "utils/utf8.h"
 #include <stdbool.h>
+#include <string.h>
 
 // Attempts to tokenize a symbol from the current input position.
 // It tries to match the longest possible symbol (e.g., `<<=` before `<<`).
 bool tokenize_symbol(void) {
   debug_func("");
   // Peek up to 3 characters ahead for multi-character symbols.
-  char c0 = safe_char(ctx->current_line, ctx->line_index);
-  char c1 = safe_char(ctx->current_line, ctx->line_index + 1);
-  char c2 = safe_char(ctx->current_line, ctx->line_index + 2);
+  char c0 = peek_char(0);
+  char c1 = peek_char(1);
+  char c2 = peek_char(2);
 
   char three[4] = {c0, c1, c2, '\0'};
   char two[3] = {c0, c1, '\0'};
@@ -41,10 +43,17 @@ bool tokenize_symbol(void) {
     }
   }
   // If no symbol matches, but it's not whitespace, it's an unknown token.
-  char ch = safe_char(ctx->current_line, ctx->line_index);
+  // It takes the whole character, which may be several bytes.
+  char ch = peek_char(0);
   if (!isspace((unsigned char)ch)) {
-    const char tmp[2] = {ch, '\0'};
+    size_t length;
+    utf8_decode(ctx->current_line + ctx->line_index, &length);
+    if (length == 0)
+      length = 1;
+    char tmp[5] = {0};
+    memcpy(tmp, ctx->current_line + ctx->line_index, length);
     append_token(TOKEN_UNKNOWN, tmp, ctx->line_number, ctx->line_index + 1);
+    ctx->line_index += length - 1;
     return true;
   }
   return false;
@@ -148,6 +157,7 @@ bool is_operator(TokenType type) {
   case TOKEN_DECREMENT:
   case TOKEN_ARROW:
   case TOKEN_COLONEQUAL:
+  case TOKEN_ELLIPSIS:
   case TOKEN_QUESTION: return true;
   default: return false;
   }
@@ -0,0 +1,530 @@
+// lsp.c
+// This file implements language-server mode (`noon --lsp`). Documents are
+// split into chunks at statement boundaries, and every chunk keeps its own
+// tokens, AST and diagnostics. An edit re-lexes from the chunk that holds
+// its first line and stops as soon as the lexer reaches a boundary that
+// lines up with an old chunk past the edit; the remaining chunks are kept
+// and only shifted. Diagnostics are published as LSP ranges after every
+// change.
+
+#include "lsp.h"
+#include "config.h"
+#include "context.h"
+#include "input.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "utils/json.h"
+#include "utils/memory.h"
+#include "utils/strings.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// JSON-RPC error code for unknown methods.
+#define LSP_METHOD_NOT_FOUND -32601
+
+// Open documents.
+static LspDocument **documents = NULL;
+static size_t documents_count = 0;
+static size_t documents_capacity = 0;
+
+// Frees everything owned by a chunk.
+static void free_chunk(LspChunk *chunk) {
+  free(chunk->tokens);
+  region_free(&chunk->token_values);
+  if (chunk->ast)
+    free_node(chunk->ast);
+  for (size_t i = 0; i < chunk->logs_count; i++) {
+    free(chunk->logs[i].log_msg);
+    free(chunk->logs[i].log_symbol);
+  }
+  free(chunk->logs);
+}
+
+// Frees a document and its chunks.
+static void free_document(LspDocument *doc) {
+  for (size_t i = 0; i < doc->lines_count; i++)
+    free(doc->lines[i].text);
+  for (size_t i = 0; i < doc->chunks_count; i++)
+    free_chunk(&doc->chunks[i]);
+  intern_free(&doc->interns);
+  free(doc->lines);
+  free(doc->chunks);
+  free(doc->uri);
+  free(doc);
+}
+
+// Finds an open document by URI.
+static LspDocument *find_document(const char *uri, size_t *index) {
+  for (size_t i = 0; uri && i < documents_count; i++) {
+    if (strcmp(documents[i]->uri, uri) == 0) {
+      if (index)
+        *index = i;
+      return documents[i];
+    }
+  }
+  return NULL;
+}
+
+// Returns the index of the chunk holding a document line. Lines past the
+// end belong to the last chunk.
+static size_t find_chunk(const LspDocument *doc, size_t line) {
+  size_t low = 0, high = doc->chunks_count;
+  while (high - low > 1) {
+    size_t mid = low + (high - low) / 2;
+    if (doc->chunks[mid].first_line <= line)
+      low = mid;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+// Converts a UTF-16 offset within a line (as LSP counts characters) to a
+// byte offset.
+static size_t byte_offset(const LspLine *line, size_t character) {
+  size_t end = line->length;
+  if (end && line->text[end - 1] == '\n')
+    end--;
+  size_t i = 0;
+  while (i < end && character > 0) {
+    unsigned char c = (unsigned char)line->text[i];
+    size_t width = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+    character -= width == 4 && character > 1 ? 2 : 1;
+    i += width;
+  }
+  return i < end ? i : end;
+}
+
+// Converts a byte offset within a line to a UTF-16 offset.
+static size_t utf16_offset(const LspLine *line, size_t offset) {
+  size_t character = 0;
+  for (size_t i = 0; line && i < offset && i < line->length; i++) {
+    unsigned char c = (unsigned char)line->text[i];
+    if ((c & 0xC0) != 0x80)
+      character += c >= 0xF0 ? 2 : 1;
+  }
+  return character + (line && offset > line->length ? offset - line->length : 0);
+}
+
+// Replaces document lines [first, last) with the lines of `text`. Returns
+// the number of lines inserted.
+static size_t replace_lines(LspDocument *doc, size_t first, size_t last, const char *prefix, size_t prefix_length, const char *text, size_t text_length, const char *suffix, size_t suffix_length) {
+  size_t combined_length = prefix_length + text_length + suffix_length;
+  char *combined = safe_malloc(combined_length + 1);
+  memcpy(combined, prefix, prefix_length);
+  memcpy(combined + prefix_length, text, text_length);
+  memcpy(combined + prefix_length + text_length, suffix, suffix_length);
+
+  // Count the new lines; every piece keeps its '\n'.
+  size_t count = 0;
+  for (const char *p = combined, *end = combined + combined_length; p < end; count++) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    p = nl ? nl + 1 : end;
+  }
+
+  for (size_t i = first; i < last; i++)
+    free(doc->lines[i].text);
+  size_t new_count = doc->lines_count - (last - first) + count;
+  if (new_count > doc->lines_capacity) {
+    while (doc->lines_capacity < new_count)
+      doc->lines_capacity = doc->lines_capacity ? doc->lines_capacity * 2 : INITIAL_CAPACITY;
+    doc->lines = safe_realloc(doc->lines, doc->lines_capacity * sizeof(LspLine));
+  }
+  memmove(&doc->lines[first + count], &doc->lines[last], (doc->lines_count - last) * sizeof(LspLine));
+  doc->lines_count = new_count;
+
+  const char *p = combined, *end = combined + combined_length;
+  for (size_t i = first; i < first + count; i++) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    size_t length = nl ? (size_t)(nl + 1 - p) : (size_t)(end - p);
+    doc->lines[i].text = safe_malloc(length + 1);
+    memcpy(doc->lines[i].text, p, length);
+    doc->lines[i].text[length] = '\0';
+    doc->lines[i].length = length;
+    p += length;
+  }
+  free(combined);
+  return count;
+}
+
+// Moves the logs collected in the context into a chunk.
+static void take_logs(LspChunk *chunk) {
+  if (ctx->logs_count == 0)
+    return;
+  sort_logs();
+  chunk->logs = safe_realloc(chunk->logs, (chunk->logs_count + ctx->logs_count) * sizeof(LogEntry));
+  memcpy(&chunk->logs[chunk->logs_count], ctx->logs, ctx->logs_count * sizeof(LogEntry));
+  chunk->logs_count += ctx->logs_count;
+  ctx->logs_count = 0;
+}
+
+// Appends a chunk to a growable array.
+static LspChunk *push_chunk(LspChunk **chunks, size_t *count, size_t *capacity) {
+  if (*count >= *capacity) {
+    *capacity = *capacity ? *capacity * 2 : INITIAL_CAPACITY;
+    *chunks = safe_realloc(*chunks, *capacity * sizeof(LspChunk));
+  }
+  LspChunk *chunk = &(*chunks)[(*count)++];
+  memset(chunk, 0, sizeof(*chunk));
+  return chunk;
+}
+
+// Re-lexes the document from chunk `first` on. The edit that triggered it
+// ends before line `edit_end` of the new text and moved later lines by
+// `delta`; old chunks that start past the edit are reused once the lexer
+// reaches a boundary at their shifted position.
+static void relex(LspDocument *doc, size_t first, size_t edit_end, ptrdiff_t delta) {
+  debug_func("first: %zu, edit_end: %zu", first, edit_end);
+  size_t start_line = first < doc->chunks_count ? doc->chunks[first].first_line : 0;
+  size_t old_count = doc->chunks_count;
+  size_t reuse = old_count; // First old chunk kept after the re-lexed region.
+  size_t next_old = first;
+
+  LspChunk *fresh = NULL;
+  size_t fresh_count = 0, fresh_capacity = 0;
+  Token *tokens = NULL;
+  size_t tokens_count = 0;
+  Region token_values = {NULL, NULL};
+  Node *ast = NULL;
+
+  // The document interns into its own table, which its chunks refer to.
+  InternTable interns = ctx->interns;
+  ctx->interns = doc->interns;
+  reset_context(ctx);
+  size_t chunk_start = start_line;
+  for (size_t line = start_line; line < doc->lines_count; line++) {
+    load_line(doc->lines[line].text, doc->lines[line].length);
+    store_line();
+    if (!is_nothing(ctx->current_line)) {
+      lex_line();
+      if (!is_nothing(ctx->current_line) && statement_complete()) {
+        // Keep the statement's tokens and AST in the chunk.
+        ctx->tokens_position = 0;
+        ast = parse();
+        ctx->ast_root = NULL;
+        tokens = ctx->tokens;
+        tokens_count = ctx->tokens_count;
+        token_values = ctx->token_values;
+        ctx->token_values = (Region){NULL, NULL};
+        ctx->tokens = NULL;
+        ctx->tokens_count = 0;
+        ctx->tokens_capacity = 0;
+        ctx->tokens_position = 0;
+      }
+      ctx->has_syntax_error = 0;
+    }
+    if (!statement_complete() || ctx->tokens_count)
+      continue;
+
+    // The lexer is at a boundary after this line: close the chunk.
+    LspChunk *chunk = push_chunk(&fresh, &fresh_count, &fresh_capacity);
+    chunk->first_line = chunk_start;
+    chunk->line_count = line + 1 - chunk_start;
+    chunk->line_offset = start_line;
+    chunk->tokens = tokens;
+    chunk->tokens_count = tokens_count;
+    chunk->token_values = token_values;
+    chunk->ast = ast;
+    take_logs(chunk);
+    tokens = NULL;
+    tokens_count = 0;
+    token_values = (Region){NULL, NULL};
+    ast = NULL;
+    chunk_start = line + 1;
+
+    // Past the edit, stop where an old chunk starts at the same place.
+    if (chunk_start >= edit_end) {
+      while (next_old < old_count && (ptrdiff_t)doc->chunks[next_old].first_line + delta < (ptrdiff_t)chunk_start)
+        next_old++;
+      if (next_old < old_count && (ptrdiff_t)doc->chunks[next_old].first_line + delta == (ptrdiff_t)chunk_start) {
+        reuse = next_old;
+        break;
+      }
+    }
+  }
+
+  // At the end of the document, report constructs left open.
+  if (reuse == old_count) {
+    check_unclosed_quote();
+    check_unclosed_comment();
+    check_unclosed_brackets();
+    free_tokens();
+    if (chunk_start < doc->lines_count || (ctx->logs_count && fresh_count == 0 && doc->lines_count)) {
+      LspChunk *chunk = push_chunk(&fresh, &fresh_count, &fresh_capacity);
+      chunk->first_line = chunk_start;
+      chunk->line_count = doc->lines_count - chunk_start;
+      chunk->line_offset = start_line;
+    }
+    if (fresh_count)
+      take_logs(&fresh[fresh_count - 1]);
+  }
+
+  // Splice: chunks before `first`, the fresh chunks, the shifted tail.
+  for (size_t i = first; i < reuse; i++)
+    free_chunk(&doc->chunks[i]);
+  for (size_t i = reuse; i < old_count; i++) {
+    doc->chunks[i].first_line += delta;
+    doc->chunks[i].line_offset += delta;
+  }
+  size_t tail = old_count - reuse;
+  size_t new_count = first + fresh_count + tail;
+  if (new_count > doc->chunks_capacity) {
+    while (doc->chunks_capacity < new_count)
+      doc->chunks_capacity = doc->chunks_capacity ? doc->chunks_capacity * 2 : INITIAL_CAPACITY;
+    doc->chunks = safe_realloc(doc->chunks, doc->chunks_capacity * sizeof(LspChunk));
+  }
+  memmove(&doc->chunks[first + fresh_count], &doc->chunks[reuse], tail * sizeof(LspChunk));
+  if (fresh_count)
+    memcpy(&doc->chunks[first], fresh, fresh_count * sizeof(LspChunk));
+  doc->chunks_count = new_count;
+  free(fresh);
+  reset_context(ctx);
+  doc->interns = ctx->interns;
+  ctx->interns = interns;
+}
+
+// Applies one entry of `contentChanges` and re-lexes what it affects.
+static void apply_change(LspDocument *doc, const JsonValue *change) {
+  const JsonValue *text = json_get(change, "text");
+  if (!text || text->json_type != JSON_STRING)
+    return;
+  const JsonValue *range = json_get(change, "range");
+  size_t first = 0, last = doc->lines_count;
+  size_t prefix_length = 0, suffix_length = 0;
+  const char *prefix = "", *suffix = "";
+
+  if (range) {
+    const JsonValue *start = json_get(range, "start"), *end = json_get(range, "end");
+    size_t start_line = (size_t)json_number(json_get(start, "line"), 0);
+    size_t start_character = (size_t)json_number(json_get(start, "character"), 0);
+    size_t end_line = (size_t)json_number(json_get(end, "line"), 0);
+    size_t end_character = (size_t)json_number(json_get(end, "character"), 0);
+    first = start_line < doc->lines_count ? start_line : doc->lines_count;
+    if (first < doc->lines_count) {
+      prefix = doc->lines[first].text;
+      prefix_length = byte_offset(&doc->lines[first], start_character);
+    }
+    if (end_line < doc->lines_count) {
+      size_t offset = byte_offset(&doc->lines[end_line], end_character);
+      suffix = doc->lines[end_line].text + offset;
+      suffix_length = doc->lines[end_line].length - offset;
+      last = end_line + 1;
+    }
+    if (last < first)
+      last = first;
+  }
+
+  size_t chunk = find_chunk(doc, first);
+  size_t inserted = replace_lines(doc, first, last, prefix, prefix_length, text->string_value, text->string_length, suffix, suffix_length);
+  // Kept chunks refer to every spelling the document ever had, so once
+  // they outgrow INTERN_LIMIT the table is emptied and the whole document
+  // lexed again.
+  if (doc->interns.bytes_size > INTERN_LIMIT) {
+    for (size_t i = 0; i < doc->chunks_count; i++)
+      free_chunk(&doc->chunks[i]);
+    doc->chunks_count = 0;
+    intern_trim(&doc->interns, INTERN_LIMIT);
+    relex(doc, 0, doc->lines_count, 0);
+    return;
+  }
+  relex(doc, chunk, first + inserted, (ptrdiff_t)inserted - (ptrdiff_t)(last - first));
+}
+
+// Sends one JSON-RPC message with its Content-Length header.
+static void send_message(const char *body, size_t length) {
+  fprintf(stdout, "Content-Length: %zu\r\n\r\n", length);
+  fwrite(body, 1, length, stdout);
+  fflush(stdout);
+}
+
+// Sends a response to a request. `result` is raw JSON.
+static void send_result(const JsonValue *id, const char *result) {
+  char *body = NULL;
+  size_t length = 0;
+  FILE *stream = open_memstream(&body, &length);
+  fputs("{\"jsonrpc\":\"2.0\",\"id\":", stream);
+  json_print(stream, id);
+  fprintf(stream, ",\"result\":%s}", result);
+  fclose(stream);
+  send_message(body, length);
+  free(body);
+}
+
+// Sends an error response to a request.
+static void send_error(const JsonValue *id, int code, const char *message) {
+  char *body = NULL;
+  size_t length = 0;
+  FILE *stream = open_memstream(&body, &length);
+  fputs("{\"jsonrpc\":\"2.0\",\"id\":", stream);
+  json_print(stream, id);
+  fprintf(stream, ",\"error\":{\"code\":%d,\"message\":", code);
+  json_print_string(stream, message, strlen(message));
+  fputs("}}", stream);
+  fclose(stream);
+  send_message(body, length);
+  free(body);
+}
+
+// Publishes the diagnostics of every chunk of a document.
+static void publish_diagnostics(const char *uri, const LspDocument *doc) {
+  char *body = NULL;
+  size_t length = 0;
+  FILE *stream = open_memstream(&body, &length);
+  fputs("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":", stream);
+  json_print_string(stream, uri, strlen(uri));
+  fputs(",\"diagnostics\":[", stream);
+  bool first = true;
+  for (size_t c = 0; doc && c < doc->chunks_count; c++) {
+    const LspChunk *chunk = &doc->chunks[c];
+    for (size_t i = 0; i < chunk->logs_count; i++) {
+      const LogEntry *log = &chunk->logs[i];
+      size_t line = (log->log_position.log_line ? log->log_position.log_line - 1 : 0) + chunk->line_offset;
+      const LspLine *text = line < doc->lines_count ? &doc->lines[line] : NULL;
+      size_t index = log->log_position.log_index ? log->log_position.log_index - 1 : 0;
+      size_t width = log->log_symbol && *log->log_symbol ? strlen(log->log_symbol) : 1;
+      int severity = log->log_type == LOG_ERROR ? 1 : log->log_type == LOG_WARNING ? 2 : 3;
+      fprintf(stream, "%s{\"range\":{\"start\":{\"line\":%zu,\"character\":%zu},\"end\":{\"line\":%zu,\"character\":%zu}},\"severity\":%d,\"source\":\"noon\",\"message\":", first ? "" : ",", line,
+              utf16_offset(text, index), line, utf16_offset(text, index + width), severity);
+      json_print_string(stream, log->log_msg, strlen(log->log_msg));
+      fputc('}', stream);
+      first = false;
+    }
+  }
+  fputs("]}}", stream);
+  fclose(stream);
+  send_message(body, length);
+  free(body);
+}
+
+// Handles `textDocument/didOpen`.
+static void did_open(const JsonValue *params) {
+  const JsonValue *item = json_get(params, "textDocument");
+  const char *uri = json_string(json_get(item, "uri"));
+  const JsonValue *text = json_get(item, "text");
+  if (!uri || !text || text->json_type != JSON_STRING)
+    return;
+  size_t index;
+  if (find_document(uri, &index)) {
+    free_document(documents[index]);
+    documents[index] = documents[--documents_count];
+  }
+  LspDocument *doc = safe_calloc(1, sizeof(LspDocument));
+  doc->uri = safe_strdup(uri);
+  if (documents_count >= documents_capacity) {
+    documents_capacity = documents_capacity ? documents_capacity * 2 : INITIAL_CAPACITY;
+    documents = safe_realloc(documents, documents_capacity * sizeof(LspDocument *));
+  }
+  documents[documents_count++] = doc;
+  apply_change(doc, item);
+  publish_diagnostics(uri, doc);
+}
+
+// Handles `textDocument/didChange`.
+static void did_change(const JsonValue *params) {
+  const char *uri = json_string(json_get(json_get(params, "textDocument"), "uri"));
+  LspDocument *doc = find_document(uri, NULL);
+  const JsonValue *changes = json_get(params, "contentChanges");
+  if (!doc || !changes || changes->json_type != JSON_ARRAY)
+    return;
+  for (size_t i = 0; i < changes->items_count; i++)
+    apply_change(doc, &changes->items[i]);
+  publish_diagnostics(uri, doc);
+}
+
+// Handles `textDocument/didClose`.
+static void did_close(const JsonValue *params) {
+  const char *uri = json_string(json_get(json_get(params, "textDocument"), "uri"));
+  size_t index;
+  if (!find_document(uri, &index))
+    return;
+  free_document(documents[index]);
+  documents[index] = documents[--documents_count];
+  publish_diagnostics(uri, NULL);
+}
+
+// Reads the next message body from stdin. Returns NULL at end of input.
+static char *read_message(size_t *length) {
+  char *line = NULL;
+  size_t line_capacity = 0;
+  ssize_t read;
+  long content_length = -1;
+  while ((read = portable_getline(&line, &line_capacity, stdin)) != -1) {
+    if (strcmp(line, "\r\n") == 0 || strcmp(line, "\n") == 0) {
+      if (content_length >= 0)
+        break;
+      continue;
+    }
+    if (strncmp(line, "Content-Length:", 15) == 0)
+      content_length = strtol(line + 15, NULL, 10);
+  }
+  free(line);
+  if (read == -1 || content_length < 0)
+    return NULL;
+
+  char *body = safe_malloc((size_t)content_length + 1);
+  if (fread(body, 1, (size_t)content_length, stdin) != (size_t)content_length) {
+    free(body);
+    return NULL;
+  }
+  body[content_length] = '\0';
+  *length = (size_t)content_length;
+  return body;
+}
+
+// Serves LSP requests on stdin/stdout until the client exits.
+int lsp(void) {
+  debug_func("");
+  if (!ctx)
+    init_context();
+  ni->input = "<lsp>";
+  ni->check_syntax = 1;
+  ni->collect_logs = 1;
+
+  bool shutdown = false;
+  int status = EXIT_FAILURE; // Input ended without `exit`.
+  char *body;
+  size_t length;
+  while ((body = read_message(&length)) != NULL) {
+    JsonValue message;
+    bool parsed = json_parse(body, length, &message);
+    free(body);
+    if (!parsed)
+      continue;
+
+    const char *method = json_string(json_get(&message, "method"));
+    const JsonValue *id = json_get(&message, "id");
+    const JsonValue *params = json_get(&message, "params");
+    bool done = false;
+    if (!method) {
+      // A response to a request we never send; ignore it.
+    } else if (strcmp(method, "initialize") == 0) {
+      send_result(id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2}},\"serverInfo\":{\"name\":\"noon\"}}");
+    } else if (strcmp(method, "shutdown") == 0) {
+      shutdown = true;
+      send_result(id, "null");
+    } else if (strcmp(method, "exit") == 0) {
+      status = shutdown ? EXIT_SUCCESS : EXIT_FAILURE;
+      done = true;
+    } else if (strcmp(method, "textDocument/didOpen") == 0) {
+      did_open(params);
+    } else if (strcmp(method, "textDocument/didChange") == 0) {
+      did_change(params);
+    } else if (strcmp(method, "textDocument/didClose") == 0) {
+      did_close(params);
+    } else if (id) {
+      send_error(id, LSP_METHOD_NOT_FOUND, "method not found");
+    }
+    json_free(&message);
+    if (done)
+      break;
+  }
+
+  for (size_t i = 0; i < documents_count; i++)
+    free_document(documents[i]);
+  free(documents);
+  documents = NULL;
+  documents_count = documents_capacity = 0;
+  return status;
+}
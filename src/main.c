@@ -3,10 +3,16 @@
 // It handles command-line argument parsing, sets up the program's initial
 // state, manages input from files or the REPL, and starts the lexer.
 
+#include "batch.h"
 #include "config.h"
 #include "context.h"
 #include "input.h"
 #include "lexer/lexer.h"
+#include "lsp.h"
+#include "server.h"
+#include "stats.h"
+#include "utils/log.h"
+#include "utils/memory.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -54,6 +60,9 @@ int main(int argc, char **argv) {
 
   init_input(); // initialize NoonInput global structure
   ni->program_name = argv[0];
+  const char **paths = safe_malloc(argc * sizeof(char *)); // source file arguments
+  size_t path_count = 0;
+  int jobs = default_jobs();
 
   /* parse command line arguments */
   for (int i = 1; i < argc; i++) {
@@ -88,6 +97,76 @@ int main(int argc, char **argv) {
     } else if (strcmp(argv[i], "-cs") == 0 || strcmp(argv[i], "--check-syntax") == 0) {
       ni->check_syntax = 1; // check syntax
       continue;
+    } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+      // number of worker threads for checking several files
+      if (i + 1 >= argc) {
+        fprintf(stderr, ERR_OPTION_REQUIRES_ARGUMENT, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, argv[i]);
+        exit(EXIT_FAILURE);
+      }
+      char *end;
+      long value = strtol(argv[i + 1], &end, 10);
+      if (*end || value < 1 || value > 1024) {
+        fprintf(stderr, ERR_INVALID_JOBS, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, argv[i + 1]);
+        exit(EXIT_FAILURE);
+      }
+      jobs = (int)value;
+      i++; // skip the count argument
+      continue;
+    } else if (strcmp(argv[i], "--serve") == 0) {
+      // serve requests on a Unix domain socket
+      if (i + 1 >= argc) {
+        fprintf(stderr, ERR_OPTION_REQUIRES_ARGUMENT, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, argv[i]);
+        exit(EXIT_FAILURE);
+      }
+      free(paths);
+      return serve(argv[i + 1]);
+    } else if (strcmp(argv[i], "--lsp") == 0) {
+      // speak the Language Server Protocol over stdio
+      free(paths);
+      return lsp();
+    } else if (strncmp(argv[i], "--diagnostics-format=", 21) == 0) {
+      // output format of diagnostics
+      const char *format = argv[i] + 21;
+      if (strcmp(format, "text") == 0)
+        ni->diagnostics_format = DIAGNOSTICS_TEXT;
+      else if (strcmp(format, "json") == 0)
+        ni->diagnostics_format = DIAGNOSTICS_JSON;
+      else if (strcmp(format, "sarif") == 0)
+        ni->diagnostics_format = DIAGNOSTICS_SARIF;
+      else {
+        fprintf(stderr, ERR_INVALID_DIAGNOSTICS_FORMAT, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, format);
+        exit(EXIT_FAILURE);
+      }
+      continue;
+    } else if (strncmp(argv[i], "--max-errors=", 13) == 0) {
+      // stop after this many errors
+      char *end;
+      const char *value = argv[i] + 13;
+      unsigned long long count = strtoull(value, &end, 10);
+      if (!*value || *end || *value == '-') {
+        fprintf(stderr, ERR_INVALID_MAX_ERRORS, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, value);
+        exit(EXIT_FAILURE);
+      }
+      ni->max_errors = (size_t)count;
+      continue;
+    } else if (strcmp(argv[i], "--stream") == 0) {
+      ni->stream = 1; // bounded memory for endless input (e.g. `tail -f`)
+      continue;
+    } else if (strcmp(argv[i], "--stats") == 0 || strncmp(argv[i], "--stats=", 8) == 0) {
+      // print timings and counters after the run
+      const char *format = argv[i][7] ? argv[i] + 8 : "text";
+      if (strcmp(format, "text") == 0)
+        ni->stats = STATS_TEXT;
+      else if (strcmp(format, "json") == 0)
+        ni->stats = STATS_JSON;
+      else {
+        fprintf(stderr, ERR_INVALID_STATS_FORMAT, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, format);
+        exit(EXIT_FAILURE);
+      }
+      continue;
+    } else if (strcmp(argv[i], "--cache") == 0) {
+      ni->use_cache = 1; // replay and store compiled cache images
+      continue;
     } else if (argv[i][0] == '-' && argv[i][1] == '-' && argv[i][2]) {
       // Handle unrecognized long options (e.g., --invalidoption).
       fprintf(stderr, ERR_UNRECOGNIZED_OPTION, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, argv[i], ni->program_name);
@@ -98,25 +177,46 @@ int main(int argc, char **argv) {
 
       exit(EXIT_FAILURE);
     } else {
-      // handle source file input
-      if (ni->file != NULL) {
-        fprintf(stderr, ERR_MULTIPLE_INPUT_FILES, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, argv[i]);
-        fclose(ni->file);
-        exit(EXIT_FAILURE);
-      }
-      ni->file = fopen(argv[i], "r");
-      if (!ni->file) {
-        fprintf(stderr, ERR_NO_FILE, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, argv[i]);
-        exit(EXIT_FAILURE);
-      }
-      ni->input = argv[i];
+      paths[path_count++] = argv[i]; // source file input, opened below
+    }
+  }
+
+  /* time the run from here; the report is printed by cleanup() */
+  if (ni->stats)
+    begin_stats();
+
+  /* machine-readable diagnostics form one document, finished by cleanup() */
+  if (ni->diagnostics_format != DIAGNOSTICS_TEXT)
+    begin_diagnostics();
+
+  /* check several files, or whole directories, in parallel */
+  if (ni->check_syntax && !ni->file && (path_count > 1 || (path_count == 1 && is_directory(paths[0])))) {
+    int status = check_files(paths, path_count, jobs);
+    free(paths);
+    return status;
+  }
+
+  /* handle source file input */
+  for (size_t i = 0; i < path_count; i++) {
+    if (ni->file != NULL) {
+      fprintf(stderr, ERR_MULTIPLE_INPUT_FILES, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, paths[i]);
+      exit(EXIT_FAILURE); // the open file is closed by cleanup()
+    }
+    ni->file = fopen(paths[i], "r");
+    if (!ni->file) {
+      fprintf(stderr, ERR_NO_FILE, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, paths[i]);
+      exit(EXIT_FAILURE);
     }
+    ni->input = paths[i];
   }
+  free(paths);
 
-  /* if no file is provided, enter REPL mode */
+  /* if no file is provided, read stdin: interactively from a terminal, or
+     like a file when it is a pipe or redirect (unless --repl was given) */
   if (!ni->file) {
     ni->file = stdin;
-    ni->is_repl = 1;
+    if (isatty(fileno(stdin)))
+      ni->is_repl = 1;
   }
 
   return lexer(); // start the lexer
@@ -0,0 +1,160 @@
+// noon.c
+// This file implements libnoon, the embeddable library API declared in
+// noon.h. Each NoonState owns its own context and input state; they are
+// selected for the calling thread only for the duration of a call, so the
+// library never prints diagnostics or exits the host process on errors.
+
+#include "noon.h"
+#include "context.h"
+#include "eval/bigint.h"
+#include "eval/dict.h"
+#include "eval/value.h"
+#include "input.h"
+#include "lexer/lexer.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include "utils/strings.h"
+#include <stdlib.h>
+#include <string.h>
+
+// An interpreter instance together with the views handed to the host.
+struct NoonState {
+  NoonContext *context;
+  NoonInput *input;
+  NoonResult result;
+  char *digits; // decimal digits of a big integer result
+  NoonDiagnostic *diagnostics;
+  size_t diagnostics_capacity;
+};
+
+// Creates a new interpreter instance.
+NoonState *noon_open(void) {
+  NoonState *state = calloc(1, sizeof(NoonState));
+  if (!state)
+    return NULL;
+  state->context = create_context();
+  state->input = create_input();
+  state->input->input = "<string>";
+  state->input->collect_logs = 1;
+  state->result.type = NOON_NULL;
+  return state;
+}
+
+// Publishes the context's result and logs through the public structs.
+static void publish(NoonState *state) {
+  const Value *value = &state->context->result;
+  memset(&state->result, 0, sizeof(state->result));
+  free(state->digits);
+  state->digits = NULL;
+  switch (value->value_type) {
+  case VALUE_NUMBER:
+    state->result.type = NOON_NUMBER;
+    state->result.number = value->number_value;
+    break;
+  case VALUE_INTEGER:
+    state->result.type = NOON_INTEGER;
+    state->result.integer = value->integer_value;
+    state->result.number = (double)value->integer_value;
+    break;
+  case VALUE_BIGINT:
+    state->result.type = NOON_BIGINT;
+    state->digits = bigint_to_string(value->bigint_value);
+    state->result.string = state->digits;
+    state->result.length = strlen(state->digits);
+    state->result.number = bigint_to_double(value->bigint_value);
+    break;
+  case VALUE_STRING:
+    state->result.type = NOON_STRING;
+    state->result.string = value->string_value;
+    state->result.length = value->string_length;
+    break;
+  case VALUE_BOOLEAN:
+    state->result.type = NOON_BOOLEAN;
+    state->result.boolean = value->boolean_value;
+    break;
+  case VALUE_LIST:
+    state->result.type = NOON_LIST;
+    state->result.length = value->list_length;
+    if (value->list_type == VALUE_BOOLEAN)
+      state->result.booleans = value->list_items;
+    else
+      state->result.numbers = value->list_items;
+    break;
+  case VALUE_DICT:
+    state->result.type = NOON_DICT;
+    state->result.length = value->dict_value->count;
+    break;
+  case VALUE_RANGE:
+    state->result.type = NOON_RANGE;
+    state->result.number = value->range_start;
+    state->result.step = value->range_step;
+    state->result.length = value->range_length;
+    break;
+  case VALUE_NULL:
+  default: state->result.type = NOON_NULL; break;
+  }
+
+  if (state->context->logs_count > state->diagnostics_capacity) {
+    state->diagnostics = safe_realloc(state->diagnostics, state->context->logs_count * sizeof(NoonDiagnostic));
+    state->diagnostics_capacity = state->context->logs_count;
+  }
+  for (size_t i = 0; i < state->context->logs_count; i++) {
+    const LogEntry *log = &state->context->logs[i];
+    NoonDiagnostic *diagnostic = &state->diagnostics[i];
+    diagnostic->kind = log->log_type == LOG_ERROR ? NOON_DIAGNOSTIC_ERROR : log->log_type == LOG_WARNING ? NOON_DIAGNOSTIC_WARNING : NOON_DIAGNOSTIC_INFO;
+    diagnostic->line = log->log_position.log_line;
+    diagnostic->column = log->log_position.log_index ? log->log_position.log_index : 1;
+    diagnostic->message = log->log_msg;
+    diagnostic->symbol = log->log_symbol ? log->log_symbol : "";
+  }
+}
+
+// Evaluates a source buffer statement by statement, stopping at the first
+// statement with an error.
+NoonStatus noon_eval(NoonState *state, const char *source, size_t length) {
+  if (!state || (!source && length > 0))
+    return NOON_ERROR;
+
+  // Select this instance for the calling thread.
+  NoonContext *saved_ctx = ctx;
+  NoonInput *saved_ni = ni;
+  ctx = state->context;
+  ni = state->input;
+  reset_context(ctx);
+
+  lex_source(source, length);
+
+  // A failed statement leaves no result behind.
+  if (ctx->total_errors)
+    free_value(&ctx->result);
+  NoonStatus status = ctx->total_errors ? NOON_ERROR : NOON_OK;
+  publish(state);
+
+  ctx = saved_ctx;
+  ni = saved_ni;
+  return status;
+}
+
+// Returns the result of the last evaluated statement.
+const NoonResult *noon_result(const NoonState *state) { return state ? &state->result : NULL; }
+
+// Returns the number of diagnostics produced by the last evaluation.
+size_t noon_diagnostic_count(const NoonState *state) { return state ? state->context->logs_count : 0; }
+
+// Returns a diagnostic produced by the last evaluation.
+const NoonDiagnostic *noon_diagnostic(const NoonState *state, size_t index) {
+  if (!state || index >= state->context->logs_count)
+    return NULL;
+  return &state->diagnostics[index];
+}
+
+// Frees an interpreter instance.
+void noon_close(NoonState *state) {
+  if (!state)
+    return;
+  destroy_context(state->context);
+  destroy_input(state->input);
+  free(state->digits);
+  free(state->diagnostics);
+  free(state);
+}
@@ -6,49 +6,94 @@
 #include "parser/ast.h"
 #include "config.h"
 #include "context.h"
+#include "eval/bigint.h"
+#include "eval/builtins.h"
+#include "eval/power.h"
 #include "input.h"
 #include "lexer/lexer.h"
 #include "utils/log.h"
 #include "utils/memory.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Allocates a node and counts it for --stats.
+static Node *new_node(void) {
+  ctx->stats.nodes++;
+  return safe_malloc(sizeof(Node));
+}
+
 // Creates a number node for the AST.
 Node *create_number_node(Token token, double value) {
   debug_func("");
-  Node *node = safe_malloc(sizeof(Node));
+  Node *node = new_node();
   node->node_type = NODE_NUMBER;
+  node->expression_type = NODE_NUMBER;
   node->token = token;
   node->number_value = value;
   return node;
 }
 
-// Creates a character literal node for the AST.
+// Creates an integer node for the AST. Integers are numbers to the type
+// checker; only the evaluator keeps them apart from doubles.
+Node *create_integer_node(Token token, int64_t value) {
+  debug_func("");
+  Node *node = new_node();
+  node->node_type = NODE_INTEGER;
+  node->expression_type = NODE_NUMBER;
+  node->token = token;
+  node->integer_value = value;
+  return node;
+}
+
+// Creates a node for an integer literal too large for 64 bits. The node
+// owns `value`.
+Node *create_bigint_node(Token token, struct BigInt *value) {
+  debug_func("");
+  Node *node = new_node();
+  node->node_type = NODE_BIGINT;
+  node->expression_type = NODE_NUMBER;
+  node->token = token;
+  node->bigint_value = value;
+  return node;
+}
+
+// Creates a character literal node for the AST. `value` is the interned
+// value of the token, which outlives the node.
 Node *create_char_node(Token token, const char *value) {
   debug_func("");
-  Node *node = safe_malloc(sizeof(Node));
+  Node *node = new_node();
   node->node_type = NODE_CHAR;
+  node->expression_type = NODE_STRING;
   node->token = token;
-  node->string_value = safe_strdup(value);
+  node->string_value = value;
   return node;
 }
 
-// Creates a string literal node for the AST.
+// Creates a string literal node for the AST from its interned value.
 Node *create_string_node(Token token, const char *value) {
   debug_func("");
-  Node *node = safe_malloc(sizeof(Node));
+  Node *node = new_node();
   node->node_type = NODE_STRING;
+  node->expression_type = NODE_STRING;
   node->token = token;
-  node->string_value = safe_strdup(value);
+  node->string_value = value;
   return node;
 }
 
+// Checks whether a node is a string or char literal.
+bool is_string_literal(const Node *node) { return node->node_type == NODE_STRING || node->node_type == NODE_CHAR; }
+
+// Returns the length of a string or char literal's value.
+size_t literal_length(const Node *node) { return intern_length(&ctx->interns, node->token.token_intern); }
+
 // Creates a boolean literal node for the AST.
 Node *create_boolean_node(Token token, bool value) {
   debug_func("");
-  Node *node = safe_malloc(sizeof(Node));
+  Node *node = new_node();
   node->node_type = NODE_BOOLEAN;
+  node->expression_type = NODE_BOOLEAN;
   node->token = token;
   node->boolean_value = value;
   return node;
@@ -57,39 +102,85 @@ Node *create_boolean_node(Token token, bool value) {
 // Creates a null literal node for the AST.
 Node *create_null_node(Token token) {
   debug_func("");
-  Node *node = safe_malloc(sizeof(Node));
+  Node *node = new_node();
   node->node_type = NODE_NULL;
+  node->expression_type = NODE_NULL;
   node->token = token;
   return node;
 }
 
-// Helper function to determine the type of a sub-expression for type checking.
-static NodeType get_expression_type(Node *node) {
-  debug_func("");
-  if (!node) {
-    return NODE_NULL;
+// Appends a child to the children of an n-ary node.
+static void append_child(Node ***children, size_t *count, size_t *capacity, Node *child) {
+  if (*count == *capacity) {
+    *capacity = *capacity ? *capacity * 2 : INITIAL_CAPACITY;
+    *children = safe_realloc(*children, *capacity * sizeof(Node *));
   }
+  (*children)[(*count)++] = child;
+}
 
-  switch (node->node_type) {
-  case NODE_NUMBER: return NODE_NUMBER;
+// Appends an operand to a concatenation node.
+static void append_part(Node *concat, Node *part) { append_child(&concat->concat.parts, &concat->concat.count, &concat->concat.capacity, part); }
+
+// Returns the type of an element-wise operation on a list or range. Shifting
+// or scaling a range gives another range; anything else gives a list. This
+// matches the closed forms in eval_range_op.
+static NodeType range_result(TokenType op, NodeType left_type, NodeType right_type) {
+  if (left_type == NODE_LIST || right_type == NODE_LIST)
+    return NODE_LIST;
+  switch (op) {
+  case TOKEN_PLUS:
+  case TOKEN_MINUS: return NODE_RANGE;
+  case TOKEN_STAR: return left_type == NODE_RANGE && right_type == NODE_RANGE ? NODE_LIST : NODE_RANGE;
+  case TOKEN_SLASH: return right_type == NODE_NUMBER ? NODE_RANGE : NODE_LIST;
+  default: return NODE_LIST;
+  }
+}
+
+// Picks how a `**` computes its result from its right operand. A constant
+// exponent of 0.5 or a small whole number gets a cheaper kernel than pow().
+static PowerKind power_kind(const Node *exponent, unsigned char *small) {
+  double value;
+  if (exponent->node_type == NODE_INTEGER)
+    value = (double)exponent->integer_value;
+  else if (exponent->node_type == NODE_NUMBER)
+    value = exponent->number_value;
+  else
+    return POWER_ANY;
+  if (value == 0.5)
+    return POWER_SQRT;
+  if (value >= 0 && value <= POW_CHAIN_LIMIT && value == (unsigned char)value) {
+    *small = (unsigned char)value;
+    return POWER_SMALL;
+  }
+  return POWER_ANY;
+}
+
+// Returns the name of the type of an expression for diagnostics.
+static const char *expression_type_name(NodeType type) {
+  switch (type) {
+  case NODE_NUMBER: return "number";
   case NODE_STRING:
-  case NODE_CHAR: return NODE_STRING;
-  case NODE_BOOLEAN: return NODE_BOOLEAN;
-  case NODE_NULL: return NODE_NULL;
-  case NODE_UNARY_OP:
-  case NODE_POSTFIX_OP: return get_expression_type(node->unary.operand);
-  case NODE_BINARY_OP: {
-    // For arithmetic operations, the result type is the common type.
-    NodeType left_type = get_expression_type(node->binary.left);
-    NodeType right_type = get_expression_type(node->binary.right);
-
-    if (left_type == NODE_NUMBER && right_type == NODE_NUMBER)
-      return NODE_NUMBER;
-    if ((left_type == NODE_STRING || left_type == NODE_CHAR) && (right_type == NODE_STRING || right_type == NODE_CHAR))
-      return NODE_STRING;
-    return NODE_NULL; // Incompatible types.
+  case NODE_CHAR: return "string";
+  case NODE_BOOLEAN: return "boolean";
+  case NODE_LIST: return "list";
+  case NODE_DICT: return "dict";
+  case NODE_RANGE: return "range";
+  default: return "null";
   }
-  default: return node->node_type;
+}
+
+// Returns the name of an operand for type errors. Literals are named by
+// their token, such as "integer" or "char"; anything else by its type.
+static const char *operand_name(const Node *node) {
+  switch (node->node_type) {
+  case NODE_NUMBER:
+  case NODE_INTEGER:
+  case NODE_BIGINT:
+  case NODE_CHAR:
+  case NODE_STRING:
+  case NODE_BOOLEAN:
+  case NODE_NULL: return token_type_to_string(node->token.token_type);
+  default: return expression_type_name(node->expression_type);
   }
 }
 
@@ -105,8 +196,10 @@ Node *create_binary_op_node(Token op, Node *left, Node *right) {
     return NULL;
   }
 
-  NodeType left_type = get_expression_type(left);
-  NodeType right_type = get_expression_type(right);
+  // Every node records the type of its value when it is created, so this
+  // check costs the same however long the chain on the left is.
+  NodeType left_type = left->expression_type;
+  NodeType right_type = right->expression_type;
 
   bool is_left_numeric = (left_type == NODE_NUMBER);
   bool is_right_numeric = (right_type == NODE_NUMBER);
@@ -114,24 +207,39 @@ Node *create_binary_op_node(Token op, Node *left, Node *right) {
   bool is_left_stringy = (left_type == NODE_STRING || left_type == NODE_CHAR);
   bool is_right_stringy = (right_type == NODE_STRING || right_type == NODE_CHAR);
 
-  bool is_valid = false;
+  // Lists and ranges combine element-wise with each other or numbers.
+  bool is_left_sequence = (left_type == NODE_LIST || left_type == NODE_RANGE);
+  bool is_right_sequence = (right_type == NODE_LIST || right_type == NODE_RANGE);
+  bool is_list_operation = (is_left_sequence || is_right_sequence) && (is_left_sequence || is_left_numeric) && (is_right_sequence || is_right_numeric);
+
+  // Dictionaries can only be compared for equality.
+  bool is_dict_comparison = left_type == NODE_DICT && right_type == NODE_DICT && (op.token_type == TOKEN_EQEQUAL || op.token_type == TOKEN_NOTEQUAL);
+
+  bool is_valid = is_dict_comparison;
 
   // Check if the operator is valid for the given operand types.
   switch (op.token_type) {
   case TOKEN_PLUS:
-    // '+' is valid for number+number or string+string.
-    if ((is_left_numeric && is_right_numeric) || (is_left_stringy && is_right_stringy)) {
+    // '+' is valid for number+number, string+string or element-wise on lists.
+    if ((is_left_numeric && is_right_numeric) || (is_left_stringy && is_right_stringy) || is_list_operation) {
       is_valid = true;
     }
     break;
 
-  // These operators are only valid for numbers.
+  // These operators also apply element-wise to lists.
   case TOKEN_MINUS:
   case TOKEN_STAR:
   case TOKEN_SLASH:
+  case TOKEN_POW:
+    if ((is_left_numeric && is_right_numeric) || is_list_operation) {
+      is_valid = true;
+    }
+    break;
+
+  // These operators are only valid for numbers.
+  case TOKEN_ELLIPSIS:
   case TOKEN_DOUBLEPERCENT:
   case TOKEN_PERCENT:
-  case TOKEN_POW:
   case TOKEN_LEFTSHIFT:
   case TOKEN_RIGHTSHIFT:
   case TOKEN_AMPERSAND:
@@ -149,7 +257,7 @@ Node *create_binary_op_node(Token op, Node *left, Node *right) {
   case TOKEN_LESSEQUAL:
   case TOKEN_GREATER:
   case TOKEN_GREATEREQUAL:
-    if ((is_left_numeric && is_right_numeric) || (is_left_stringy && is_right_stringy)) {
+    if ((is_left_numeric && is_right_numeric) || (is_left_stringy && is_right_stringy) || is_list_operation) {
       is_valid = true;
     }
     break;
@@ -188,18 +296,41 @@ Node *create_binary_op_node(Token op, Node *left, Node *right) {
   if (!is_valid) {
     if (!ctx->has_syntax_error) {
       ctx->has_syntax_error = 1;
-      const char *left_str = token_type_to_string(left->token.token_type);
-      const char *right_str = token_type_to_string(right->token.token_type);
-
-      print_log(
-          LOG_ERROR, ERR_TYPE_OP_NOT_SUPPORTED, (LogPosition){op.token_line, op.token_index + 1}, op.token_value, op.token_value, left_str ? left_str : "unknown", right_str ? right_str : "unknown");
+      print_log(LOG_ERROR, ERR_TYPE_OP_NOT_SUPPORTED, (LogPosition){op.token_line, op.token_index + 1}, op.token_value, op.token_value, operand_name(left), operand_name(right));
     }
 
     return NULL;
   }
 
+  // A chain of string '+' becomes one concatenation node, so evaluating it
+  // sizes the result once and copies every piece once.
+  if (op.token_type == TOKEN_PLUS && is_left_stringy) {
+    if (left->node_type != NODE_CONCAT) {
+      Node *concat = new_node();
+      concat->node_type = NODE_CONCAT;
+      concat->expression_type = NODE_STRING;
+      concat->token = left->token; // Type errors name the first operand.
+      concat->concat.op = op;
+      concat->concat.parts = NULL;
+      concat->concat.count = 0;
+      concat->concat.capacity = 0;
+      append_part(concat, left);
+      left = concat;
+    }
+    if (right->node_type == NODE_CONCAT) {
+      // A parenthesized chain joins this one.
+      for (size_t i = 0; i < right->concat.count; i++)
+        append_part(left, right->concat.parts[i]);
+      free(right->concat.parts);
+      free(right);
+    } else {
+      append_part(left, right);
+    }
+    return left;
+  }
+
   // Create and return the new binary operation node.
-  Node *node = safe_malloc(sizeof(Node));
+  Node *node = new_node();
   if (!node) {
     free_node(left);
     free_node(right);
@@ -207,9 +338,20 @@ Node *create_binary_op_node(Token op, Node *left, Node *right) {
   }
 
   node->node_type = NODE_BINARY_OP;
+  if (op.token_type == TOKEN_ELLIPSIS)
+    node->expression_type = NODE_RANGE;
+  else if (is_list_operation)
+    node->expression_type = range_result(op.token_type, left_type, right_type);
+  else if ((is_left_numeric && is_right_numeric) || is_dict_comparison)
+    node->expression_type = NODE_NUMBER;
+  else if (is_left_stringy && is_right_stringy)
+    node->expression_type = NODE_STRING;
+  else
+    node->expression_type = NODE_NULL; // Incompatible types.
   node->binary.left = left;
   node->binary.right = right;
   node->binary.op = op;
+  node->binary.power = op.token_type == TOKEN_POW ? power_kind(right, &node->binary.exponent) : POWER_ANY;
 
   return node;
 }
@@ -217,8 +359,9 @@ Node *create_binary_op_node(Token op, Node *left, Node *right) {
 // Creates a unary (prefix) operation node for the AST.
 Node *create_unary_op_node(Token op, Node *operand) {
   debug_func("");
-  Node *node = safe_malloc(sizeof(Node));
+  Node *node = new_node();
   node->node_type = NODE_UNARY_OP;
+  node->expression_type = operand ? operand->expression_type : NODE_NULL;
   node->unary.op = op;
   node->unary.operand = operand;
   return node;
@@ -227,30 +370,170 @@ Node *create_unary_op_node(Token op, Node *operand) {
 // Creates a postfix operation node for the AST.
 Node *create_postfix_op_node(Token op, Node *operand) {
   debug_func("");
-  Node *node = safe_malloc(sizeof(Node));
+  Node *node = new_node();
   node->node_type = NODE_POSTFIX_OP;
+  node->expression_type = operand ? operand->expression_type : NODE_NULL;
   node->unary.op = op;
   node->unary.operand = operand;
   return node;
 }
 
+// Creates an empty list literal node; `token` is its opening bracket.
+Node *create_list_node(Token token) {
+  debug_func("");
+  Node *node = new_node();
+  node->node_type = NODE_LIST;
+  node->expression_type = NODE_LIST;
+  node->token = token;
+  node->list.items = NULL;
+  node->list.count = 0;
+  node->list.capacity = 0;
+  return node;
+}
+
+// Returns a token with `token_index` set to the column it starts at. The
+// lexer places numbers at their first byte counting from 0, and names and
+// keywords at the byte after them.
+static Token token_start(Token token) {
+  switch (token.token_type) {
+  case TOKEN_INT:
+  case TOKEN_FLOAT:
+  case TOKEN_BINARY:
+  case TOKEN_OCTAL:
+  case TOKEN_HEX: token.token_index++; break;
+  case TOKEN_IDENTIFIER:
+  case TOKEN_KEYWORD:
+  case TOKEN_TRUE:
+  case TOKEN_FALSE:
+  case TOKEN_NULL: token.token_index -= strlen(token.token_value) - 1; break;
+  // A decoded literal is no guide to its width in the source.
+  case TOKEN_STRING:
+  case TOKEN_CHAR: token.token_value = ""; break;
+  default: break;
+  }
+  return token;
+}
+
+// Returns the first token of an expression, placed by `token_start`.
+Token node_start(const Node *node) {
+  switch (node->node_type) {
+  case NODE_BINARY_OP: return node_start(node->binary.left);
+  case NODE_POSTFIX_OP: return node_start(node->unary.operand);
+  case NODE_UNARY_OP: return node->unary.op;
+  case NODE_CONCAT: return node_start(node->concat.parts[0]);
+  case NODE_CALL: return token_start(node->call.name);
+  default: return token_start(node->token);
+  }
+}
+
+// Reports an item of a literal that has the wrong type.
+static void reject_item(const Node *item, const char *fmt) {
+  if (ctx->has_syntax_error)
+    return;
+  ctx->has_syntax_error = 1;
+  Token at = node_start(item);
+  print_log(LOG_ERROR, fmt, (LogPosition){at.token_line, at.token_index}, at.token_value, expression_type_name(item->expression_type));
+}
+
+// Appends an item to a list literal. Items are stored packed, so only
+// numbers are accepted; anything else is reported and the item is freed.
+bool append_list_item(Node *list, Node *item) {
+  debug_func("");
+  if (item->expression_type != NODE_NUMBER) {
+    reject_item(item, ERR_LIST_ITEM_TYPE);
+    free_node(item);
+    return false;
+  }
+  append_child(&list->list.items, &list->list.count, &list->list.capacity, item);
+  return true;
+}
+
+// Creates an empty dictionary literal node; `token` is its opening brace.
+Node *create_dict_node(Token token) {
+  debug_func("");
+  Node *node = new_node();
+  node->node_type = NODE_DICT;
+  node->expression_type = NODE_DICT;
+  node->token = token;
+  node->dict.entries = NULL;
+  node->dict.count = 0;
+  node->dict.capacity = 0;
+  return node;
+}
+
+// Appends an entry to a dictionary literal. Keys must be numbers, strings
+// or booleans; otherwise the error is reported and both nodes are freed.
+bool append_dict_entry(Node *dict, Node *key, Node *value) {
+  debug_func("");
+  NodeType type = key->expression_type;
+  if (type != NODE_NUMBER && type != NODE_STRING && type != NODE_CHAR && type != NODE_BOOLEAN) {
+    reject_item(key, ERR_DICT_KEY_TYPE);
+    free_node(key);
+    free_node(value);
+    return false;
+  }
+  append_child(&dict->dict.entries, &dict->dict.count, &dict->dict.capacity, key);
+  append_child(&dict->dict.entries, &dict->dict.count, &dict->dict.capacity, value);
+  return true;
+}
+
+// Creates a call of the builtin named by `name`, with no arguments yet.
+// Reports an error and returns NULL if there is no such builtin.
+Node *create_call_node(Token name) {
+  debug_func("");
+  Builtin builtin;
+  if (!find_builtin(name.token_value, &builtin)) {
+    if (!ctx->has_syntax_error) {
+      ctx->has_syntax_error = 1;
+      Token start = token_start(name);
+      print_log(LOG_ERROR, ERR_UNKNOWN_FUNCTION, (LogPosition){start.token_line, start.token_index}, name.token_value, name.token_value);
+    }
+    return NULL;
+  }
+  Node *node = new_node();
+  node->node_type = NODE_CALL;
+  node->expression_type = builtin == BUILTIN_CONTAINS ? NODE_BOOLEAN : NODE_NUMBER;
+  node->token = name;
+  node->call.args = NULL;
+  node->call.count = 0;
+  node->call.capacity = 0;
+  node->call.name = name;
+  node->call.builtin = builtin;
+  return node;
+}
+
+// Appends an argument to a call.
+void append_call_argument(Node *call, Node *arg) { append_child(&call->call.args, &call->call.count, &call->call.capacity, arg); }
+
+// Checks that a call has as many arguments as its builtin takes.
+bool check_call(Node *call) {
+  debug_func("");
+  size_t arity = builtin_arity((Builtin)call->call.builtin);
+  if (call->call.count == arity)
+    return true;
+  if (!ctx->has_syntax_error) {
+    ctx->has_syntax_error = 1;
+    Token name = call->call.name, start = token_start(name);
+    print_log(LOG_ERROR, ERR_ARGUMENT_COUNT, (LogPosition){start.token_line, start.token_index}, name.token_value, name.token_value, arity, call->call.count);
+  }
+  return false;
+}
+
 // Recursively frees an AST node and all its children.
 void free_node(Node *node) {
+  // Walk down left operands in a loop: a long chain such as `1 + 2 + ...`
+  // nests as deep as it is long.
+  while (node && node->node_type == NODE_BINARY_OP) {
+    Node *left = node->binary.left;
+    free_node(node->binary.right);
+    free(node);
+    node = left;
+  }
   if (!node)
     return;
 
   switch (node->node_type) {
-  case NODE_BINARY_OP:
-    // Free left and right children.
-    if (node->binary.left) {
-      free_node(node->binary.left);
-      node->binary.left = NULL;
-    }
-    if (node->binary.right) {
-      free_node(node->binary.right);
-      node->binary.right = NULL;
-    }
-    break;
+  case NODE_BIGINT: free(node->bigint_value); break;
   case NODE_POSTFIX_OP:
   case NODE_UNARY_OP:
     // Free the single operand.
@@ -259,15 +542,33 @@ void free_node(Node *node) {
       node->unary.operand = NULL;
     }
     break;
+  case NODE_CONCAT:
+    // Free every operand of the chain.
+    for (size_t i = 0; i < node->concat.count; i++)
+      free_node(node->concat.parts[i]);
+    free(node->concat.parts);
+    break;
+  case NODE_LIST:
+    // Free every item of the list.
+    for (size_t i = 0; i < node->list.count; i++)
+      free_node(node->list.items[i]);
+    free(node->list.items);
+    break;
+  case NODE_DICT:
+    // Free every key and value of the dictionary.
+    for (size_t i = 0; i < node->dict.count; i++)
+      free_node(node->dict.entries[i]);
+    free(node->dict.entries);
+    break;
+  case NODE_CALL:
+    // Free every argument of the call.
+    for (size_t i = 0; i < node->call.count; i++)
+      free_node(node->call.args[i]);
+    free(node->call.args);
+    break;
   default: break;
   }
 
-  // Free string value for string/char nodes.
-  if ((node->node_type == NODE_STRING || node->node_type == NODE_CHAR) && node->string_value) {
-    free(node->string_value);
-    node->string_value = NULL;
-  }
-
   // Free the node itself.
   free(node);
 }
@@ -275,6 +576,70 @@ void free_node(Node *node) {
 // Forward declaration for the internal recursive printing function.
 static void print_ast_recursive(Node *node, const char *prefix, bool is_last);
 
+// Points `children` at the children of a node and returns how many there
+// are. Binary and unary nodes collect theirs in `pair`; leaf nodes (like
+// numbers, strings) have none.
+static size_t get_children(Node *node, Node **pair, Node ***children) {
+  size_t count = 0;
+  *children = pair;
+  switch (node->node_type) {
+  case NODE_BINARY_OP:
+    if (node->binary.left)
+      pair[count++] = node->binary.left;
+    if (node->binary.right)
+      pair[count++] = node->binary.right;
+    break;
+  case NODE_UNARY_OP:
+  case NODE_POSTFIX_OP:
+    if (node->unary.operand)
+      pair[count++] = node->unary.operand;
+    break;
+  case NODE_CONCAT:
+    *children = node->concat.parts;
+    count = node->concat.count;
+    break;
+  case NODE_LIST:
+    *children = node->list.items;
+    count = node->list.count;
+    break;
+  case NODE_DICT:
+    *children = node->dict.entries;
+    count = node->dict.count;
+    break;
+  case NODE_CALL:
+    *children = node->call.args;
+    count = node->call.count;
+    break;
+  default: break;
+  }
+  return count;
+}
+
+// Prints a string or char literal as source text, escaping the bytes that
+// would not read back as themselves.
+static void print_literal(const Node *node) {
+  char quote = node->node_type == NODE_CHAR ? '\'' : '"';
+  fputc(quote, ni->out_stream);
+  for (size_t i = 0, length = literal_length(node); i < length; i++) {
+    unsigned char c = (unsigned char)node->string_value[i];
+    switch (c) {
+    case '\n': fputs("\\n", ni->out_stream); break;
+    case '\t': fputs("\\t", ni->out_stream); break;
+    case '\r': fputs("\\r", ni->out_stream); break;
+    case '\0': fputs("\\0", ni->out_stream); break;
+    case '\\': fputs("\\\\", ni->out_stream); break;
+    default:
+      if (c == (unsigned char)quote)
+        fprintf(ni->out_stream, "\\%c", quote);
+      else if (c < 0x20 || c == 0x7f)
+        fprintf(ni->out_stream, "\\x%02x", c);
+      else
+        fputc(c, ni->out_stream);
+    }
+  }
+  fputc(quote, ni->out_stream);
+}
+
 // Helper function to print the string representation of a single node's value.
 // This function avoids printing any tree-formatting characters or newlines.
 static void print_node_value(Node *node) {
@@ -282,68 +647,75 @@ static void print_node_value(Node *node) {
     return;
 
   switch (node->node_type) {
-  case NODE_NUMBER: printf("%g", node->number_value); break;
+  case NODE_NUMBER: fprintf(ni->out_stream, "%g", node->number_value); break;
+  case NODE_INTEGER: fprintf(ni->out_stream, "%" PRId64, node->integer_value); break;
+  case NODE_BIGINT: fputs(node->token.token_value, ni->out_stream); break;
   case NODE_CHAR:
-  case NODE_STRING: printf("%s", node->string_value); break;
-  case NODE_BOOLEAN: printf("%s", node->boolean_value ? "true" : "false"); break;
-  case NODE_NULL: printf("null"); break;
+  case NODE_STRING: print_literal(node); break;
+  case NODE_BOOLEAN: fprintf(ni->out_stream, "%s", node->boolean_value ? "true" : "false"); break;
+  case NODE_NULL: fprintf(ni->out_stream, "null"); break;
   case NODE_BINARY_OP:
     switch (node->binary.op.token_type) {
-    case TOKEN_PLUS: printf("+"); break;
-    case TOKEN_MINUS: printf("-"); break;
-    case TOKEN_STAR: printf("*"); break;
-    case TOKEN_SLASH: printf("/"); break;
-    case TOKEN_DOUBLEPERCENT: printf("%%"); break;
-    case TOKEN_PERCENT: printf("%%"); break;
-    case TOKEN_POW: printf("**"); break;
-    case TOKEN_LEFTSHIFT: printf("<<"); break;
-    case TOKEN_RIGHTSHIFT: printf(">>"); break;
-    case TOKEN_AMPERSAND: printf("&"); break;
-    case TOKEN_CARET: printf("^"); break;
-    case TOKEN_PIPE: printf("|"); break;
-    case TOKEN_EQEQUAL: printf("=="); break;
-    case TOKEN_NOTEQUAL: printf("!="); break;
-    case TOKEN_LESSEQUAL: printf("<="); break;
-    case TOKEN_GREATEREQUAL: printf(">="); break;
-    case TOKEN_LESS: printf("<"); break;
-    case TOKEN_GREATER: printf(">"); break;
-    case TOKEN_AND: printf("&&"); break;
-    case TOKEN_OR: printf("||"); break;
-    case TOKEN_EQUAL: printf("="); break;
-    case TOKEN_PLUSEQUAL: printf("+="); break;
-    case TOKEN_MINEQUAL: printf("-="); break;
-    case TOKEN_STAREQUAL: printf("*="); break;
-    case TOKEN_SLASHEQUAL: printf("/="); break;
-    case TOKEN_PERCENTEQUAL: printf("%%="); break;
-    case TOKEN_AMPERSANDEQUAL: printf("&=\n"); break;
-    case TOKEN_PIPEEQUAL: printf("|="); break;
-    case TOKEN_CARETEQUAL: printf("^="); break;
-    case TOKEN_LEFTSHIFTEQUAL: printf("<<="); break;
-    case TOKEN_RIGHTSHIFTEQUAL: printf(">>="); break;
-    case TOKEN_DOUBLESTAREQUAL: printf("**="); break;
-    case TOKEN_DOUBLEPERCENTEQUAL: printf("%%="); break;
-    default: printf("?"); break;
+    case TOKEN_PLUS: fprintf(ni->out_stream, "+"); break;
+    case TOKEN_MINUS: fprintf(ni->out_stream, "-"); break;
+    case TOKEN_STAR: fprintf(ni->out_stream, "*"); break;
+    case TOKEN_SLASH: fprintf(ni->out_stream, "/"); break;
+    case TOKEN_DOUBLEPERCENT: fprintf(ni->out_stream, "%%"); break;
+    case TOKEN_PERCENT: fprintf(ni->out_stream, "%%"); break;
+    case TOKEN_POW: fprintf(ni->out_stream, "**"); break;
+    case TOKEN_LEFTSHIFT: fprintf(ni->out_stream, "<<"); break;
+    case TOKEN_RIGHTSHIFT: fprintf(ni->out_stream, ">>"); break;
+    case TOKEN_AMPERSAND: fprintf(ni->out_stream, "&"); break;
+    case TOKEN_CARET: fprintf(ni->out_stream, "^"); break;
+    case TOKEN_PIPE: fprintf(ni->out_stream, "|"); break;
+    case TOKEN_EQEQUAL: fprintf(ni->out_stream, "=="); break;
+    case TOKEN_NOTEQUAL: fprintf(ni->out_stream, "!="); break;
+    case TOKEN_LESSEQUAL: fprintf(ni->out_stream, "<="); break;
+    case TOKEN_GREATEREQUAL: fprintf(ni->out_stream, ">="); break;
+    case TOKEN_LESS: fprintf(ni->out_stream, "<"); break;
+    case TOKEN_GREATER: fprintf(ni->out_stream, ">"); break;
+    case TOKEN_ELLIPSIS: fprintf(ni->out_stream, "..."); break;
+    case TOKEN_AND: fprintf(ni->out_stream, "&&"); break;
+    case TOKEN_OR: fprintf(ni->out_stream, "||"); break;
+    case TOKEN_EQUAL: fprintf(ni->out_stream, "="); break;
+    case TOKEN_PLUSEQUAL: fprintf(ni->out_stream, "+="); break;
+    case TOKEN_MINEQUAL: fprintf(ni->out_stream, "-="); break;
+    case TOKEN_STAREQUAL: fprintf(ni->out_stream, "*="); break;
+    case TOKEN_SLASHEQUAL: fprintf(ni->out_stream, "/="); break;
+    case TOKEN_PERCENTEQUAL: fprintf(ni->out_stream, "%%="); break;
+    case TOKEN_AMPERSANDEQUAL: fprintf(ni->out_stream, "&=\n"); break;
+    case TOKEN_PIPEEQUAL: fprintf(ni->out_stream, "|="); break;
+    case TOKEN_CARETEQUAL: fprintf(ni->out_stream, "^="); break;
+    case TOKEN_LEFTSHIFTEQUAL: fprintf(ni->out_stream, "<<="); break;
+    case TOKEN_RIGHTSHIFTEQUAL: fprintf(ni->out_stream, ">>="); break;
+    case TOKEN_DOUBLESTAREQUAL: fprintf(ni->out_stream, "**="); break;
+    case TOKEN_DOUBLEPERCENTEQUAL: fprintf(ni->out_stream, "%%="); break;
+    default: fprintf(ni->out_stream, "?"); break;
     }
     break;
   case NODE_UNARY_OP:
     switch (node->unary.op.token_type) {
-    case TOKEN_PLUS: printf("+ (unary)"); break;
-    case TOKEN_MINUS: printf("- (unary)"); break;
-    case TOKEN_NOT: printf("! (unary)"); break;
-    case TOKEN_TILDE: printf("~ (unary)"); break;
-    case TOKEN_INCREMENT: printf("++ (prefix)"); break;
-    case TOKEN_DECREMENT: printf("-- (prefix)"); break;
-    default: printf("? (unary)"); break;
+    case TOKEN_PLUS: fprintf(ni->out_stream, "+ (unary)"); break;
+    case TOKEN_MINUS: fprintf(ni->out_stream, "- (unary)"); break;
+    case TOKEN_NOT: fprintf(ni->out_stream, "! (unary)"); break;
+    case TOKEN_TILDE: fprintf(ni->out_stream, "~ (unary)"); break;
+    case TOKEN_INCREMENT: fprintf(ni->out_stream, "++ (prefix)"); break;
+    case TOKEN_DECREMENT: fprintf(ni->out_stream, "-- (prefix)"); break;
+    default: fprintf(ni->out_stream, "? (unary)"); break;
     }
     break;
   case NODE_POSTFIX_OP:
     switch (node->unary.op.token_type) {
-    case TOKEN_INCREMENT: printf("++ (postfix)"); break;
-    case TOKEN_DECREMENT: printf("-- (postfix)"); break;
-    default: printf("? (postfix)"); break;
+    case TOKEN_INCREMENT: fprintf(ni->out_stream, "++ (postfix)"); break;
+    case TOKEN_DECREMENT: fprintf(ni->out_stream, "-- (postfix)"); break;
+    default: fprintf(ni->out_stream, "? (postfix)"); break;
     }
     break;
-  default: printf("Unknown node"); break;
+  case NODE_CONCAT: fprintf(ni->out_stream, "+"); break;
+  case NODE_LIST: fprintf(ni->out_stream, "[] (list)"); break;
+  case NODE_DICT: fprintf(ni->out_stream, "{} (dict)"); break;
+  case NODE_CALL: fprintf(ni->out_stream, "%s()", node->call.name.token_value); break;
+  default: fprintf(ni->out_stream, "Unknown node"); break;
   }
 }
 
@@ -359,31 +731,16 @@ void print_ast(Node *node) {
 
   // Print the root node's value first, as it has no prefix.
   print_node_value(node);
-  printf("\n");
+  fputc('\n', ni->out_stream);
 
-  // Collect direct children of the root into a temporary array.
+  // Collect direct children of the root.
   // This is needed to know which child is the last one for proper formatting.
-  Node *children[2] = {NULL, NULL};
-  int num_children = 0;
-
-  switch (node->node_type) {
-  case NODE_BINARY_OP:
-    if (node->binary.left)
-      children[num_children++] = node->binary.left;
-    if (node->binary.right)
-      children[num_children++] = node->binary.right;
-    break;
-  case NODE_UNARY_OP:
-  case NODE_POSTFIX_OP:
-    if (node->unary.operand)
-      children[num_children++] = node->unary.operand;
-    break;
-  // Leaf nodes (like numbers, strings) have no children.
-  default: break;
-  }
+  Node *pair[2];
+  Node **children;
+  size_t num_children = get_children(node, pair, &children);
 
   // Start the recursion for the children.
-  for (int i = 0; i < num_children; i++) {
+  for (size_t i = 0; i < num_children; i++) {
     bool is_last = (i == num_children - 1);
     // The initial prefix for the root's children is an empty string.
     print_ast_recursive(children[i], "", is_last);
@@ -397,10 +754,10 @@ static void print_ast_recursive(Node *node, const char *prefix, bool is_last) {
     return;
 
   // Print the prefix and branch connector for the current line.
-  printf("%s", prefix);
-  printf("%s", is_last ? "└── " : "├── ");
+  fprintf(ni->out_stream, "%s", prefix);
+  fprintf(ni->out_stream, "%s", is_last ? "└── " : "├── ");
   print_node_value(node);
-  printf("\n");
+  fputc('\n', ni->out_stream);
 
   // Prepare the prefix for the next level of children.
   // A new string is dynamically allocated to append the next segment.
@@ -412,26 +769,12 @@ static void print_ast_recursive(Node *node, const char *prefix, bool is_last) {
   strcat(child_prefix, is_last ? "    " : "│   ");
 
   // Collect children of the current node.
-  Node *children[2] = {NULL, NULL};
-  int num_children = 0;
-
-  switch (node->node_type) {
-  case NODE_BINARY_OP:
-    if (node->binary.left)
-      children[num_children++] = node->binary.left;
-    if (node->binary.right)
-      children[num_children++] = node->binary.right;
-    break;
-  case NODE_UNARY_OP:
-  case NODE_POSTFIX_OP:
-    if (node->unary.operand)
-      children[num_children++] = node->unary.operand;
-    break;
-  default: break; // Leaf node.
-  }
+  Node *pair[2];
+  Node **children;
+  size_t num_children = get_children(node, pair, &children);
 
   // Recurse for each child.
-  for (int i = 0; i < num_children; i++) {
+  for (size_t i = 0; i < num_children; i++) {
     print_ast_recursive(children[i], child_prefix, (i == num_children - 1));
   }
 
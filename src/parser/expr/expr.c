@@ -95,7 +95,14 @@ Node *parse_equality(void) {
 Node *parse_relational(void) {
   debug_func("");
   TokenType operators[] = {TOKEN_LESS, TOKEN_LESSEQUAL, TOKEN_GREATER, TOKEN_GREATEREQUAL};
-  return parse_binary_operator(4, operators, parse_shift);
+  return parse_binary_operator(4, operators, parse_range);
+}
+
+// Parses the range operator (...), e.g. `0 ... 9`.
+Node *parse_range(void) {
+  debug_func("");
+  TokenType operators[] = {TOKEN_ELLIPSIS};
+  return parse_binary_operator(1, operators, parse_shift);
 }
 
 // Parses bitwise shift operators (<<, >>).
@@ -1,15 +1,162 @@
 // parser/expr/factor.c
 // This file parses the most basic elements of an expression, known as
 // "factors". Factors are the highest-precedence elements and include literals
-// (numbers, strings), and expressions grouped by parentheses.
+// (numbers, strings), list and dictionary literals, builtin calls and
+// expressions grouped by parentheses.
 
 #include "config.h"
 #include "context.h"
+#include "eval/bigint.h"
 #include "lexer/lexer.h"
 #include "lexer/tokens.h"
 #include "parser/ast.h"
 #include "parser/expression.h"
 #include "utils/log.h"
+#include "utils/memory.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reports a malformed literal at the current token.
+static void expected_at_current(const char *fmt) {
+  if (ctx->has_syntax_error)
+    return;
+  ctx->has_syntax_error = 1;
+  const Token *tok = peek(0);
+  LogPosition position = tok ? (LogPosition){tok->token_line, tok->token_index} : (LogPosition){ctx->line_number, ctx->line_index};
+  print_log(LOG_ERROR, fmt, position, "");
+}
+
+// Creates the node for a numeric literal, skipping the `_` separators.
+// Integer literals stay exact: they become 64-bit integers, or big integers
+// when they don't fit.
+static Node *number_literal(Token token) {
+  size_t length = strlen(token.token_value);
+  char stack_digits[64];
+  char *digits = length < sizeof(stack_digits) ? stack_digits : safe_malloc(length + 1);
+  size_t count = 0;
+  for (size_t i = 0; i < length; i++)
+    if (token.token_value[i] != '_')
+      digits[count++] = token.token_value[i];
+  digits[count] = '\0';
+
+  Node *node;
+  if (token.token_type == TOKEN_INT) {
+    int64_t value = 0;
+    bool fits = true;
+    for (size_t i = 0; i < count && fits; i++)
+      fits = !__builtin_mul_overflow(value, 10, &value) && !__builtin_add_overflow(value, digits[i] - '0', &value);
+    node = fits ? create_integer_node(token, value) : create_bigint_node(token, bigint_from_decimal(digits, count));
+  } else {
+    node = create_number_node(token, strtod(digits, NULL));
+  }
+  if (digits != stack_digits)
+    free(digits);
+  return node;
+}
+
+// Parses a list literal such as `[1, 2, 3]`. A trailing comma is allowed.
+static Node *parse_list(void) {
+  debug_func("");
+  Token open = *eat(TOKEN_LBRACKET);
+  Node *list = create_list_node(open);
+  while (!eat(TOKEN_RBRACKET)) {
+    Node *item = parse_assignment();
+    if (!item || !append_list_item(list, item)) {
+      free_node(list);
+      return NULL;
+    }
+    if (eat(TOKEN_COMMA))
+      continue;
+    if (peek(0) && peek(0)->token_type == TOKEN_RBRACKET)
+      continue;
+    // Anything else after an item is an unterminated list.
+    expected_at_current(ERR_EXPECTED_LIST_END);
+    free_node(list);
+    return NULL;
+  }
+  return list;
+}
+
+// Parses the entries of a dictionary literal after its first key, such as
+// `{"a": 1, "b": 2}`. A trailing comma is allowed.
+static Node *parse_dict(Token open, Node *key) {
+  debug_func("");
+  Node *dict = create_dict_node(open);
+  for (;;) {
+    if (!eat(TOKEN_COLON)) {
+      expected_at_current(ERR_EXPECTED_DICT_COLON);
+      free_node(key);
+      break;
+    }
+    Node *value = parse_assignment();
+    if (!value) {
+      free_node(key);
+      break;
+    }
+    if (!append_dict_entry(dict, key, value))
+      break;
+    if (!eat(TOKEN_COMMA) && !(peek(0) && peek(0)->token_type == TOKEN_RBRACE)) {
+      expected_at_current(ERR_EXPECTED_DICT_END);
+      break;
+    }
+    if (eat(TOKEN_RBRACE))
+      return dict;
+    if (!(key = parse_assignment()))
+      break;
+  }
+  free_node(dict);
+  return NULL;
+}
+
+// Parses a brace: `{}` and `{key: value, ...}` are dictionaries, and
+// `{expression}` groups like parentheses.
+static Node *parse_brace(void) {
+  debug_func("");
+  Token open = *eat(TOKEN_LBRACE);
+  if (eat(TOKEN_RBRACE))
+    return create_dict_node(open);
+  Node *node = parse_assignment();
+  if (!node)
+    return NULL;
+  if (peek(0) && peek(0)->token_type == TOKEN_COLON)
+    return parse_dict(open, node);
+  if (!eat(TOKEN_RBRACE)) {
+    free_node(node);
+    return NULL;
+  }
+  return node;
+}
+
+// Parses a builtin call such as `len(x)`.
+static Node *parse_call(void) {
+  debug_func("");
+  Token name = *eat(TOKEN_IDENTIFIER);
+  eat(TOKEN_LPAREN);
+  Node *call = create_call_node(name);
+  if (!call)
+    return NULL;
+  while (!eat(TOKEN_RPAREN)) {
+    Node *arg = parse_assignment();
+    if (!arg) {
+      free_node(call);
+      return NULL;
+    }
+    append_call_argument(call, arg);
+    if (eat(TOKEN_COMMA))
+      continue;
+    if (peek(0) && peek(0)->token_type == TOKEN_RPAREN)
+      continue;
+    expected_at_current(ERR_EXPECTED_CALL_END);
+    free_node(call);
+    return NULL;
+  }
+  if (!check_call(call)) {
+    free_node(call);
+    return NULL;
+  }
+  return call;
+}
 
 // Parses a factor.
 Node *parse_factor(void) {
@@ -30,7 +177,7 @@ Node *parse_factor(void) {
   case TOKEN_FLOAT:
   case TOKEN_HEX:
   case TOKEN_BINARY:
-  case TOKEN_OCTAL: eat(tok->token_type); return create_number_node(*tok, strtod(tok->token_value, NULL));
+  case TOKEN_OCTAL: eat(tok->token_type); return number_literal(*tok);
   // Handle string literal.
   case TOKEN_STRING: eat(TOKEN_STRING); return create_string_node(*tok, tok->token_value);
   // Handle character literal.
@@ -44,18 +191,10 @@ Node *parse_factor(void) {
     return create_null_node(*tok);
     // Handle grouped expressions, fixing fallthrough and bracket matching logic.
   case TOKEN_LPAREN:
-  case TOKEN_LBRACE:
-  case TOKEN_LBRACKET:
 
   {
     TokenType open_bracket_type = tok->token_type;
-    TokenType close_bracket_type;
-    if (open_bracket_type == TOKEN_LPAREN)
-      close_bracket_type = TOKEN_RPAREN;
-    else if (open_bracket_type == TOKEN_LBRACE)
-      close_bracket_type = TOKEN_RBRACE;
-    else
-      close_bracket_type = TOKEN_RBRACKET; /* TOKEN_LBRACKET */
+    TokenType close_bracket_type = TOKEN_RPAREN;
 
     eat(open_bracket_type); // Consume the opening bracket.
 
@@ -76,7 +215,17 @@ Node *parse_factor(void) {
     }
     return node;
   }
+  // Handle list literals.
+  case TOKEN_LBRACKET: return parse_list();
+  // Handle dictionary literals and brace groups.
+  case TOKEN_LBRACE: return parse_brace();
+  // Handle builtin calls.
+  case TOKEN_IDENTIFIER:
+    if (peek(1) && peek(1)->token_type == TOKEN_LPAREN)
+      return parse_call();
+    goto unexpected;
   default:
+  unexpected:
     // If no factor matches, it's a syntax error.
     if (!ctx->has_syntax_error) {
       ctx->has_syntax_error = 1;
@@ -0,0 +1,276 @@
+// server.c
+// This file implements daemon mode (`noon --serve path`). The server keeps
+// a pool of warm interpreter contexts, accepts clients on a Unix domain
+// socket and runs each connection on its own thread. A connection borrows a
+// context from the pool for its lifetime and returns it afterwards, so
+// requests pay neither process startup nor context initialization.
+
+#include "server.h"
+#include "batch.h"
+#include "config.h"
+#include "context.h"
+#include "eval/value.h"
+#include "input.h"
+#include "lexer/lexer.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A warm context and input state, ready to serve a connection.
+typedef struct ServeWorker {
+  NoonContext *context;
+  NoonInput *input;
+  struct ServeWorker *next;
+} ServeWorker;
+
+// Idle workers, shared by all connections.
+static ServeWorker *idle_workers = NULL;
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static const char *serve_program_name = NULL;
+// Path of the listening socket, removed when a signal stops the server.
+static char serve_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+// Creates a worker with a fresh context and input state.
+static ServeWorker *create_worker(void) {
+  ServeWorker *worker = safe_calloc(1, sizeof(ServeWorker));
+  worker->context = create_context();
+  worker->input = create_input();
+  worker->input->program_name = serve_program_name;
+  worker->input->input = "<string>";
+  return worker;
+}
+
+// Takes an idle worker from the pool, or creates one if none is left.
+static ServeWorker *acquire_worker(void) {
+  pthread_mutex_lock(&idle_lock);
+  ServeWorker *worker = idle_workers;
+  if (worker)
+    idle_workers = worker->next;
+  pthread_mutex_unlock(&idle_lock);
+  return worker ? worker : create_worker();
+}
+
+// Returns a worker to the pool.
+static void release_worker(ServeWorker *worker) {
+  pthread_mutex_lock(&idle_lock);
+  worker->next = idle_workers;
+  idle_workers = worker;
+  pthread_mutex_unlock(&idle_lock);
+}
+
+// Reads exactly `size` bytes. Returns false on EOF or error.
+static bool read_full(int fd, void *buffer, size_t size) {
+  char *p = buffer;
+  while (size > 0) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+// Writes exactly `size` bytes. Returns false on error.
+static bool write_full(int fd, const void *buffer, size_t size) {
+  const char *p = buffer;
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+// Encodes a message header.
+static void encode_header(unsigned char *header, unsigned char kind, uint32_t length) {
+  memcpy(header, SERVE_MAGIC, 4);
+  header[4] = kind;
+  header[5] = header[6] = header[7] = 0;
+  header[8] = (unsigned char)(length >> 24);
+  header[9] = (unsigned char)(length >> 16);
+  header[10] = (unsigned char)(length >> 8);
+  header[11] = (unsigned char)length;
+}
+
+// Sends a response with the given status and body.
+static bool send_response(int fd, ServeStatus status, const char *body, size_t length) {
+  unsigned char header[SERVE_HEADER_SIZE];
+  encode_header(header, (unsigned char)status, (uint32_t)length);
+  return write_full(fd, header, sizeof(header)) && write_full(fd, body, length);
+}
+
+// Runs one request with the thread's selected context, writing everything
+// the command line would print into `out`. Returns the response status.
+static ServeStatus run_request(ServeMode mode, const char *source, size_t length, FILE *out) {
+  reset_context(ctx);
+  ni->out_stream = out;
+  ni->log_stream = out;
+  ni->dump_tokens = mode == SERVE_TOKENS;
+  ni->dump_ast = mode == SERVE_AST;
+  ni->check_syntax = mode != SERVE_EVAL;
+
+  lex_source(source, length);
+  print_logs();
+  if (ctx->total_errors || ctx->total_warnings || ctx->total_infos)
+    print_summary();
+  else if (mode == SERVE_EVAL && ctx->result.value_type != VALUE_NULL) {
+    print_value(out, ctx->result);
+    fputc('\n', out);
+  }
+  flush_logs();
+  return ctx->total_errors ? SERVE_ERROR : SERVE_OK;
+}
+
+// Serves the requests of one client until it disconnects.
+static void *serve_connection(void *arg) {
+  int fd = (int)(intptr_t)arg;
+  ServeWorker *worker = acquire_worker();
+  ctx = worker->context;
+  ni = worker->input;
+
+  char *source = NULL;
+  size_t source_capacity = 0;
+  unsigned char header[SERVE_HEADER_SIZE];
+  while (read_full(fd, header, sizeof(header))) {
+    uint32_t length = (uint32_t)header[8] << 24 | (uint32_t)header[9] << 16 | (uint32_t)header[10] << 8 | header[11];
+    if (memcmp(header, SERVE_MAGIC, 4) != 0 || header[4] > SERVE_EVAL || length > SERVE_MAX_REQUEST) {
+      static const char message[] = "bad request\n";
+      send_response(fd, SERVE_BAD_REQUEST, message, sizeof(message) - 1);
+      break;
+    }
+    if (length + 1 > source_capacity) {
+      source_capacity = length + 1;
+      source = safe_realloc(source, source_capacity);
+    }
+    if (!read_full(fd, source, length))
+      break;
+    source[length] = '\0';
+
+    char *body = NULL;
+    size_t body_size = 0;
+    FILE *out = open_memstream(&body, &body_size);
+    if (!out)
+      break;
+    ServeStatus status = run_request((ServeMode)header[4], source, length, out);
+    fclose(out);
+    bool sent = send_response(fd, status, body, body_size);
+    free(body);
+    if (!sent)
+      break;
+  }
+
+  free(source);
+  close(fd);
+  reset_context(ctx);
+  ctx = NULL;
+  ni = NULL;
+  release_worker(worker);
+  return NULL;
+}
+
+// Removes the socket and stops the server with the signal it received.
+static void stop_serving(int sig) {
+  unlink(serve_path);
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+// Listens on `path` and serves requests until the process is terminated.
+int serve(const char *path) {
+  debug_func("path: %s", path);
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, ERR_SERVE_SOCKET, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, path, strerror(ENAMETOOLONG));
+    return EXIT_FAILURE;
+  }
+  strcpy(address.sun_path, path);
+
+  // Remove a socket left behind by a previous server, but never anything
+  // else that happens to live at the path.
+  struct stat st;
+  if (lstat(path, &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      fprintf(stderr, ERR_SERVE_SOCKET, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, path, strerror(EEXIST));
+      return EXIT_FAILURE;
+    }
+    unlink(path);
+  }
+
+  // Only the user running the server may connect to it.
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  mode_t mask = umask(0177);
+  bool bound = listener >= 0 && bind(listener, (struct sockaddr *)&address, sizeof(address)) == 0;
+  int error = errno;
+  umask(mask);
+  if (!bound || listen(listener, SOMAXCONN) < 0) {
+    fprintf(stderr, ERR_SERVE_SOCKET, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, path, strerror(bound ? errno : error));
+    if (listener >= 0)
+      close(listener);
+    if (bound)
+      unlink(path);
+    return EXIT_FAILURE;
+  }
+  strcpy(serve_path, path);
+  signal(SIGTERM, stop_serving);
+  signal(SIGINT, stop_serving);
+
+  // Responses travel over a socket, never to a terminal.
+  disable_colors();
+  signal(SIGPIPE, SIG_IGN);
+  serve_program_name = ni->program_name;
+
+  // Warm up one worker per CPU before accepting clients.
+  for (int i = default_jobs(); i > 0; i--)
+    release_worker(create_worker());
+
+  while (1) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      break;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, serve_connection, (void *)(intptr_t)fd) != 0) {
+      close(fd);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+
+  close(listener);
+  unlink(path);
+  return EXIT_FAILURE;
+}
+
+#else
+
+// Unix domain sockets are not available; report it instead of serving.
+int serve(const char *path) {
+  debug_func("path: %s", path);
+  fprintf(stderr, ERR_SERVE_SOCKET, COLOR_BOLD, ni->program_name, COLOR_RED, COLOR_RESET, COLOR_BOLD, path, "not supported on this platform");
+  return EXIT_FAILURE;
+}
+
+#endif
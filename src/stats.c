@@ -0,0 +1,126 @@
+// stats.c
+// This file implements `--stats`: phase timers around reading, lexing,
+// parsing, evaluation and diagnostics, and the report printed after the
+// run with counts, throughput, peak memory and allocations, as text or as
+// one JSON object.
+
+#include "stats.h"
+#include "config.h"
+#include "context.h"
+#include "input.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Time at which the run started.
+static uint64_t run_start = 0;
+
+// Names of the phases, as printed.
+static const char *const phase_names[STATS_PHASES] = {"read", "lex", "parse", "eval", "diagnostics"};
+
+// Reads the monotonic clock in nanoseconds.
+static uint64_t monotonic_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Starts the run clock and turns on allocation counting.
+void begin_stats(void) {
+  debug_func("");
+  run_start = monotonic_time();
+  count_allocations();
+}
+
+// Returns the current time in nanoseconds, or 0 if statistics are off.
+uint64_t stats_clock(void) { return ni->stats ? monotonic_time() : 0; }
+
+// Adds the time since `start` to a phase.
+void stats_add(StatsPhase phase, uint64_t start) {
+  if (ni->stats)
+    ctx->stats.phase_time[phase] += monotonic_time() - start;
+}
+
+// Adds the counters of one run to another.
+void merge_stats(Stats *into, const Stats *from) {
+  for (int i = 0; i < STATS_PHASES; i++)
+    into->phase_time[i] += from->phase_time[i];
+  into->bytes += from->bytes;
+  into->lines += from->lines;
+  into->tokens += from->tokens;
+  into->nodes += from->nodes;
+}
+
+// Returns the peak resident set size of the process in KiB, or 0 if it is
+// not known.
+static size_t peak_rss(void) {
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return (size_t)usage.ru_maxrss / 1024; // bytes on macOS
+#else
+  return (size_t)usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Prints the statistics of the current context to stderr.
+void print_stats(void) {
+  debug_func("");
+  const Stats *stats = &ctx->stats;
+  double total = (double)(monotonic_time() - run_start) / 1e9;
+  double tokens_per_second = total > 0 ? (double)stats->tokens / total : 0;
+  double megabytes_per_second = total > 0 ? (double)stats->bytes / 1e6 / total : 0;
+  size_t allocations, allocated_bytes;
+  allocation_stats(&allocations, &allocated_bytes);
+
+  if (ni->stats == STATS_JSON) {
+    fputs("{\"time\":{", stderr);
+    for (int i = 0; i < STATS_PHASES; i++)
+      fprintf(stderr, "\"%s\":%.6f,", phase_names[i], (double)stats->phase_time[i] / 1e9);
+    fprintf(stderr,
+            "\"total\":%.6f},\"bytes\":%zu,\"lines\":%zu,\"tokens\":%zu,\"nodes\":%zu,\"tokens_per_second\":%.0f,\"megabytes_per_second\":%.3f,"
+            "\"peak_rss_kib\":%zu,\"allocations\":%zu,\"allocated_bytes\":%zu}\n",
+            total,
+            stats->bytes,
+            stats->lines,
+            stats->tokens,
+            stats->nodes,
+            tokens_per_second,
+            megabytes_per_second,
+            peak_rss(),
+            allocations,
+            allocated_bytes);
+    return;
+  }
+
+  char count[32], extra[32];
+  fprintf(stderr, "%sstatistics:%s\n", COLOR_BOLD, COLOR_RESET);
+  for (int i = 0; i < STATS_PHASES; i++)
+    fprintf(stderr, "  %-12s %10.3f s\n", phase_names[i], (double)stats->phase_time[i] / 1e9);
+  fprintf(stderr, "  %-12s %10.3f s\n", "total", total);
+  format_count(stats->bytes, count, sizeof(count));
+  fprintf(stderr, "  %-12s %s (%.1f MB/s)\n", "bytes", count, megabytes_per_second);
+  format_count(stats->lines, count, sizeof(count));
+  fprintf(stderr, "  %-12s %s\n", "lines", count);
+  format_count(stats->tokens, count, sizeof(count));
+  format_count((size_t)tokens_per_second, extra, sizeof(extra));
+  fprintf(stderr, "  %-12s %s (%s tokens/s)\n", "tokens", count, extra);
+  format_count(stats->nodes, count, sizeof(count));
+  fprintf(stderr, "  %-12s %s\n", "nodes", count);
+  format_count(peak_rss(), count, sizeof(count));
+  fprintf(stderr, "  %-12s %s KiB\n", "peak rss", count);
+  format_count(allocations, count, sizeof(count));
+  format_count(allocated_bytes, extra, sizeof(extra));
+  fprintf(stderr, "  %-12s %s (%s bytes)\n", "allocations", count, extra);
+}
@@ -0,0 +1,110 @@
+// utils/intern.c
+// This file implements the string interning table. Identifiers and string
+// and char literals are looked up here as they are tokenized, so every
+// distinct spelling is hashed and stored once and two tokens with the same
+// spelling share the same bytes and id.
+
+#include "utils/intern.h"
+#include "config.h"
+#include "utils/log.h"
+#include <string.h>
+
+// Hashes a spelling eight bytes at a time.
+static uint64_t hash_spelling(const char *bytes, size_t length) {
+  uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 32;
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, bytes + i, length - i);
+  hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53ULL;
+  return hash ^ (hash >> 29);
+}
+
+// Returns the slot of a spelling: the one holding it, or the empty slot
+// where it belongs.
+static InternSlot *find_slot(const InternTable *table, const char *bytes, size_t length, uint64_t hash) {
+  size_t mask = table->slots_capacity - 1;
+  uint32_t tag = (uint32_t)(hash >> 32);
+  for (size_t slot = (size_t)hash & mask;; slot = (slot + 1) & mask) {
+    InternSlot *entry = &table->slots[slot];
+    if (!entry->id)
+      return entry;
+    if (entry->tag != tag)
+      continue;
+    const InternString *string = &table->strings[entry->id - 1];
+    if (string->length == length && memcmp(string->bytes, bytes, length) == 0)
+      return entry;
+  }
+}
+
+// Doubles the index once it is three quarters full.
+static void grow_slots(InternTable *table) {
+  if (table->slots_capacity && (table->count + 1) * 4 <= table->slots_capacity * 3)
+    return;
+  free(table->slots);
+  table->slots_capacity = table->slots_capacity ? table->slots_capacity * 2 : INTERN_INITIAL_SLOTS;
+  table->slots = safe_calloc(table->slots_capacity, sizeof(InternSlot));
+  size_t mask = table->slots_capacity - 1;
+  for (size_t i = 0; i < table->count; i++) {
+    uint64_t hash = table->strings[i].hash;
+    size_t slot = (size_t)hash & mask;
+    while (table->slots[slot].id)
+      slot = (slot + 1) & mask;
+    table->slots[slot] = (InternSlot){(uint32_t)(i + 1), (uint32_t)(hash >> 32)};
+  }
+}
+
+// Returns the id of a spelling, adding it to the table if it is new.
+uint32_t intern(InternTable *table, const char *bytes, size_t length) {
+  grow_slots(table);
+  uint64_t hash = hash_spelling(bytes, length);
+  InternSlot *slot = find_slot(table, bytes, length, hash);
+  if (slot->id)
+    return slot->id;
+
+  if (table->count == table->capacity) {
+    table->capacity = table->capacity ? table->capacity * 2 : INITIAL_CAPACITY;
+    table->strings = safe_realloc(table->strings, table->capacity * sizeof(InternString));
+  }
+  char *copy = region_alloc(&table->bytes, length + 1);
+  memcpy(copy, bytes, length);
+  copy[length] = '\0';
+  table->bytes_size += length + 1;
+  table->strings[table->count++] = (InternString){copy, length, hash};
+  *slot = (InternSlot){(uint32_t)table->count, (uint32_t)(hash >> 32)};
+  return slot->id;
+}
+
+// Returns the bytes of an interned spelling.
+const char *intern_string(const InternTable *table, uint32_t id) { return table->strings[id - 1].bytes; }
+
+// Returns the length of an interned spelling.
+size_t intern_length(const InternTable *table, uint32_t id) { return table->strings[id - 1].length; }
+
+// Returns the hash of an interned spelling.
+uint64_t intern_hash(const InternTable *table, uint32_t id) { return table->strings[id - 1].hash; }
+
+// Forgets every spelling once they take more than `limit` bytes.
+void intern_trim(InternTable *table, size_t limit) {
+  if (table->bytes_size <= limit)
+    return;
+  debug_func("bytes: %zu", table->bytes_size);
+  if (table->slots)
+    memset(table->slots, 0, table->slots_capacity * sizeof(InternSlot));
+  table->count = 0;
+  region_reset(&table->bytes);
+  table->bytes_size = 0;
+}
+
+// Frees the table and its spellings.
+void intern_free(InternTable *table) {
+  free(table->slots);
+  free(table->strings);
+  region_free(&table->bytes);
+  *table = (InternTable){0};
+}
@@ -0,0 +1,339 @@
+// utils/json.c
+// This file implements a small recursive-descent JSON parser and the
+// matching writer. It supports the full JSON grammar, including \u escapes
+// and surrogate pairs, which are decoded to UTF-8.
+
+#include "utils/json.h"
+#include "config.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Maximum nesting of arrays and objects, to bound the recursion.
+#define JSON_MAX_DEPTH 256
+
+// Cursor over the text being parsed.
+typedef struct {
+  const char *text;
+  size_t length;
+  size_t position;
+  int depth;
+} JsonParser;
+
+static bool parse_value(JsonParser *parser, JsonValue *value);
+
+// Skips whitespace between tokens.
+static void skip_whitespace(JsonParser *parser) {
+  while (parser->position < parser->length) {
+    char c = parser->text[parser->position];
+    if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+      break;
+    parser->position++;
+  }
+}
+
+// Consumes `literal` if the text continues with it.
+static bool match(JsonParser *parser, const char *literal) {
+  size_t length = strlen(literal);
+  if (parser->length - parser->position < length || memcmp(parser->text + parser->position, literal, length) != 0)
+    return false;
+  parser->position += length;
+  return true;
+}
+
+// Reads four hex digits of a \u escape.
+static bool parse_hex4(JsonParser *parser, unsigned *code) {
+  if (parser->length - parser->position < 4)
+    return false;
+  *code = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = parser->text[parser->position++];
+    *code <<= 4;
+    if (c >= '0' && c <= '9')
+      *code |= (unsigned)(c - '0');
+    else if (c >= 'a' && c <= 'f')
+      *code |= (unsigned)(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F')
+      *code |= (unsigned)(c - 'A' + 10);
+    else
+      return false;
+  }
+  return true;
+}
+
+// Appends a code point to a buffer as UTF-8. The buffer has room for it.
+static size_t encode_utf8(char *out, unsigned code) {
+  if (code < 0x80) {
+    out[0] = (char)code;
+    return 1;
+  }
+  if (code < 0x800) {
+    out[0] = (char)(0xC0 | (code >> 6));
+    out[1] = (char)(0x80 | (code & 0x3F));
+    return 2;
+  }
+  if (code < 0x10000) {
+    out[0] = (char)(0xE0 | (code >> 12));
+    out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (code & 0x3F));
+    return 3;
+  }
+  out[0] = (char)(0xF0 | (code >> 18));
+  out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (code & 0x3F));
+  return 4;
+}
+
+// Parses a string; the opening quote has not been consumed yet.
+static bool parse_string(JsonParser *parser, char **string, size_t *string_length) {
+  parser->position++; // opening quote
+  // Decoded text is never longer than the escaped source.
+  size_t start = parser->position;
+  const char *end = memchr(parser->text + start, '"', parser->length - start);
+  size_t capacity = (end ? (size_t)(end - parser->text) : parser->length) - start + 1;
+  char *out = safe_malloc(capacity);
+  size_t out_length = 0;
+
+  while (parser->position < parser->length) {
+    unsigned char c = (unsigned char)parser->text[parser->position++];
+    if (c == '"') {
+      out[out_length] = '\0';
+      *string = out;
+      *string_length = out_length;
+      return true;
+    }
+    if (c < 0x20)
+      break;
+    if (out_length + 4 >= capacity) {
+      capacity *= 2;
+      out = safe_realloc(out, capacity);
+    }
+    if (c != '\\') {
+      out[out_length++] = (char)c;
+      continue;
+    }
+    if (parser->position >= parser->length)
+      break;
+    char escape = parser->text[parser->position++];
+    switch (escape) {
+    case '"': out[out_length++] = '"'; break;
+    case '\\': out[out_length++] = '\\'; break;
+    case '/': out[out_length++] = '/'; break;
+    case 'b': out[out_length++] = '\b'; break;
+    case 'f': out[out_length++] = '\f'; break;
+    case 'n': out[out_length++] = '\n'; break;
+    case 'r': out[out_length++] = '\r'; break;
+    case 't': out[out_length++] = '\t'; break;
+    case 'u': {
+      unsigned code;
+      if (!parse_hex4(parser, &code))
+        goto fail;
+      // Combine a surrogate pair into one code point.
+      if (code >= 0xD800 && code < 0xDC00 && match(parser, "\\u")) {
+        unsigned low;
+        if (!parse_hex4(parser, &low) || low < 0xDC00 || low >= 0xE000)
+          goto fail;
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+      } else if (code >= 0xD800 && code < 0xE000) {
+        code = 0xFFFD; // Lone surrogate.
+      }
+      out_length += encode_utf8(out + out_length, code);
+      break;
+    }
+    default: goto fail;
+    }
+  }
+fail:
+  free(out);
+  return false;
+}
+
+// Parses a number.
+static bool parse_number(JsonParser *parser, JsonValue *value) {
+  size_t start = parser->position;
+  while (parser->position < parser->length && strchr("+-0123456789.eE", parser->text[parser->position]))
+    parser->position++;
+  size_t length = parser->position - start;
+  char buffer[64];
+  if (length == 0 || length >= sizeof(buffer))
+    return false;
+  memcpy(buffer, parser->text + start, length);
+  buffer[length] = '\0';
+  char *end;
+  value->number_value = strtod(buffer, &end);
+  value->json_type = JSON_NUMBER;
+  return *end == '\0';
+}
+
+// Appends a member to an array or object.
+static JsonValue *add_item(JsonValue *value, size_t *capacity) {
+  if (value->items_count >= *capacity) {
+    *capacity = *capacity ? *capacity * 2 : INITIAL_CAPACITY;
+    value->items = safe_realloc(value->items, *capacity * sizeof(JsonValue));
+    if (value->json_type == JSON_OBJECT)
+      value->keys = safe_realloc(value->keys, *capacity * sizeof(char *));
+  }
+  JsonValue *item = &value->items[value->items_count];
+  memset(item, 0, sizeof(*item));
+  if (value->json_type == JSON_OBJECT)
+    value->keys[value->items_count] = NULL;
+  value->items_count++;
+  return item;
+}
+
+// Parses an array or an object; the opening bracket has not been consumed.
+static bool parse_container(JsonParser *parser, JsonValue *value, bool is_object) {
+  if (++parser->depth > JSON_MAX_DEPTH)
+    return false;
+  parser->position++;
+  value->json_type = is_object ? JSON_OBJECT : JSON_ARRAY;
+  size_t capacity = 0;
+  char close = is_object ? '}' : ']';
+
+  skip_whitespace(parser);
+  if (parser->position < parser->length && parser->text[parser->position] == close) {
+    parser->position++;
+    parser->depth--;
+    return true;
+  }
+  while (1) {
+    JsonValue *item = add_item(value, &capacity);
+    if (is_object) {
+      skip_whitespace(parser);
+      size_t key_length;
+      if (parser->position >= parser->length || parser->text[parser->position] != '"' || !parse_string(parser, &value->keys[value->items_count - 1], &key_length))
+        return false;
+      skip_whitespace(parser);
+      if (!match(parser, ":"))
+        return false;
+    }
+    if (!parse_value(parser, item))
+      return false;
+    skip_whitespace(parser);
+    if (match(parser, ","))
+      continue;
+    if (parser->position < parser->length && parser->text[parser->position] == close) {
+      parser->position++;
+      parser->depth--;
+      return true;
+    }
+    return false;
+  }
+}
+
+// Parses any value.
+static bool parse_value(JsonParser *parser, JsonValue *value) {
+  skip_whitespace(parser);
+  if (parser->position >= parser->length)
+    return false;
+  switch (parser->text[parser->position]) {
+  case '{': return parse_container(parser, value, true);
+  case '[': return parse_container(parser, value, false);
+  case '"':
+    value->json_type = JSON_STRING;
+    return parse_string(parser, &value->string_value, &value->string_length);
+  case 't': value->json_type = JSON_BOOLEAN; value->boolean_value = true; return match(parser, "true");
+  case 'f': value->json_type = JSON_BOOLEAN; value->boolean_value = false; return match(parser, "false");
+  case 'n': value->json_type = JSON_NULL; return match(parser, "null");
+  default: return parse_number(parser, value);
+  }
+}
+
+// Parses `length` bytes of JSON. Returns false on malformed input.
+bool json_parse(const char *text, size_t length, JsonValue *value) {
+  debug_func("length: %zu", length);
+  JsonParser parser = {text, length, 0, 0};
+  memset(value, 0, sizeof(*value));
+  bool ok = parse_value(&parser, value);
+  skip_whitespace(&parser);
+  if (!ok || parser.position != length) {
+    json_free(value);
+    return false;
+  }
+  return true;
+}
+
+// Returns the member of an object with the given name, or NULL.
+const JsonValue *json_get(const JsonValue *object, const char *key) {
+  if (!object || object->json_type != JSON_OBJECT)
+    return NULL;
+  for (size_t i = 0; i < object->items_count; i++)
+    if (object->keys[i] && strcmp(object->keys[i], key) == 0)
+      return &object->items[i];
+  return NULL;
+}
+
+// Returns the string of a value, or NULL if it is not a string.
+const char *json_string(const JsonValue *value) { return value && value->json_type == JSON_STRING ? value->string_value : NULL; }
+
+// Returns the number of a value, or `fallback` if it is not a number.
+double json_number(const JsonValue *value, double fallback) { return value && value->json_type == JSON_NUMBER ? value->number_value : fallback; }
+
+// Writes a quoted and escaped JSON string.
+void json_print_string(FILE *stream, const char *string, size_t length) {
+  static const char hex[] = "0123456789abcdef";
+  fputc('"', stream);
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)string[i];
+    switch (c) {
+    case '"': fputs("\\\"", stream); break;
+    case '\\': fputs("\\\\", stream); break;
+    case '\n': fputs("\\n", stream); break;
+    case '\r': fputs("\\r", stream); break;
+    case '\t': fputs("\\t", stream); break;
+    default:
+      if (c < 0x20)
+        fprintf(stream, "\\u00%c%c", hex[c >> 4], hex[c & 15]);
+      else
+        fputc(c, stream);
+      break;
+    }
+  }
+  fputc('"', stream);
+}
+
+// Writes a value back as JSON.
+void json_print(FILE *stream, const JsonValue *value) {
+  if (!value) {
+    fputs("null", stream);
+    return;
+  }
+  switch (value->json_type) {
+  case JSON_BOOLEAN: fputs(value->boolean_value ? "true" : "false", stream); break;
+  case JSON_NUMBER: fprintf(stream, "%.17g", value->number_value); break;
+  case JSON_STRING: json_print_string(stream, value->string_value, value->string_length); break;
+  case JSON_ARRAY:
+  case JSON_OBJECT:
+    fputc(value->json_type == JSON_ARRAY ? '[' : '{', stream);
+    for (size_t i = 0; i < value->items_count; i++) {
+      if (i)
+        fputc(',', stream);
+      if (value->json_type == JSON_OBJECT) {
+        json_print_string(stream, value->keys[i], strlen(value->keys[i]));
+        fputc(':', stream);
+      }
+      json_print(stream, &value->items[i]);
+    }
+    fputc(value->json_type == JSON_ARRAY ? ']' : '}', stream);
+    break;
+  case JSON_NULL:
+  default: fputs("null", stream); break;
+  }
+}
+
+// Frees everything owned by a value.
+void json_free(JsonValue *value) {
+  if (!value)
+    return;
+  free(value->string_value);
+  for (size_t i = 0; i < value->items_count; i++) {
+    json_free(&value->items[i]);
+    if (value->keys)
+      free(value->keys[i]);
+  }
+  free(value->items);
+  free(value->keys);
+  memset(value, 0, sizeof(*value));
+}
@@ -8,7 +8,10 @@
 #include "context.h"
 #include "input.h"
 #include "lexer/lexer.h"
+#include "stats.h"
+#include "utils/memory.h"
 #include "utils/strings.h"
+#include "utils/utf8.h"
 #include <ctype.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -19,138 +22,551 @@
 void print_summary(void) {
   debug_func("");
   int first = 1;
+  report_suppressed_logs();
+  flush_logs(); // Diagnostics come before the summary.
 
   // Print warning count if any.
   if (ctx->total_warnings > 0) {
-    printf("%d warning%s", ctx->total_warnings, ctx->total_warnings > 1 ? "s" : "");
+    fprintf(ni->out_stream, "%d warning%s", ctx->total_warnings, ctx->total_warnings > 1 ? "s" : "");
     first = 0;
   }
 
   // Print error count if any.
   if (ctx->total_errors > 0) {
     if (!first)
-      printf(" and ");
-    printf("%d error%s", ctx->total_errors, ctx->total_errors > 1 ? "s" : "");
+      fprintf(ni->out_stream, " and ");
+    fprintf(ni->out_stream, "%d error%s", ctx->total_errors, ctx->total_errors > 1 ? "s" : "");
     first = 0;
   }
 
   // Print info count if any.
   if (ctx->total_infos > 0) {
     if (!first)
-      printf(" and ");
-    printf("%d info%s", ctx->total_infos, ctx->total_infos > 1 ? "s" : "");
+      fprintf(ni->out_stream, " and ");
+    fprintf(ni->out_stream, "%d info%s", ctx->total_infos, ctx->total_infos > 1 ? "s" : "");
   }
 
   if (ctx->total_errors + ctx->total_warnings + ctx->total_infos > 0)
-    printf(" generated.\n");
+    fprintf(ni->out_stream, " generated.\n");
 }
 
-// Formats and prints a single log message to stderr, including source code
-// context.
-void print_log(int log_type, const char *fmt, LogPosition log_position, const char *symbol_str, ...) {
-  debug_func("log_type:%d, fmt:%s,{line:%zu, index:%zu}, symbol:%s", log_type, fmt, log_position.log_line, log_position.log_index, symbol_str);
-  const char *log_type_string;
-  const char *color;
-  // Determine log type string and color.
-  switch (log_type) {
-  case LOG_ERROR:
-    log_type_string = "error";
-    color = COLOR_RED;
-    ctx->total_errors++;
-    break;
-  case LOG_WARNING:
-    log_type_string = "warning";
-    color = COLOR_PURPLE;
-    ctx->total_warnings++;
-    break;
-  case LOG_INFO:
-    log_type_string = "info";
-    color = COLOR_CYAN;
-    ctx->total_infos++;
-    break;
-  default: return;
+int compare_logs(const void *a, const void *b);
+
+// Frees a saved log that will never be printed. Without an error limit its
+// totals are still counted, so the summary stays exact; with one, it would
+// have come after the limit anyway.
+static void drop_log(LogEntry *log) {
+  if (ni->max_errors) {
+    free(log->log_msg);
+    free(log->log_symbol);
+    return;
+  }
+  if (!ni->collect_logs) {
+    if (log->log_type == LOG_ERROR)
+      ctx->total_errors++;
+    else if (log->log_type == LOG_WARNING)
+      ctx->total_warnings++;
+    else
+      ctx->total_infos++;
+  }
+  ctx->logs_dropped++;
+  free(log->log_msg);
+  free(log->log_symbol);
+}
+
+// Restores the max-heap order of the saved logs below entry `i`.
+static void sift_down_logs(size_t i) {
+  while (1) {
+    size_t largest = i, left = 2 * i + 1, right = left + 1;
+    if (left < ctx->logs_count && compare_logs(&ctx->logs[left], &ctx->logs[largest]) > 0)
+      largest = left;
+    if (right < ctx->logs_count && compare_logs(&ctx->logs[right], &ctx->logs[largest]) > 0)
+      largest = right;
+    if (largest == i)
+      return;
+    LogEntry tmp = ctx->logs[i];
+    ctx->logs[i] = ctx->logs[largest];
+    ctx->logs[largest] = tmp;
+    i = largest;
+  }
+}
+
+// Appends an already formatted message to the saved logs, taking ownership of
+// `msg_buf`. Once the limit is reached the logs become a max-heap by
+// position, so only the first entries in source order are kept.
+static void store_log(int log_type, char *msg_buf, LogPosition log_position, const char *symbol_str) {
+  size_t limit = ni->max_errors ? ni->max_errors : MAX_STORED_LOGS;
+  if (ctx->logs_count >= limit) {
+    if (!ctx->logs_heap) {
+      for (size_t i = ctx->logs_count / 2; i-- > 0;)
+        sift_down_logs(i);
+      ctx->logs_heap = true;
+    }
+    LogEntry entry = {log_position, msg_buf, NULL, log_type};
+    if (compare_logs(&entry, &ctx->logs[0]) < 0) {
+      drop_log(&ctx->logs[0]);
+      entry.log_symbol = symbol_str ? safe_strdup(symbol_str) : NULL;
+      ctx->logs[0] = entry;
+      sift_down_logs(0);
+    } else {
+      drop_log(&entry);
+    }
+    return;
   }
 
-  // Format the main message string.
+  /* Expand the array if capacity is reached */
+  if (ctx->logs_count >= ctx->logs_capacity) {
+    size_t new_cap = ctx->logs_capacity ? ctx->logs_capacity * 2 : 16;
+    LogEntry *new_logs = realloc(ctx->logs, new_cap * sizeof(LogEntry));
+    if (!new_logs) {
+      // Safely exit on realloc failure.
+      fprintf(stderr, "fatal: out of memory saving logs\n");
+      free(msg_buf);
+      exit(EXIT_FAILURE);
+      return;
+    }
+    ctx->logs = new_logs;
+    ctx->logs_capacity = new_cap;
+  }
+
+  // Store the new log entry.
+  ctx->logs[ctx->logs_count].log_position = log_position;
+  ctx->logs[ctx->logs_count].log_msg = msg_buf;
+  ctx->logs[ctx->logs_count].log_symbol = symbol_str ? safe_strdup(symbol_str) : NULL;
+  ctx->logs[ctx->logs_count].log_type = log_type;
+  ctx->logs_count++;
+}
+
+// Makes room for `extra` more bytes in the diagnostic buffer.
+static void reserve_log_buffer(size_t extra) {
+  if (ctx->log_buffer_size + extra <= ctx->log_buffer_capacity)
+    return;
+  size_t new_cap = ctx->log_buffer_capacity ? ctx->log_buffer_capacity * 2 : LOG_BUFFER_SIZE;
+  while (new_cap < ctx->log_buffer_size + extra)
+    new_cap *= 2;
+  ctx->log_buffer = safe_realloc(ctx->log_buffer, new_cap);
+  ctx->log_buffer_capacity = new_cap;
+}
+
+// Appends raw bytes to the diagnostic buffer.
+static void append_log(const char *data, size_t size) {
+  reserve_log_buffer(size);
+  memcpy(ctx->log_buffer + ctx->log_buffer_size, data, size);
+  ctx->log_buffer_size += size;
+}
+
+// Appends `count` copies of a character to the diagnostic buffer.
+static void append_log_repeat(char c, size_t count) {
+  reserve_log_buffer(count);
+  memset(ctx->log_buffer + ctx->log_buffer_size, c, count);
+  ctx->log_buffer_size += count;
+}
+
+// Appends formatted text to the diagnostic buffer, formatting in place.
+static void append_logf(const char *fmt, ...) {
+  reserve_log_buffer(256);
   va_list args;
-  va_start(args, symbol_str);
-  int msg = vsnprintf(NULL, 0, fmt, args);
+  va_start(args, fmt);
+  size_t room = ctx->log_buffer_capacity - ctx->log_buffer_size;
+  int size = vsnprintf(ctx->log_buffer + ctx->log_buffer_size, room, fmt, args);
   va_end(args);
+  if (size < 0)
+    return;
+  if ((size_t)size >= room) {
+    reserve_log_buffer((size_t)size + 1);
+    va_start(args, fmt);
+    vsnprintf(ctx->log_buffer + ctx->log_buffer_size, (size_t)size + 1, fmt, args);
+    va_end(args);
+  }
+  ctx->log_buffer_size += (size_t)size;
+}
 
-  char *msg_buf = malloc(msg + 1);
-  if (!msg_buf)
+// Appends a quoted and escaped JSON string to the diagnostic buffer.
+static void append_log_json(const char *string) {
+  static const char hex[] = "0123456789abcdef";
+  if (!string) {
+    append_log("null", 4);
     return;
-  va_start(args, symbol_str);
-  vsnprintf(msg_buf, msg + 1, fmt, args);
-  va_end(args);
+  }
+  size_t length = strlen(string);
+  reserve_log_buffer(length * 6 + 2);
+  char *out = ctx->log_buffer + ctx->log_buffer_size;
+  *out++ = '"';
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)string[i];
+    if (c == '"' || c == '\\') {
+      *out++ = '\\';
+      *out++ = (char)c;
+    } else if (c < 0x20) {
+      *out++ = '\\';
+      *out++ = 'u';
+      *out++ = '0';
+      *out++ = '0';
+      *out++ = hex[c >> 4];
+      *out++ = hex[c & 15];
+    } else {
+      *out++ = (char)c;
+    }
+  }
+  *out++ = '"';
+  ctx->log_buffer_size = (size_t)(out - ctx->log_buffer);
+}
 
-  // Create the caret string (e.g., "^~~~") to underline the symbol.
-  size_t sym = symbol_str ? strlen(symbol_str) : 0;
-  size_t caret = (sym <= 1) ? 1 : sym;
-  char *caret_buf = malloc(caret + 1);
-  if (!caret_buf) {
-    free(msg_buf);
+// Writes the buffered diagnostics to the log stream in one write.
+void flush_logs(void) {
+  if (!ctx || ctx->log_buffer_size == 0)
     return;
+  uint64_t start = stats_clock();
+  fwrite(ctx->log_buffer, 1, ctx->log_buffer_size, ni->log_stream);
+  stats_add(STATS_DIAGNOSTICS, start);
+  ctx->log_buffer_size = 0;
+}
+
+// Starts a machine-readable diagnostics document.
+void begin_diagnostics(void) {
+  debug_func("");
+  if (!ctx)
+    init_context();
+  if (ni->diagnostics_format == DIAGNOSTICS_JSON)
+    append_log("[", 1);
+  else if (ni->diagnostics_format == DIAGNOSTICS_SARIF)
+    append_logf("{\"$schema\":\"%s\",\"version\":\"2.1.0\",\"runs\":[{\"tool\":{\"driver\":{\"name\":\"noon\"}},\"results\":[", SARIF_SCHEMA);
+}
+
+// Ends a machine-readable diagnostics document and flushes it.
+void end_diagnostics(void) {
+  debug_func("");
+  report_suppressed_logs();
+  if (ni->diagnostics_format == DIAGNOSTICS_JSON)
+    append_log("\n]\n", 3);
+  else if (ni->diagnostics_format == DIAGNOSTICS_SARIF)
+    append_log("\n]}]}\n", 6);
+  flush_logs();
+}
+
+// Maps the column of byte `index` (counting from 1) of a source line to the
+// column a terminal shows it at. A line is mapped once, when a diagnostic
+// first points into it, so more diagnostics on the same line cost nothing,
+// and a line that is all ASCII needs no map.
+static size_t display_column(const char *line_text, size_t line, size_t index) {
+  if (ctx->display_line != line) {
+    size_t length = strlen(line_text);
+    ctx->display_line = line;
+    ctx->display_length = length;
+    ctx->display_ascii = utf8_ascii_prefix(line_text, length) == length;
+    if (!ctx->display_ascii) {
+      if (length + 1 > ctx->display_capacity) {
+        ctx->display_capacity = length + 1;
+        ctx->display_columns = safe_realloc(ctx->display_columns, ctx->display_capacity * sizeof(size_t));
+      }
+      size_t column = 1;
+      for (size_t i = 0; i < length;) {
+        size_t sequence;
+        uint32_t code = utf8_decode(line_text + i, &sequence);
+        int width = code < 0x80 ? 1 : char_width(code);
+        // A byte that is not UTF-8 shows as one column.
+        if (!sequence)
+          sequence = 1, width = 1;
+        for (size_t j = 0; j < sequence; j++)
+          ctx->display_columns[i + j] = column;
+        column += (size_t)width;
+        i += sequence;
+      }
+      ctx->display_columns[length] = column;
+    }
   }
-  caret_buf[0] = '^';
-  for (size_t i = 1; i < caret; ++i)
-    caret_buf[i] = '~';
-  caret_buf[caret] = '\0';
+  if (ctx->display_ascii || index == 0)
+    return index;
+  // Columns past the end of the line, like a missing closing bracket, follow
+  // the last one.
+  size_t byte = index - 1;
+  if (byte > ctx->display_length)
+    return ctx->display_columns[ctx->display_length] + byte - ctx->display_length;
+  return ctx->display_columns[byte];
+}
+
+// Appends a diagnostic in the human-readable format, with the source line
+// and a caret under the symbol. Columns count characters as a terminal
+// shows them, not bytes.
+static void emit_text(const char *type_string, const char *color, const char *msg, LogPosition log_position, const char *symbol_str) {
+  // Create the caret (e.g., "^~~~") to underline the symbol.
+  size_t sym = symbol_str ? utf8_width(symbol_str, strlen(symbol_str)) : 0;
+  size_t caret = (sym <= 1) ? 1 : sym;
 
   // Get the line of code where the log occurred.
   const char *line_text = "";
-  if (ctx->lines != NULL && log_position.log_line > 0 && log_position.log_line <= ctx->line_number && ctx->lines[log_position.log_line - 1])
-    line_text = ctx->lines[log_position.log_line - 1];
-  else
+  if (ctx->lines != NULL && log_position.log_line > ctx->first_line && log_position.log_line <= ctx->line_number && ctx->lines[log_position.log_line - 1 - ctx->first_line]) {
+    line_text = ctx->lines[log_position.log_line - 1 - ctx->first_line];
+    log_position.log_index = display_column(line_text, log_position.log_line, log_position.log_index);
+  } else {
     log_position.log_index = 0;
+  }
 
-  int caret_index = (int)(log_position.log_index > 0 ? log_position.log_index - 1 : 0);
+  size_t caret_index = log_position.log_index > 0 ? log_position.log_index - 1 : 0;
   int num_digits = number_count((int)log_position.log_line);
 
   log_position.log_index = (log_position.log_index == 0) ? 1 : log_position.log_index;
 
-  // Print the fully formatted log message.
-  fprintf(stderr,
-          "%s%s:%zu:%zu: %s%s:%s%s %s%s\n"
-          "%*zu | %s\n"
-          "%*s | %*s%s%s%s%s\n",
-          COLOR_BOLD,
-          ni->input,
-          log_position.log_line,
-          log_position.log_index,
-          color,
-          log_type_string,
-          COLOR_RESET,
-          COLOR_BOLD,
-          msg_buf,
-          COLOR_RESET,
-          num_digits,
-          log_position.log_line,
-          line_text,
-          num_digits,
-          "",
-          caret_index,
-          "",
-          COLOR_BOLD,
-          COLOR_GREEN,
-          caret_buf,
-          COLOR_RESET);
-
-  free(msg_buf);
-  free(caret_buf);
+  append_logf("%s%s:%zu:%zu: %s%s:%s%s %s%s\n"
+              "%*zu | %s\n"
+              "%*s | ",
+              COLOR_BOLD,
+              ni->input,
+              log_position.log_line,
+              log_position.log_index,
+              color,
+              type_string,
+              COLOR_RESET,
+              COLOR_BOLD,
+              msg,
+              COLOR_RESET,
+              num_digits,
+              log_position.log_line,
+              line_text,
+              num_digits,
+              "");
+  append_log_repeat(' ', caret_index);
+  append_logf("%s%s^", COLOR_BOLD, COLOR_GREEN);
+  append_log_repeat('~', caret - 1);
+  append_logf("%s\n", COLOR_RESET);
+}
+
+// Appends a diagnostic as a JSON object.
+static void emit_json(const char *type_string, const char *msg, LogPosition log_position, const char *symbol_str) {
+  if (ctx->logs_emitted)
+    append_log(",", 1);
+  append_log("\n", 1);
+  append_log("{\"file\":", 8);
+  append_log_json(ni->input);
+  append_logf(",\"line\":%zu,\"column\":%zu,\"severity\":\"%s\",\"message\":", log_position.log_line, log_position.log_index ? log_position.log_index : 1, type_string);
+  append_log_json(msg);
+  append_log(",\"symbol\":", 10);
+  append_log_json(symbol_str);
+  append_log("}", 1);
+}
+
+// Appends a diagnostic as a SARIF result.
+static void emit_sarif(int log_type, const char *msg, LogPosition log_position, const char *symbol_str) {
+  size_t column = log_position.log_index ? log_position.log_index : 1;
+  size_t width = symbol_str && *symbol_str ? strlen(symbol_str) : 1;
+  if (ctx->logs_emitted)
+    append_log(",", 1);
+  append_log("\n", 1);
+  append_logf("{\"level\":\"%s\",\"message\":{\"text\":", log_type == LOG_ERROR ? "error" : log_type == LOG_WARNING ? "warning" : "note");
+  append_log_json(msg);
+  append_log("},\"locations\":[{\"physicalLocation\":{\"artifactLocation\":{\"uri\":", 62);
+  append_log_json(ni->input);
+  append_logf("},\"region\":{\"startLine\":%zu,\"startColumn\":%zu,\"endColumn\":%zu}}}]}", log_position.log_line ? log_position.log_line : 1, column, column + width);
+}
+
+// Counts a diagnostic and returns its type name and color, or NULL for an
+// unknown type.
+static const char *count_log(int log_type, const char **color) {
+  switch (log_type) {
+  case LOG_ERROR:
+    *color = COLOR_RED;
+    ctx->total_errors++;
+    if (ni->max_errors && (size_t)ctx->total_errors >= ni->max_errors)
+      ctx->error_limit_reached = true;
+    return "error";
+  case LOG_WARNING:
+    *color = COLOR_PURPLE;
+    ctx->total_warnings++;
+    return "warning";
+  case LOG_INFO:
+    *color = COLOR_CYAN;
+    ctx->total_infos++;
+    return "info";
+  default: return NULL;
+  }
+}
+
+// Counts a message in the deduplication table. Returns true once the same
+// message has already been shown MAX_DUPLICATE_LOGS times.
+static bool is_duplicate(int log_type, const char *msg) {
+  if (!ctx->duplicates)
+    ctx->duplicates = safe_calloc(LOG_DEDUP_SLOTS, sizeof(LogDuplicate));
+  size_t length = strlen(msg);
+  uint64_t hash = hash_bytes(msg, length) ^ (uint64_t)log_type;
+  if (hash == 0)
+    hash = 1;
+
+  // Open addressing with linear probing; the table is never more than
+  // three quarters full, so new messages past that are simply shown.
+  for (size_t slot = hash & (LOG_DEDUP_SLOTS - 1);; slot = (slot + 1) & (LOG_DEDUP_SLOTS - 1)) {
+    LogDuplicate *entry = &ctx->duplicates[slot];
+    if (entry->hash == 0) {
+      if (ctx->duplicates_count >= LOG_DEDUP_SLOTS / 4 * 3)
+        return false;
+      entry->hash = hash;
+      entry->message = safe_strdup(msg);
+      entry->count = 1;
+      entry->first_seen = ctx->duplicates_count++;
+      entry->log_type = log_type;
+      return false;
+    }
+    if (entry->hash == hash && entry->log_type == (LogType)log_type && strcmp(entry->message, msg) == 0)
+      return ++entry->count > MAX_DUPLICATE_LOGS;
+  }
+}
+
+// Appends a note without a source position in the selected format.
+static void emit_note(const char *type_string, const char *color, const char *msg) {
+  switch (ni->diagnostics_format) {
+  case DIAGNOSTICS_JSON:
+  case DIAGNOSTICS_SARIF:
+    if (ctx->logs_emitted)
+      append_log(",", 1);
+    append_log("\n", 1);
+    if (ni->diagnostics_format == DIAGNOSTICS_JSON) {
+      append_log("{\"file\":", 8);
+      append_log_json(ni->input);
+      append_logf(",\"severity\":\"%s\",\"message\":", type_string);
+      append_log_json(msg);
+    } else {
+      append_logf("{\"level\":\"%s\",\"message\":{\"text\":", strcmp(type_string, "note") == 0 ? "note" : "error");
+      append_log_json(msg);
+      append_log("}", 1);
+    }
+    append_log("}", 1);
+    break;
+  case DIAGNOSTICS_TEXT:
+  default: append_logf("%s%s: %s%s:%s%s %s%s\n", COLOR_BOLD, ni->input, color, type_string, COLOR_RESET, COLOR_BOLD, msg, COLOR_RESET); break;
+  }
+  ctx->logs_emitted++;
+}
+
+// Formats a count with thousands separators (e.g. "41,233").
+void format_count(size_t count, char *buffer, size_t size) {
+  char digits[32];
+  int length = snprintf(digits, sizeof(digits), "%zu", count);
+  size_t out = 0;
+  for (int i = 0; i < length && out + 2 < size; i++) {
+    if (i > 0 && (length - i) % 3 == 0)
+      buffer[out++] = ',';
+    buffer[out++] = digits[i];
+  }
+  buffer[out] = '\0';
+}
+
+// Comparison function for qsort to order duplicates by first occurrence.
+static int compare_duplicates(const void *a, const void *b) {
+  const LogDuplicate *left = *(const LogDuplicate *const *)a;
+  const LogDuplicate *right = *(const LogDuplicate *const *)b;
+  return (left->first_seen > right->first_seen) - (left->first_seen < right->first_seen);
+}
+
+// Reports the diagnostics that were not shown: repeated messages, saved
+// logs dropped to bound memory, and an early stop at the error limit.
+void report_suppressed_logs(void) {
+  debug_func("");
+  if (!ctx)
+    return;
+  if (ctx->duplicates) {
+    LogDuplicate *repeated[LOG_DEDUP_SLOTS];
+    size_t repeated_count = 0;
+    for (size_t i = 0; i < LOG_DEDUP_SLOTS; i++)
+      if (ctx->duplicates[i].count > MAX_DUPLICATE_LOGS)
+        repeated[repeated_count++] = &ctx->duplicates[i];
+    qsort(repeated, repeated_count, sizeof(LogDuplicate *), compare_duplicates);
+    for (size_t i = 0; i < repeated_count; i++) {
+      char count[32];
+      format_count(repeated[i]->count - MAX_DUPLICATE_LOGS, count, sizeof(count));
+      size_t size = strlen(repeated[i]->message) + sizeof(NOTE_DUPLICATE_LOGS) + sizeof(count);
+      char *note = safe_malloc(size);
+      snprintf(note, size, NOTE_DUPLICATE_LOGS, count, repeated[i]->message);
+      emit_note("note", COLOR_CYAN, note);
+      free(note);
+      repeated[i]->count = MAX_DUPLICATE_LOGS; // Reported.
+    }
+  }
+  if (ctx->logs_dropped) {
+    char count[32], note[96];
+    format_count(ctx->logs_dropped, count, sizeof(count));
+    snprintf(note, sizeof(note), NOTE_DROPPED_LOGS, count);
+    emit_note("note", COLOR_CYAN, note);
+    ctx->logs_dropped = 0;
+  }
+  if (ctx->error_limit_reached) {
+    char note[96];
+    snprintf(note, sizeof(note), ERR_TOO_MANY_ERRORS, ni->max_errors);
+    emit_note("fatal error", COLOR_RED, note);
+    ctx->error_limit_reached = false;
+  }
+}
+
+// Appends an already formatted diagnostic to the output buffer in the
+// selected format, flushing when the buffer is large or in the REPL.
+static void emit_log(int log_type, const char *type_string, const char *color, const char *msg, LogPosition log_position, const char *symbol_str) {
+  uint64_t start = stats_clock();
+  if (is_duplicate(log_type, msg))
+    return;
+  switch (ni->diagnostics_format) {
+  case DIAGNOSTICS_JSON: emit_json(type_string, msg, log_position, symbol_str); break;
+  case DIAGNOSTICS_SARIF: emit_sarif(log_type, msg, log_position, symbol_str); break;
+  case DIAGNOSTICS_TEXT:
+  default: emit_text(type_string, color, msg, log_position, symbol_str); break;
+  }
+  ctx->logs_emitted++;
+  stats_add(STATS_DIAGNOSTICS, start);
+  if (ni->is_repl || ctx->log_buffer_size >= LOG_BUFFER_SIZE)
+    flush_logs();
+}
+
+// Formats and prints a single log message, including source code context.
+// When logs are collected instead of printed, the message is saved as a
+// structured entry.
+void print_log(int log_type, const char *fmt, LogPosition log_position, const char *symbol_str, ...) {
+  debug_func("log_type:%d, fmt:%s,{line:%zu, index:%zu}, symbol:%s", log_type, fmt, log_position.log_line, log_position.log_index, symbol_str);
+  if (ctx->error_limit_reached)
+    return;
+  const char *color;
+  const char *log_type_string = count_log(log_type, &color);
+  if (!log_type_string)
+    return;
+
+  // Format the main message string, on the stack unless it is long.
+  char stack_buf[256];
+  char *msg_buf = stack_buf;
+  va_list args;
+  va_start(args, symbol_str);
+  int msg = vsnprintf(stack_buf, sizeof(stack_buf), fmt, args);
+  va_end(args);
+  if (msg < 0)
+    return;
+  if ((size_t)msg >= sizeof(stack_buf)) {
+    msg_buf = safe_malloc((size_t)msg + 1);
+    va_start(args, symbol_str);
+    vsnprintf(msg_buf, (size_t)msg + 1, fmt, args);
+    va_end(args);
+  }
+
+  if (ni->collect_logs) {
+    store_log(log_type, msg_buf == stack_buf ? safe_strdup(stack_buf) : msg_buf, log_position, symbol_str);
+    return;
+  }
+  emit_log(log_type, log_type_string, color, msg_buf, log_position, symbol_str);
+  if (msg_buf != stack_buf)
+    free(msg_buf);
 }
 
 // Iterates through all saved logs and prints them.
 void print_logs(void) {
   debug_func("");
-  for (size_t i = 0; i < ctx->logs_count; i++) {
-    print_log(ctx->logs[i].log_type, ctx->logs[i].log_msg, ctx->logs[i].log_position, ctx->logs[i].log_symbol);
+  for (size_t i = 0; i < ctx->logs_count && !ctx->error_limit_reached; i++) {
+    const LogEntry *log = &ctx->logs[i];
+    const char *color;
+    const char *log_type_string = count_log(log->log_type, &color);
+    if (log_type_string)
+      emit_log(log->log_type, log_type_string, color, log->log_msg, log->log_position, log->log_symbol);
   }
 }
 
 // Saves a log entry to a dynamic array to be printed later.
 void save_log(int log_type, const char *fmt, LogPosition log_position, const char *symbol_str, ...) {
   debug_func("log_type:%d, fmt:%s,{line:%zu, index:%zu}, symbol:%s", log_type, fmt, log_position.log_line, log_position.log_index, symbol_str);
+  if (ctx->error_limit_reached)
+    return;
   // Format the message string.
   va_list args;
   va_start(args, symbol_str);
@@ -165,27 +581,16 @@ void save_log(int log_type, const char *fmt, LogPosition log_position, const cha
   vsnprintf(msg_buf, msg + 1, fmt, args);
   va_end(args);
 
-  /* Expand the array if capacity is reached */
-  if (ctx->logs_count >= ctx->logs_capacity) {
-    size_t new_cap = ctx->logs_capacity ? ctx->logs_capacity * 2 : 16;
-    LogEntry *new_logs = realloc(ctx->logs, new_cap * sizeof(LogEntry));
-    if (!new_logs) {
-      // Safely exit on realloc failure.
-      fprintf(stderr, "fatal: out of memory saving logs\n");
-      free(msg_buf);
-      exit(EXIT_FAILURE);
-      return;
-    }
-    ctx->logs = new_logs;
-    ctx->logs_capacity = new_cap;
+  // Collected logs are counted when saved since they are never printed.
+  if (ni->collect_logs) {
+    if (log_type == LOG_ERROR)
+      ctx->total_errors++;
+    else if (log_type == LOG_WARNING)
+      ctx->total_warnings++;
+    else
+      ctx->total_infos++;
   }
-
-  // Store the new log entry.
-  ctx->logs[ctx->logs_count].log_position = log_position;
-  ctx->logs[ctx->logs_count].log_msg = msg_buf;
-  ctx->logs[ctx->logs_count].log_symbol = symbol_str ? safe_strdup(symbol_str) : NULL;
-  ctx->logs[ctx->logs_count].log_type = log_type;
-  ctx->logs_count++;
+  store_log(log_type, msg_buf, log_position, symbol_str);
 }
 
 // Comparison function for qsort to sort logs by line and then by index.
@@ -213,6 +618,7 @@ int compare_logs(const void *a, const void *b) {
 void sort_logs(void) {
   debug_func("");
   qsort(ctx->logs, ctx->logs_count, sizeof(LogEntry), compare_logs);
+  ctx->logs_heap = false;
 }
 
 // Resets the logging system to a clean initial state.
@@ -233,6 +639,7 @@ void reset_logs(void) {
 
   // Reset counters.
   ctx->logs_count = 0;
+  ctx->logs_heap = false;
   ctx->total_errors = 0;
   ctx->total_warnings = 0;
   ctx->total_infos = 0;
@@ -12,10 +12,12 @@
 #include "lexer/tokens.h"
 #include "parser/ast.h"
 #include "parser/parser.h"
+#include "stats.h"
 #include "utils/log.h"
 #include <ctype.h>
 #include <math.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,9 +33,33 @@
 
 #include "input.h"
 
+// Allocation counters for --stats. Batch workers allocate concurrently, so
+// they are atomic; they are only updated once counting is turned on.
+static bool counting = false;
+static atomic_size_t allocations;
+static atomic_size_t allocated_bytes;
+
+// Turns on allocation counting.
+void count_allocations(void) { counting = true; }
+
+// Returns the number of allocations and the bytes requested so far.
+void allocation_stats(size_t *count, size_t *bytes) {
+  *count = atomic_load_explicit(&allocations, memory_order_relaxed);
+  *bytes = atomic_load_explicit(&allocated_bytes, memory_order_relaxed);
+}
+
+// Counts one allocation of `n` bytes.
+static void count_allocation(size_t n) {
+  if (!counting)
+    return;
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&allocated_bytes, n, memory_order_relaxed);
+}
+
 // A safe wrapper for malloc that exits on failure.
 void *safe_malloc(size_t n) {
   debug_func("n: %zu", n);
+  count_allocation(n);
   void *p = malloc(n);
   if (!p) {
     perror("malloc failed");
@@ -45,6 +71,7 @@ void *safe_malloc(size_t n) {
 // A safe wrapper for calloc that exits on failure.
 void *safe_calloc(size_t nmemb, size_t size) {
   debug_func("nmemb:%zu, size:%zu", nmemb, size);
+  count_allocation(nmemb * size);
   void *p = calloc(nmemb, size);
   if (!p) {
     perror("calloc failed");
@@ -57,6 +84,7 @@ void *safe_calloc(size_t nmemb, size_t size) {
 // A safe wrapper for realloc that exits on failure.
 void *safe_realloc(void *ptr, size_t new_size) {
   debug_func("ptr:%p, new_size:%zu", ptr, new_size);
+  count_allocation(new_size);
   void *p = realloc(ptr, new_size);
   if (!p) {
     perror("realloc failed");
@@ -78,6 +106,52 @@ char *safe_strdup(const char *s) {
   return p;
 }
 
+// Hands out `size` bytes from a region, 8-byte aligned. Blocks kept by an
+// earlier reset are used before new ones are allocated.
+void *region_alloc(Region *region, size_t size) {
+  size = (size + 7) & ~(size_t)7;
+  RegionBlock *block = region->current;
+  while (block && block->size - block->used < size)
+    block = block->next;
+  if (!block) {
+    size_t block_size = size > REGION_BLOCK_SIZE ? size : REGION_BLOCK_SIZE;
+    block = safe_malloc(sizeof(RegionBlock) + block_size);
+    block->size = block_size;
+    block->used = 0;
+    // Link it after the current block, ahead of any blocks still unused.
+    if (region->current) {
+      block->next = region->current->next;
+      region->current->next = block;
+    } else {
+      block->next = region->first;
+      region->first = block;
+    }
+  }
+  region->current = block;
+  void *p = block->data + block->used;
+  block->used += size;
+  return p;
+}
+
+// Releases everything allocated from a region, keeping its blocks.
+void region_reset(Region *region) {
+  for (RegionBlock *block = region->first; block; block = block->next)
+    block->used = 0;
+  region->current = region->first;
+}
+
+// Frees the blocks of a region.
+void region_free(Region *region) {
+  RegionBlock *block = region->first;
+  while (block) {
+    RegionBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  region->first = NULL;
+  region->current = NULL;
+}
+
 // Safely reads a character from a string at a given position, handling
 // out-of-bounds.
 char safe_char(const char *s, size_t char_pos) {
@@ -95,144 +169,30 @@ char safe_char(const char *s, size_t char_pos) {
   }
 }
 
-// Central cleanup function to free all allocated resources before exiting.
+// Central cleanup function to free all resources of the current thread's
+// instance before exiting.
 void cleanup(void) {
 
   debug_func("");
+  if (!ni)
+    return;
 
-  // Print summary only in file mode and if there are logs.
-  if (!ni->is_repl && (ctx->total_errors || ctx->total_warnings || ctx->total_infos)) {
+  // Finish the diagnostics, then print the summary only in file mode, in
+  // the text format and if there are logs.
+  if (ctx && ni->diagnostics_format != DIAGNOSTICS_TEXT)
+    end_diagnostics();
+  else if (ctx && !ni->is_repl && (ctx->total_errors || ctx->total_warnings || ctx->total_infos))
     print_summary();
-  }
-
-  // Free all stored lines of source code.
-  if (ctx->lines) {
-    for (size_t i = 0; i < ctx->line_number; i++) {
-      if (ctx->lines[i])
-        free(ctx->lines[i]);
-      ctx->lines[i] = NULL;
-    }
-    free((void *)ctx->lines);
-    ctx->lines = NULL;
-    ctx->line_number = 0;
-    ctx->lines_capacity = 0;
-  }
-
-  // Free the Abstract Syntax Tree.
-  if (ctx->ast_root) {
-    free_node(ctx->ast_root);
-    ctx->ast_root = NULL;
-  }
-
-  // Free the bracket matching stack.
-  if (ctx->bracket_stack) {
-    free(ctx->bracket_stack);
-    ctx->bracket_stack = NULL;
-    ctx->bracket_stack_capacity = 0;
-    ctx->bracket_stack_size = 0;
-  }
-  // Close the input file if it's not stdin.
-  if (ni->file && ni->file != stdin) {
-    fclose(ni->file);
-    ni->file = NULL;
-  }
-
-  // Free all tokens.
-  if (ctx->tokens) {
-    for (size_t i = 0; i < ctx->tokens_count; ++i) {
-      if (ctx->tokens[i].token_value)
-        free(ctx->tokens[i].token_value);
-    }
-    free(ctx->tokens);
-    ctx->tokens = NULL;
-    ctx->tokens_capacity = 0;
-    ctx->tokens_count = 0;
-  }
-
-  // Free the temporary string token buffer.
-  if (ctx->string_token) {
-    free(ctx->string_token);
-    ctx->string_token = NULL;
-    ctx->string_token_length = 0;
-    ctx->string_token_capacity = 0;
-  }
-
-  // Free all saved log entries.
-  if (ctx->logs) {
-    for (size_t i = 0; i < ctx->logs_count; ++i) {
-      if (ctx->logs[i].log_msg)
-        free(ctx->logs[i].log_msg);
-      if (ctx->logs[i].log_symbol)
-        free(ctx->logs[i].log_symbol);
-    }
-
-    free(ctx->logs);
-    ctx->logs = NULL;
-    ctx->logs_capacity = 0;
-    ctx->logs_count = 0;
-
-    ctx->total_errors = 0;
-    ctx->total_warnings = 0;
-    ctx->total_infos = 0;
-  }
-  // Free the buffer for the current line being processed.
-  if (ctx->current_line) {
-    free(ctx->current_line);
-    ctx->current_line = NULL;
-    ctx->line_length = 0;
-    ctx->bytes_read = 0;
-  }
-
-  if (ni->is_repl) {
-    if (ni->history.count != 0) { // Only save history if there are entries
-
-      const char *home = getenv("HOME"); // Get HOME directory (Unix)
-      if (!home) {
-        home = getenv("USERPROFILE"); // Fallback for Windows
-      }
-      if (!home) {
-        return; // Cannot determine home directory, abort saving
-      }
-
-      char path[1024];
-      snprintf(path, sizeof(path), "%s/.noon_history", home); // Build history file path
-
-      FILE *fp = fopen(path, "w"); // Open file for writing (overwrite)
-      if (!fp) {
-        return; // Cannot open file, abort saving
-      }
-
-      // Write each history entry into the file
-      for (size_t i = 0; i < ni->history.count; i++) {
-        fprintf(fp, "%s\n", ni->history.items[i]);
-      }
-
-      fclose(fp); // Close the file
-    }
-    // Free REPL history when the entire program stops.
-
-    if (ni->history.items) {
-      for (size_t i = 0; i < ni->history.count; i++) {
-        free(ni->history.items[i]);
-      }
-      free(ni->history.items);
-      ni->history.items = NULL;
-      ni->history.count = 0;
-    }
-  }
-  // Free the main context struct.
-  if (ctx) {
-    free(ctx);
-    ctx = NULL;
-  }
-
-  if (ni->is_repl) {
-    // In REPL mode, don't exit the whole program on error, just reset.
-    return;
-  }
-  // In file mode, free the input struct and exit.
-  if (ni) {
-    free(ni);
-    ni = NULL;
-  }
+  else
+    flush_logs();
+  if (ctx && ni->stats)
+    print_stats();
+
+  // Free the context and everything it owns.
+  destroy_context(ctx);
+  ctx = NULL;
+
+  // Close the input file and free the input state with its history.
+  destroy_input(ni);
+  ni = NULL;
 }
@@ -0,0 +1,103 @@
+// utils/reader.c
+// This file implements the block line reader used for file, pipe and
+// command-string input. It pulls READ_BLOCK_SIZE bytes at a time with
+// read(2), or fread for streams without a descriptor, and finds line ends
+// with memchr instead of going through stdio one byte at a time.
+
+#include "utils/reader.h"
+#include "config.h"
+#include "utils/log.h"
+#include "utils/memory.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// Starts reading `file` from its current position.
+void reader_open(LineReader *reader, FILE *file) {
+  debug_func("");
+  reader->file = file;
+#ifdef _WIN32
+  reader->fd = -1; // keep the text mode translation of stdio
+#else
+  // The descriptor is read directly, so the stream must not hold buffered
+  // input (it is either untouched or rewound). fmemopen streams have none.
+  reader->fd = file ? fileno(file) : -1;
+#endif
+  if (!reader->block)
+    reader->block = safe_malloc(READ_BLOCK_SIZE);
+  reader->start = 0;
+  reader->end = 0;
+  reader->carry_size = 0;
+  reader->eof = !file;
+}
+
+// Reads the next block. Returns the number of bytes read, 0 at the end.
+static size_t fill_block(LineReader *reader) {
+#ifndef _WIN32
+  if (reader->fd >= 0) {
+    ssize_t count;
+    do {
+      count = read(reader->fd, reader->block, READ_BLOCK_SIZE);
+    } while (count < 0 && errno == EINTR);
+    return count > 0 ? (size_t)count : 0;
+  }
+#endif
+  return fread(reader->block, 1, READ_BLOCK_SIZE, reader->file);
+}
+
+// Appends part of a line to the carry buffer.
+static void carry_bytes(LineReader *reader, const char *bytes, size_t size) {
+  if (reader->carry_size + size > reader->carry_capacity) {
+    size_t capacity = reader->carry_capacity ? reader->carry_capacity * 2 : LINE_SIZE;
+    while (capacity < reader->carry_size + size)
+      capacity *= 2;
+    reader->carry = safe_realloc(reader->carry, capacity);
+    reader->carry_capacity = capacity;
+  }
+  memcpy(reader->carry + reader->carry_size, bytes, size);
+  reader->carry_size += size;
+}
+
+// Returns the next line, including its newline, and stores its length.
+const char *read_line(LineReader *reader, size_t *length) {
+  reader->carry_size = 0;
+  while (1) {
+    if (reader->start == reader->end) {
+      size_t count = reader->eof ? 0 : fill_block(reader);
+      reader->start = 0;
+      reader->end = count;
+      if (count == 0) {
+        reader->eof = true;
+        break;
+      }
+    }
+    const char *line = reader->block + reader->start;
+    size_t available = reader->end - reader->start;
+    const char *newline = memchr(line, '\n', available);
+    size_t size = newline ? (size_t)(newline + 1 - line) : available;
+    reader->start += size;
+    if (newline && reader->carry_size == 0) {
+      *length = size;
+      return line;
+    }
+    carry_bytes(reader, line, size);
+    if (newline)
+      break;
+  }
+  if (reader->carry_size == 0)
+    return NULL;
+  *length = reader->carry_size;
+  return reader->carry;
+}
+
+// Frees the buffers of a reader.
+void reader_free(LineReader *reader) {
+  free(reader->block);
+  free(reader->carry);
+  *reader = (LineReader){0};
+  reader->fd = -1;
+}
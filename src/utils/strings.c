@@ -30,3 +30,14 @@ int number_count(int number) {
     return 1;
   return (int)(log10(number) + 1);
 }
+
+// Computes a 64-bit FNV-1a hash of a byte buffer.
+uint64_t hash_bytes(const void *data, size_t size) {
+  const unsigned char *bytes = data;
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
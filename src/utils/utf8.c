@@ -0,0 +1,128 @@
+// utils/utf8.c
+// This file implements UTF-8 validation and decoding. Source text is
+// almost all ASCII, so validation skips ASCII sixteen bytes at a time
+// (with SSE2 where available) and only decodes the characters between.
+
+#include "utils/utf8.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define HAVE_SSE2_ASCII 1
+#include <emmintrin.h>
+#endif
+
+// Bytes checked per step of the ASCII scan.
+#define ASCII_BLOCK 16
+
+// Returns the length of the longest prefix of `bytes` that is ASCII.
+size_t utf8_ascii_prefix(const char *bytes, size_t length) {
+  size_t i = 0;
+  for (; i + ASCII_BLOCK <= length; i += ASCII_BLOCK) {
+#ifdef HAVE_SSE2_ASCII
+    // The top bit of every byte, gathered into a mask.
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(bytes + i)));
+    if (mask)
+      return i + (unsigned)__builtin_ctz(mask);
+#else
+    uint64_t words[2];
+    memcpy(words, bytes + i, ASCII_BLOCK);
+    if ((words[0] | words[1]) & 0x8080808080808080ULL)
+      break;
+#endif
+  }
+  while (i < length && !((unsigned char)bytes[i] & 0x80))
+    i++;
+  return i;
+}
+
+// Returns the length of the UTF-8 character at `bytes`, or 0 if it is not
+// valid. It rejects overlong forms, surrogates and code points past
+// U+10FFFF, and never reads past `available` bytes.
+static size_t sequence_length(const unsigned char *bytes, size_t available) {
+  unsigned char lead = bytes[0];
+  size_t length;
+  unsigned char low = 0x80, high = 0xbf; // range of the second byte
+  if (lead < 0x80)
+    return 1;
+  if (lead < 0xc2)
+    return 0;
+  if (lead < 0xe0) {
+    length = 2;
+  } else if (lead < 0xf0) {
+    length = 3;
+    if (lead == 0xe0)
+      low = 0xa0;
+    else if (lead == 0xed)
+      high = 0x9f;
+  } else if (lead < 0xf5) {
+    length = 4;
+    if (lead == 0xf0)
+      low = 0x90;
+    else if (lead == 0xf4)
+      high = 0x8f;
+  } else {
+    return 0;
+  }
+  if (available < length || bytes[1] < low || bytes[1] > high)
+    return 0;
+  for (size_t i = 2; i < length; i++)
+    if ((bytes[i] & 0xc0) != 0x80)
+      return 0;
+  return length;
+}
+
+// Returns the length of the longest prefix of `bytes` that is valid UTF-8.
+size_t utf8_valid_prefix(const char *bytes, size_t length) {
+  size_t i = 0;
+  while (1) {
+    i += utf8_ascii_prefix(bytes + i, length - i);
+    // Decode characters until the text is back to ASCII.
+    while (i < length && ((unsigned char)bytes[i] & 0x80)) {
+      size_t sequence = sequence_length((const unsigned char *)bytes + i, length - i);
+      if (!sequence)
+        return i;
+      i += sequence;
+    }
+    if (i >= length)
+      return length;
+  }
+}
+
+// Decodes the character at `bytes` and stores its length.
+uint32_t utf8_decode(const char *bytes, size_t *length) {
+  const unsigned char *p = (const unsigned char *)bytes;
+  // The string ends at a NUL byte, which is never a continuation byte, so
+  // sequence_length() stops there.
+  size_t n = sequence_length(p, 4);
+  *length = n;
+  switch (n) {
+  case 1: return p[0];
+  case 2: return (uint32_t)(p[0] & 0x1f) << 6 | (p[1] & 0x3f);
+  case 3: return (uint32_t)(p[0] & 0x0f) << 12 | (uint32_t)(p[1] & 0x3f) << 6 | (p[2] & 0x3f);
+  case 4: return (uint32_t)(p[0] & 0x07) << 18 | (uint32_t)(p[1] & 0x3f) << 12 | (uint32_t)(p[2] & 0x3f) << 6 | (p[3] & 0x3f);
+  default: return 0;
+  }
+}
+
+// Returns the number of terminal columns the first `length` bytes take.
+// Bytes that are not UTF-8 take a column each.
+size_t utf8_width(const char *bytes, size_t length) {
+  size_t width = 0;
+  for (size_t i = 0; i < length;) {
+    size_t ascii = utf8_ascii_prefix(bytes + i, length - i);
+    width += ascii;
+    i += ascii;
+    if (i >= length)
+      break;
+    size_t sequence = sequence_length((const unsigned char *)bytes + i, length - i);
+    if (!sequence) {
+      width++;
+      i++;
+      continue;
+    }
+    size_t unused;
+    width += (size_t)char_width(utf8_decode(bytes + i, &unused));
+    i += sequence;
+  }
+  return width;
+}
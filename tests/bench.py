@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+# Benchmarks the interpreter on the synthetic corpora from corpus.py. Each
+# corpus is run several times with `--stats=json`, and the lexer, parser and
+# end-to-end throughput (MB/s) is reported as the median with its spread.
+# The first run saves a baseline that later runs are compared against.
+#
+# usage: python3 tests/bench.py [--save] [--repeat N] [--size BYTES]
+import json
+import os
+import statistics
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import corpus
+
+NOON = "build/noon"
+CORPUS_DIR = "build/bench"
+BASELINE = "tests/bench_baseline.json"
+# Phases reported, as (label, key in the --stats time object).
+PHASES = [("lex", "lex"), ("parse", "parse"), ("total", "total")]
+# Changes smaller than this are reported as noise.
+NOISE = 0.05
+
+def option(name, default):
+    if name in sys.argv:
+        return int(sys.argv[sys.argv.index(name) + 1])
+    return default
+
+def run(path):
+    output = subprocess.run([NOON, "--stats=json", path], capture_output=True, text=True)
+    if output.returncode != 0:
+        sys.exit(f"{path}: noon failed\n{output.stderr}")
+    return json.loads(output.stderr.strip().splitlines()[-1])
+
+def measure(path, repeat):
+    """Returns the MB/s of every phase for each of `repeat` runs."""
+    run(path) # warm the page cache
+    rates = {label: [] for label, _ in PHASES}
+    for _ in range(repeat):
+        stats = run(path)
+        megabytes = stats["bytes"] / 1e6
+        for label, key in PHASES:
+            seconds = stats["time"][key]
+            rates[label].append(megabytes / seconds if seconds > 0 else 0)
+    return rates
+
+def compare(now, before):
+    if not before:
+        return ""
+    change = now / before - 1
+    if abs(change) < NOISE:
+        return "  ~"
+    return f"  {change:+.0%}"
+
+def main():
+    repeat = option("--repeat", 5)
+    size = option("--size", 2 << 20)
+    baseline = None
+    if os.path.exists(BASELINE) and "--save" not in sys.argv:
+        with open(BASELINE) as f:
+            baseline = json.load(f)
+
+    paths = corpus.generate(CORPUS_DIR, size)
+    results = {}
+    print(f"{'corpus':<12}" + "".join(f"{label + ' MB/s':>26}" for label, _ in PHASES))
+    for name, path in paths.items():
+        rates = measure(path, repeat)
+        results[name] = {label: statistics.median(values) for label, values in rates.items()}
+        row = f"{name:<12}"
+        for label, values in rates.items():
+            median = statistics.median(values)
+            spread = statistics.stdev(values) / statistics.mean(values) if len(values) > 1 and statistics.mean(values) else 0
+            before = baseline.get(name, {}).get(label) if baseline else None
+            row += f"{median:>12.2f} ±{spread:>4.0%}{compare(median, before):>8}"
+        print(row)
+
+    if baseline is None:
+        with open(BASELINE, "w") as f:
+            json.dump(results, f, indent=2)
+            f.write("\n")
+        print(f"\nbaseline saved to {BASELINE}")
+    else:
+        print(f"\ncompared with {BASELINE} (changes under {NOISE:.0%} shown as ~)")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,36 @@
+#!/usr/bin/env python3
+# Small client for `noon --serve`, used by the tests.
+# Usage: client.py SOCKET MODE SOURCE...   (MODE: tokens, ast, check, eval)
+import socket
+import struct
+import sys
+
+MODES = {"tokens": 0, "ast": 1, "check": 2, "eval": 3}
+
+def read_full(sock, size):
+    data = b""
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            raise EOFError("server closed the connection")
+        data += chunk
+    return data
+
+def request(sock, mode, source):
+    body = source.encode()
+    sock.sendall(b"NOON" + struct.pack(">B3xI", MODES[mode], len(body)) + body)
+    header = read_full(sock, 12)
+    status, length = struct.unpack(">B3xI", header[4:])
+    return status, read_full(sock, length).decode()
+
+if __name__ == "__main__":
+    if len(sys.argv) < 4 or sys.argv[2] not in MODES:
+        sys.exit(f"usage: {sys.argv[0]} SOCKET MODE SOURCE...")
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(sys.argv[1])
+        status = 0
+        for source in sys.argv[3:]:
+            code, output = request(sock, sys.argv[2], source)
+            sys.stdout.write(output)
+            status = max(status, code)
+    sys.exit(status)
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# Synthetic source files for the benchmarks. Every corpus is valid noon, so
+# a run goes through the whole pipeline, and is built from a fixed seed, so
+# the same size always gives the same bytes.
+#
+# usage: python3 tests/corpus.py DIR [SIZE_IN_BYTES]
+import os
+import random
+import sys
+
+def arithmetic_chains(rng):
+    # Long binary chains: one statement of a few hundred operands per line.
+    terms = [str(rng.randint(1, 999)) for _ in range(200)]
+    line = terms[0]
+    for term in terms[1:]:
+        line += rng.choice([" + ", " - ", " * "]) + term
+    return line
+
+def deep_nesting(rng):
+    depth = rng.randint(50, 150)
+    return "(" * depth + str(rng.randint(1, 9)) + " + 1" + ")" * depth
+
+def strings(rng):
+    words = ["noon", "lexer", "parser", "token", "value", "escape\\n", "tab\\t", "quote\\\"", "unicode é"]
+    parts = ['"' + " ".join(rng.choice(words) for _ in range(rng.randint(4, 12))) + '"' for _ in range(rng.randint(2, 6))]
+    return " + ".join(parts)
+
+def comments(rng):
+    text = " ".join(rng.choice(["the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog"]) for _ in range(rng.randint(6, 16)))
+    kind = rng.randint(0, 3)
+    if kind == 0:
+        return "# " + text
+    if kind == 1:
+        return "/* " + text + " */ " + str(rng.randint(1, 99))
+    if kind == 2:
+        return "/*\n" + text + "\n" + text + "\n*/"
+    return str(rng.randint(1, 99)) + " * 2"
+
+def short_statements(rng):
+    return str(rng.randint(0, 99)) + rng.choice("+-*") + str(rng.randint(1, 99))
+
+def numbers(rng):
+    literals = []
+    for _ in range(rng.randint(8, 24)):
+        kind = rng.randint(0, 3)
+        if kind == 0:
+            literals.append(str(rng.randint(0, 10**12)))
+        elif kind == 1:
+            literals.append(f"{rng.uniform(0, 1000):.6f}")
+        elif kind == 2:
+            literals.append(f"{rng.randint(1, 9)}.{rng.randint(0, 999)}e{rng.randint(-20, 20)}")
+        else:
+            literals.append(f"{rng.randint(1, 999)}_{rng.randint(100, 999)}_{rng.randint(100, 999)}")
+    return " + ".join(literals)
+
+# Corpus name -> line generator.
+CORPORA = {
+    "arithmetic": arithmetic_chains,
+    "nesting": deep_nesting,
+    "strings": strings,
+    "comments": comments,
+    "statements": short_statements,
+    "numbers": numbers,
+}
+
+def generate(directory, size):
+    """Writes one `<name>.noon` file of about `size` bytes per corpus and
+    returns their paths by name."""
+    os.makedirs(directory, exist_ok=True)
+    paths = {}
+    for name, line in CORPORA.items():
+        rng = random.Random(name)
+        path = os.path.join(directory, name + ".noon")
+        written = 0
+        with open(path, "w", encoding="utf-8") as out:
+            while written < size:
+                text = line(rng) + "\n"
+                out.write(text)
+                written += len(text.encode("utf-8"))
+        paths[name] = path
+    return paths
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.exit("usage: corpus.py DIR [SIZE_IN_BYTES]")
+    size = int(sys.argv[2]) if len(sys.argv) > 2 else 1 << 20
+    for name, path in generate(sys.argv[1], size).items():
+        print(f"{name}: {path}")
@@ -0,0 +1,171 @@
+// tests/dict_bench.c
+// Microbenchmark for the dictionary table. It inserts and looks up string
+// keys in the open-addressing table from eval/dict.c and in a plain chained
+// hash table with the same hash function, and prints the time per operation
+// of each.
+//
+// usage: make bench-dict
+
+#include "eval/dict.h"
+#include "eval/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// A chained hash table: one linked list of entries per bucket, doubled when
+// it holds as many entries as buckets.
+typedef struct ChainEntry {
+  Value key;
+  Value value;
+  uint64_t hash;
+  struct ChainEntry *next;
+} ChainEntry;
+
+typedef struct {
+  ChainEntry **buckets;
+  size_t capacity;
+  size_t count;
+} Chained;
+
+static void chained_init(Chained *table, size_t count) {
+  table->capacity = 16;
+  while (table->capacity < count)
+    table->capacity *= 2;
+  table->buckets = calloc(table->capacity, sizeof(ChainEntry *));
+  table->count = 0;
+}
+
+static void chained_grow(Chained *table) {
+  size_t capacity = table->capacity * 2;
+  ChainEntry **buckets = calloc(capacity, sizeof(ChainEntry *));
+  for (size_t i = 0; i < table->capacity; i++) {
+    for (ChainEntry *entry = table->buckets[i], *next; entry; entry = next) {
+      next = entry->next;
+      size_t bucket = (size_t)entry->hash & (capacity - 1);
+      entry->next = buckets[bucket];
+      buckets[bucket] = entry;
+    }
+  }
+  free(table->buckets);
+  table->buckets = buckets;
+  table->capacity = capacity;
+}
+
+static void chained_insert(Chained *table, Value key, Value value) {
+  uint64_t hash = hash_value(key);
+  for (ChainEntry *entry = table->buckets[hash & (table->capacity - 1)]; entry; entry = entry->next) {
+    if (entry->hash == hash && values_equal(entry->key, key)) {
+      free_value(&entry->value);
+      entry->value = value;
+      free_value(&key);
+      return;
+    }
+  }
+  if (table->count == table->capacity)
+    chained_grow(table);
+  ChainEntry *entry = malloc(sizeof(ChainEntry));
+  *entry = (ChainEntry){key, value, hash, table->buckets[hash & (table->capacity - 1)]};
+  table->buckets[hash & (table->capacity - 1)] = entry;
+  table->count++;
+}
+
+static const Value *chained_find(const Chained *table, Value key) {
+  uint64_t hash = hash_value(key);
+  for (ChainEntry *entry = table->buckets[hash & (table->capacity - 1)]; entry; entry = entry->next)
+    if (entry->hash == hash && values_equal(entry->key, key))
+      return &entry->value;
+  return NULL;
+}
+
+static void chained_free(Chained *table) {
+  for (size_t i = 0; i < table->capacity; i++) {
+    for (ChainEntry *entry = table->buckets[i], *next; entry; entry = next) {
+      next = entry->next;
+      free_value(&entry->key);
+      free_value(&entry->value);
+      free(entry);
+    }
+  }
+  free(table->buckets);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static Value make_key(const char *prefix, size_t i) {
+  char buf[32];
+  int n = snprintf(buf, sizeof(buf), "%s%zu", prefix, i);
+  return make_string(buf, (size_t)n);
+}
+
+// Runs one round of `count` keys and prints nanoseconds per operation.
+static void run(size_t count, int rounds) {
+  Value *hits = malloc(count * sizeof(Value));
+  Value *misses = malloc(count * sizeof(Value));
+  for (size_t i = 0; i < count; i++) {
+    hits[i] = make_key("key_", i);
+    misses[i] = make_key("missing_", i);
+  }
+
+  double times[2][3] = {{0}};
+  size_t found = 0;
+  for (int round = 0; round < rounds; round++) {
+    double start = now();
+    Dict *dict = dict_create(count);
+    for (size_t i = 0; i < count; i++)
+      dict_insert(dict, copy_value(hits[i]), 0, make_number((double)i));
+    times[0][0] += now() - start;
+    start = now();
+    for (size_t i = 0; i < count; i++)
+      found += dict_find(dict, hits[i], 0) != NULL;
+    times[0][1] += now() - start;
+    start = now();
+    for (size_t i = 0; i < count; i++)
+      found += dict_find(dict, misses[i], 0) != NULL;
+    times[0][2] += now() - start;
+    dict_free(dict);
+
+    Chained chained;
+    start = now();
+    chained_init(&chained, count);
+    for (size_t i = 0; i < count; i++)
+      chained_insert(&chained, copy_value(hits[i]), make_number((double)i));
+    times[1][0] += now() - start;
+    start = now();
+    for (size_t i = 0; i < count; i++)
+      found += chained_find(&chained, hits[i]) != NULL;
+    times[1][1] += now() - start;
+    start = now();
+    for (size_t i = 0; i < count; i++)
+      found += chained_find(&chained, misses[i]) != NULL;
+    times[1][2] += now() - start;
+    chained_free(&chained);
+  }
+  if (found != 2 * count * (size_t)rounds)
+    fprintf(stderr, "lookup mismatch: %zu\n", found);
+
+  const char *names[2] = {"open addressing", "chained"};
+  for (int t = 0; t < 2; t++) {
+    double scale = 1e9 / ((double)count * rounds);
+    printf("%-10zu %-16s %10.1f %10.1f %10.1f\n", count, names[t], times[t][0] * scale, times[t][1] * scale, times[t][2] * scale);
+  }
+  for (size_t i = 0; i < count; i++) {
+    free_value(&hits[i]);
+    free_value(&misses[i]);
+  }
+  free(hits);
+  free(misses);
+}
+
+int main(void) {
+  printf("%-10s %-16s %10s %10s %10s\n", "keys", "table", "insert ns", "hit ns", "miss ns");
+  run(16, 20000);
+  run(1000, 400);
+  run(100000, 4);
+  run(1000000, 1);
+  return 0;
+}
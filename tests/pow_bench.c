@@ -0,0 +1,75 @@
+// tests/pow_bench.c
+// Microbenchmark for the exponentiation kernels. It times each path `**`
+// can take (squaring, square roots and exact integer powers)
+// against the pow() call it replaces, and prints nanoseconds per power.
+//
+// usage: make bench-pow
+
+#include "eval/power.h"
+#include "eval/value.h"
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#define COUNT 4096
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double bases[COUNT];
+// Results are summed into a volatile so no loop is optimized away.
+static volatile double sink;
+// The exponent pow() gets, which the compiler can't see, as in the
+// interpreter.
+static volatile double runtime_exponent;
+
+// Stores in `ns` the time of `rounds` passes of `expression` over every
+// base, in nanoseconds per power.
+#define TIME(ns, rounds, expression)                                                                                                                                                                   \
+  do {                                                                                                                                                                                                 \
+    double start = now(), sum = 0;                                                                                                                                                                     \
+    for (int round = 0; round < (rounds); round++)                                                                                                                                                     \
+      for (size_t i = 0; i < COUNT; i++) {                                                                                                                                                             \
+        double x = bases[i];                                                                                                                                                                           \
+        sum += (expression);                                                                                                                                                                           \
+      }                                                                                                                                                                                                \
+    sink = sum;                                                                                                                                                                                        \
+    ns = (now() - start) * 1e9 / ((double)(rounds) * COUNT);                                                                                                                                           \
+  } while (0)
+
+// Times a kernel against the pow() call it replaces.
+#define COMPARE(name, kernel, exponent)                                                                                                                                                                \
+  do {                                                                                                                                                                                                 \
+    double kernel_ns, pow_ns;                                                                                                                                                                          \
+    runtime_exponent = (exponent);                                                                                                                                                                     \
+    double p = runtime_exponent;                                                                                                                                                                       \
+    TIME(kernel_ns, 2000, kernel);                                                                                                                                                                     \
+    TIME(pow_ns, 2000, pow(x, p));                                                                                                                                                                     \
+    printf("%-16s %10.2f %10.2f %9.1fx\n", name, kernel_ns, pow_ns, pow_ns / kernel_ns);                                                                                                               \
+  } while (0)
+
+// Times an exact integer power, which pow() cannot compute.
+static void time_integer(const char *name, int64_t base, uint64_t exponent, int rounds) {
+  double start = now();
+  for (int round = 0; round < rounds; round++) {
+    Value value = power_integer(make_integer(base), exponent);
+    free_value(&value);
+  }
+  printf("%-16s %10.2f %10s %10s\n", name, (now() - start) * 1e9 / rounds, "-", "-");
+}
+
+int main(void) {
+  for (size_t i = 0; i < COUNT; i++)
+    bases[i] = 0.5 + (double)i / COUNT;
+
+  printf("%-16s %10s %10s %10s\n", "path", "kernel ns", "pow ns", "speedup");
+  COMPARE("x ** 2", power_chain(x, 2), 2);
+  COMPARE("x ** 0.5", power_sqrt(x), 0.5);
+  time_integer("3 ** 39", 3, 39, 1000000);
+  time_integer("3 ** 1000", 3, 1000, 20000);
+  time_integer("7 ** 20000", 7, 20000, 20);
+  return 0;
+}
@@ -1,6 +1,9 @@
 #!/usr/bin/env python3
+import os
 import subprocess
 import sys
+import tempfile
+import time
 
 def check(cmd_list, expected_line):
     try:
@@ -20,14 +23,20 @@ def check(cmd_list, expected_line):
 print("Strings\n") 
 check(["build/noon", "-c", "'"], "<string>:1:1: error: unclosed char `'`")
 check(["build/noon", "-c", '"'], "<string>:1:1: error: unclosed string `\"`")
+check(["build/noon", "-c", '"ab\\u{110000}" + "\\q"'], "<string>:1:4: error: escape `\\u{110000}` is not a valid unicode code point")
 check(["build/noon", "-c", '"\'"'], "")
 check(["build/noon", "-c", "'\"'"], "")
+check(["build/noon", "-c", '"日本" + "→" + 1'], "<string>:1:15: error: operator `+` not supported between string and integer")
 
 print("\nComments\n") 
 check(["build/noon", "-c", "1#++"], "")
 check(["build/noon", "-c", "/**/"], "")
 check(["build/noon", "-c", "/*\*/*/"], "")
 check(["build/noon", "-c", "/*8383*/"], "")
+check(["build/noon", "-c", "1 # c"], "")
+check(["sh", "-c", "build/noon -c '1 # c' && echo ok"], "ok")
+check(["sh", "-c", "printf '1 # c\\n1 + 2 // c\\n' | build/noon -rp"], ">>> 1 # c\n1\n>>> 1 + 2 // c\n3\n")
+check(["build/noon", "-c", "1 + # c"], "<string>:1:3: error: expected value after operator `+`")
 check(["build/noon", "-c", "/*"], "<string>:1:1: error: unclosed comment `/*`")
 check(["build/noon", "-c", "*/"], "<string>:1:1: error: unmatched comment `*/`")
 
@@ -93,5 +102,103 @@ check(["build/noon", "-c", "1+"], "<string>:1:2: error: expected value after ope
 check(["build/noon", "-c", "*1"], "<string>:1:1: error: expected value before operator `*`")
 check(["build/noon", "-c", "1+'6'"], "<string>:1:3: error: operator `+` not supported between integer and char")
 check(["build/noon", "-c", "1+\"1\""], "<string>:1:3: error: operator `+` not supported between integer and string")
+check(["build/noon", "-c", "[1, 1<2]"], "<string>:1:5: error: list items must be numbers, not boolean")
+check(["build/noon", "-c", "[1, \"abc\"]\n[1, true]\n[1, 1<2]", "-cs"], "<string>:1:5: error: list items must be numbers, not string\n1 | [1, \"abc\"]\n  |     ^\n<string>:2:5: error: list items must be numbers, not boolean\n2 | [1, true]\n  |     ^~~~\n")
+check(["build/noon", "-c", "(1 ... 3) % 2"], "<string>:1:12: error: operator `%` not supported between range and integer")
+check(["build/noon", "-c", "len([1]) + 'a'"], "<string>:1:11: error: operator `+` not supported between number and char")
+check(["build/noon", "-c", "{1: 2} + 1"], "<string>:1:9: error: operator `+` not supported between dict and integer")
+check(["build/noon", "-c", "[7] % 2"], "<string>:1:6: error: operator `%` not supported between list and integer")
 
-print("\nRepl\n")
\ No newline at end of file
+print("\nEvaluation\n")
+check(["build/noon", "-c", "1/0"], "<string>:1:2: error: division by zero")
+check(["build/noon", "-c", "1.5 & 1"], "<string>:1:5: error: operator `&` requires integer operands")
+check(["build/noon", "-c", "1 = 2"], "<string>:1:3: error: cannot assign to a value with `=`")
+check(["sh", "-c", "printf '\"ab\" == \"ab\"\\n\"\\\\x71 b\" == \"q b\"\\n' | build/noon -rp"], "true\n>>> \"\\x71 b\" == \"q b\"\ntrue")
+check(["sh", "-c", "printf '\"abc\" < \"abd\"\\n\"ab\" != \"abc\"\\n' | build/noon -rp"], "true\n>>> \"ab\" != \"abc\"\ntrue")
+check(["build/noon", "-pa", "-c", '"a" + "b" + ("c" + "d")'], '+\n├── "a"\n├── "b"\n├── "c"\n└── "d"')
+check(["sh", "-c", "python3 -c \"print('+'.join(['1'] * 200000))\" | build/noon --stats=json"], '"nodes":399999,')
+check(["sh", "-c", "printf '[1, 2, 3] * 2 + 1\\n[1, 2, 3, 4, 5] < 3\\n' | build/noon -rp"], "[3, 5, 7]\n>>> [1, 2, 3, 4, 5] < 3\n[true, true, false, false, false]")
+check(["build/noon", "-c", "[1, 2] + [1]"], "<string>:1:8: error: operator `+` needs lists of the same length, not 2 and 1")
+check(["sh", "-c", "printf '{\"a\": 1, 2: [3], \"a\": 4}\\n{\"x\": 1, \"y\": 2} == {\"y\": 2, \"x\": 1}\\n' | build/noon -rp"], '{"a": 4, 2: [3]}\n>>> {"x": 1, "y": 2} == {"y": 2, "x": 1}\ntrue')
+check(["build/noon", "-c", "{[1]: 2}"], "<string>:1:2: error: dict keys must be numbers, strings or booleans, not list")
+check(["sh", "-c", "printf '(1 ... 5) * 2\\nlen(0 ... 1e9)\\nsum(0 ... 1e9)\\ncontains(0 ... 1e9, 123456789)\\n0 ... 99\\n' | build/noon -rp"], "[2, 4, 6, 8, 10]\n>>> len(0 ... 1e9)\n1000000001\n>>> sum(0 ... 1e9)\n5.000000005e+17\n>>> contains(0 ... 1e9, 123456789)\ntrue\n>>> 0 ... 99\n[0, 1, 2, ..., 99]")
+check(["build/noon", "-c", "len(1, 2)"], "<string>:1:1: error: function `len` takes 1 argument(s), not 2")
+check(["build/noon", "-c", "1 + foo(1)"], "<string>:1:5: error: unknown function `foo`\n1 | 1 + foo(1)\n  |     ^~~")
+check(["build/noon", "-c", "2 + sum(\"a\")"], "<string>:1:5: error: function `sum` not supported for string")
+check(["sh", "-c", "printf '9007199254740993\\n9223372036854775807 + 1\\n(1 << 100) %%%% 3\\n' | build/noon -rp"], "9007199254740993\n>>> 9223372036854775807 + 1\n9223372036854775808\n>>> (1 << 100) %% 3\n422550200076076467165567735125")
+check(["build/noon", "-c", "len(9007199254740993 ... 9007199254740995)"], "<string>:1:22: error: integer too large for a range, which holds integers exactly only up to 2^53")
+check(["build/noon", "-c", "[9007199254740993]"], "<string>:1:2: error: integer too large for a list, which holds integers exactly only up to 2^53")
+check(["sh", "-c", "printf '1.1 ** 13\\n1.1 ** (12 + 1)\\n' | build/noon -rp"], "3.4522712143931038\n>>> 1.1 ** (12 + 1)\n3.4522712143931038")
+check(["sh", "-c", "printf '3 ** 100\\n2 ** 0.5\\n[1, 2, 3] ** 2\\n' | build/noon -rp"], "515377520732011331036461129765621272702107522001\n>>> 2 ** 0.5\n1.4142135623730951\n>>> [1, 2, 3] ** 2\n[1, 4, 9]")
+
+print("\nDiagnostics Format\n")
+check(["build/noon", "-c", "1+", "--diagnostics-format=json"], '{"file":"<string>","line":1,"column":2,"severity":"error","message":"expected value after operator `+`","symbol":"+"}')
+check(["build/noon", "-c", "(", "--diagnostics-format=sarif"], '"region":{"startLine":1,"startColumn":1,"endColumn":2}')
+check(["build/noon", "--diagnostics-format=xml"], "invalid diagnostics format 'xml'")
+
+print("\nDiagnostic Limits\n")
+check(["build/noon", "-cs", "-c", "1+\n1+\n1+", "--max-errors=2"], "<string>: fatal error: too many errors emitted, stopping now [--max-errors=2]\n2 errors generated.")
+check(["build/noon", "-cs", "-c", "(" * 12], "<string>: note: and 2 more like this: unclosed bracket `(`\n12 errors generated.")
+check(["sh", "-c", "python3 -c \"print('1+\\n' * 13)\" | build/noon -rp"], "<stdin>:13:2: error: expected value after operator `+`")
+
+print("\nBatch\n")
+batch_dir = tempfile.mkdtemp()
+for name, code in [("a.noon", "1+\n"), ("b.noon", "(1\n"), ("c.noon", "1+2\n")]:
+    with open(os.path.join(batch_dir, name), "w") as f:
+        f.write(code)
+check(["build/noon", "-cs", "-j", "2", batch_dir], f"{batch_dir}/a.noon:1:2: error: expected value after operator `+`")
+check(["build/noon", "-cs", "-j", "2", batch_dir], f"  |  ^\n{batch_dir}/b.noon:1:1: error: unclosed bracket `(`")
+check(["build/noon", "-cs", "-j", "2", batch_dir], "2 errors generated.")
+
+print("\nServe\n")
+serve_socket = os.path.join(batch_dir, "noon.sock")
+server = subprocess.Popen(["build/noon", "--serve", serve_socket])
+for _ in range(100):
+    if os.path.exists(serve_socket):
+        break
+    time.sleep(0.05)
+check(["python3", "tests/client.py", serve_socket, "eval", "1+2*3"], "7")
+check(["python3", "tests/client.py", serve_socket, "check", "1/"], "<string>:1:2: error: expected value after operator `/`")
+server.terminate()
+server.wait()
+check(["sh", "-c", f"test -S {serve_socket} || echo removed"], "removed")
+check(["build/noon", "--serve", f"{batch_dir}/a.noon"], f"cannot listen on '{batch_dir}/a.noon': File exists")
+
+print("\nLsp\n")
+lsp_session = os.path.join(batch_dir, "session.lsp")
+with open(lsp_session, "w") as f:
+    for message in ['{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///a.noon","text":"1+2\\n1+\\n"}}}',
+                    '{"jsonrpc":"2.0","method":"exit"}']:
+        f.write(f"Content-Length: {len(message)}\r\n\r\n{message}")
+check(["sh", "-c", f"build/noon --lsp < {lsp_session}"], '{"range":{"start":{"line":1,"character":1},"end":{"line":1,"character":2}},"severity":1,"source":"noon","message":"expected value after operator `+`"}')
+
+print("\nCache\n")
+cache_file = os.path.join(batch_dir, "cached.noon")
+with open(cache_file, "w") as f:
+    f.write('1 + 2\n"a\\x41" + "b"\n')
+cache_run = f"NOON_CACHE_DIR={batch_dir} build/noon --cache -pa --stats=json {cache_file}"
+check(["sh", "-c", cache_run], '"lines":2,"tokens":6,"nodes":6,')
+check(["sh", "-c", cache_run], '+\n├── "aA"\n└── "b"')
+check(["sh", "-c", cache_run], '"bytes":0,"lines":0,"tokens":6,"nodes":6,')
+
+print("\nStdin\n")
+check(["sh", "-c", "printf '1\\n2/' | build/noon"], "<stdin>:2:2: error: expected value after operator `/`")
+check(["sh", "-c", "python3 -c \"print(' ' * 70000 + '1/')\" | build/noon -cs"], "<stdin>:1:70002: error: expected value after operator `/`")
+check(["sh", "-c", "python3 -c \"print('(1\\n+1)\\n' * 100 + '2/')\" | build/noon --stream -cs"], "<stdin>:201:2: error: expected value after operator `/`\n201 | 2/")
+
+print("\nHistory\n")
+history_dir = tempfile.mkdtemp()
+history_cmd = f"printf '1+2\\n3*4\\n\\0221+\\n\\004' | HOME={history_dir} NOON_HISTORY_SIZE=2 build/noon -rp"
+check(["sh", "-c", history_cmd], "(reverse-i-search)`1+': 1+2")
+check(["cat", os.path.join(history_dir, ".noon_history")], "1+2\n3*4\n1+2\n")
+check(["sh", "-c", f"printf '\\0223*\\n\\004' | HOME={history_dir} NOON_HISTORY_SIZE=1 build/noon -rp"], "(failed reverse-i-search)`3*': ")
+
+print("\nRepl\n")
+repl_dir = tempfile.mkdtemp()
+check(["sh", "-c", f"printf '12\\033[D+\\n\\033[200~1+2\\n3*4\\033[201~\\n' | HOME={repl_dir} build/noon -rp"], ">>> 3*4\n12\n")
+check(["cat", os.path.join(repl_dir, ".noon_history")], "1+2\n1+2\n3*4\n")
+check(["sh", "-c", f"printf '\"ab\\342\\202\"\\n' | HOME={repl_dir} build/noon -rp"], '>>> "ab"\nab\n')
+
+print("\nStats\n")
+check(["build/noon", "--stats=json", "-c", "1+2"], '"bytes":3,"lines":1,"tokens":3,"nodes":3,')
+check(["build/noon", "--stats=xml", "-c", "1"], "invalid stats format 'xml' (expected text or json)")